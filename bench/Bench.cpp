@@ -0,0 +1,722 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+
+#include "Tree.h"
+#include "Variable.h"
+#include "Coordinate.h"
+#include "Settings.h"
+#include "DiffUtils.h"
+#include "Sampler.h"
+#include "ParallelDiff.h"
+
+/// Allocations are counted by replacing allocator of libc
+extern "C" {
+  void *__libc_malloc(size_t size);
+  void *__libc_calloc(size_t count, size_t size);
+  void *__libc_realloc(void *pointer, size_t size);
+  void  __libc_free(void *pointer);
+}
+
+static std::atomic<size_t> ALLOCATIONS_COUNT{0};
+
+extern "C" void *malloc(size_t size) noexcept
+{
+  ALLOCATIONS_COUNT.fetch_add(1, std::memory_order_relaxed);
+
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept
+{
+  ALLOCATIONS_COUNT.fetch_add(1, std::memory_order_relaxed);
+
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) noexcept
+{
+  ALLOCATIONS_COUNT.fetch_add(1, std::memory_order_relaxed);
+
+  return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void *pointer) noexcept
+{
+  __libc_free(pointer);
+}
+
+const char *const DEFAULT_OUTPUT = "bench.json";
+
+const double DEFAULT_MIN_TIME = 0.2;
+
+const size_t MAX_BATCH_SIZE = 256;
+
+const unsigned SAMPLE_DENSITY = 1000;
+
+const double MAIN_VALUE = 0.75;
+
+const int RANDOM_SEED = 42;
+
+enum family_t {
+  FAMILY_BALANCED,
+  FAMILY_CHAIN,
+};
+
+const char *const FAMILY_NAMES[] = {"balanced", "chain"};
+
+struct Case {
+  family_t family;
+  size_t   size;
+};
+
+/// Chains are deep, so derivatives of products grow quadratically,
+/// their sizes are smaller than sizes of balanced expressions
+const Case CASES[] =
+  {
+    {FAMILY_BALANCED,   16},
+    {FAMILY_BALANCED,   64},
+    {FAMILY_BALANCED,  256},
+    {FAMILY_BALANCED, 1024},
+    {FAMILY_BALANCED, 4096},
+    {FAMILY_CHAIN,      16},
+    {FAMILY_CHAIN,      64},
+    {FAMILY_CHAIN,     256},
+  };
+
+const size_t CASES_COUNT = sizeof(CASES) / sizeof(CASES[0]);
+
+const char *const UNARY_NAMES[]  = {"sin", "cos", "sqrt", "ln"};
+const char *const BINARY_NAMES[] = {" + ", " - ", " * ", " / "};
+const char *const NUMBER_NAMES[] = {"1", "2", "3", "4", "5", "6", "7", "8", "9"};
+
+/// Growing buffer for generated expression
+struct Source {
+  char  *buffer;
+  size_t capacity;
+  size_t size;
+
+  Source &operator=(const Source &original) = delete;
+};
+
+struct Result {
+  const char *stage;
+  family_t    family;
+  size_t      nodes;
+  size_t      depth;
+  size_t      iterations;
+  double      nsPerOp;
+  double      allocationsPerOp;
+  double      passesPerOp;
+};
+
+struct Options {
+  const char *output;
+  double      minTime;
+  bool        graphics;
+};
+
+/// Measure of one stage, operation is called with batch of prepared items
+struct Stage {
+  const char *name;
+  void (*prepare)(void *context, size_t count);
+  void (*run)    (void *context, size_t count);
+  void (*clean)  (void *context, size_t count);
+};
+
+struct Context {
+  const char     *source;
+  db::Tree        tree;
+  db::Tree        derivative; ///< Not simplified derivative of tree
+  db::VarTable   *table;
+  db::Tree       *trees;
+  size_t          passes;     ///< Passes of simplifications of last batch
+  volatile double sink;
+};
+
+static bool parseOptions(int argc, const char *const argv[], Options *options);
+
+static bool append(Source *source, const char *text);
+
+static bool appendLeaf(Source *source);
+
+static bool generateBalanced(Source *source, size_t size);
+
+static bool generateChain(Source *source, size_t size);
+
+static size_t countNodes(const db::TreeNode *node);
+
+static size_t countDepth(const db::TreeNode *node);
+
+static bool measure(const Stage *stage, Context *context, double minTime, Result *result);
+
+static void prepareTrees      (void *context, size_t count);
+static void prepareDerivatives(void *context, size_t count);
+static void cleanTrees        (void *context, size_t count);
+static void nothing           (void *context, size_t count);
+
+static void runParse    (void *context, size_t count);
+static void runCalculate(void *context, size_t count);
+static void runDiff     (void *context, size_t count);
+static void runSimplite (void *context, size_t count);
+static void runWorklist (void *context, size_t count);
+static void runPasses   (void *context, size_t count);
+static void runOptimize (void *context, size_t count);
+static void runSample   (void *context, size_t count);
+static void runSampleJit(void *context, size_t count);
+static void runGraphics (void *context, size_t count);
+
+static void printResult(const Result *result);
+
+static void writeResults(const char *fileName, const Result *results, size_t count);
+
+const Stage STAGES[] =
+  {
+    {"parse",      nothing,            runParse,     nothing   },
+    {"calculate",  nothing,            runCalculate, nothing   },
+    {"diff",       nothing,            runDiff,      nothing   },
+    {"simplite",   prepareTrees,       runSimplite,  cleanTrees},
+    {"simp-list",  prepareDerivatives, runWorklist,  cleanTrees},
+    {"simp-pass",  prepareDerivatives, runPasses,    cleanTrees},
+    {"optimize",   prepareDerivatives, runOptimize,  cleanTrees},
+    {"sample",     nothing,            runSample,    nothing   },
+    {"sample-jit", nothing,            runSampleJit, nothing   },
+    {"graphics",   nothing,            runGraphics,  nothing   },
+  };
+
+const size_t STAGES_COUNT = sizeof(STAGES) / sizeof(STAGES[0]);
+
+int main(const int argc, const char *const argv[])
+{
+  Options options = {DEFAULT_OUTPUT, DEFAULT_MIN_TIME, false};
+
+  if (!parseOptions(argc, argv, &options))
+    return 1;
+
+  srand(RANDOM_SEED);
+
+  /// Table is owned by settings like table of program
+  db::VarTable *table = (db::VarTable *)calloc(1, sizeof(db::VarTable));
+
+  if (!table)
+    return 1;
+
+  table->table = (db::Variable *)calloc(1, sizeof(db::Variable));
+
+  if (!table->table)
+    {
+      free(table);
+
+      return 1;
+    }
+
+  table->table[0] = {strdup(db::DEFAULT_MAIN_NAME), 0, MAIN_VALUE};
+  table->capacity = table->size = 1;
+
+  Settings settings{};
+  getSettings(&settings);
+  settings.table = table;
+  setSettings(&settings);
+
+  Result *results = (Result *)calloc(CASES_COUNT * STAGES_COUNT, sizeof(Result));
+
+  if (!results)
+    return 1;
+
+  size_t resultsCount = 0;
+
+  printf("%-10s %-9s %6s %6s %10s %12s %12s %12s %9s\n",
+         "stage", "family", "nodes", "depth", "iters", "ns/op", "ns/node", "allocs/op", "passes");
+
+  for (size_t i = 0; i < CASES_COUNT; ++i)
+    {
+      Source source = {nullptr, 0, 0};
+
+      bool isGenerated =
+        CASES[i].family == FAMILY_BALANCED ?
+        generateBalanced(&source, CASES[i].size) :
+        generateChain   (&source, CASES[i].size);
+
+      if (!isGenerated)
+        {
+          free(source.buffer);
+          continue;
+        }
+
+      Context context = {source.buffer, {}, {}, table, nullptr, 0, 0};
+
+      int error = 0;
+
+      db::createTree(&context.tree);
+      db::parseTree(&context.tree, source.buffer, &error);
+
+      if (error || !context.tree.root)
+        {
+          fprintf(stderr, "Can`t parse generated expression\n");
+
+          db::destroyTree(&context.tree);
+          free(source.buffer);
+
+          continue;
+        }
+
+      db::createTree(&context.derivative);
+      context.derivative.root = db::diffParallel(context.tree.root, db::DEFAULT_MAIN_NAME, 1);
+
+      for (size_t j = 0; j < STAGES_COUNT; ++j)
+        {
+          if (!strcmp(STAGES[j].name, "graphics") && !options.graphics)
+            continue;
+
+          Result *result = &results[resultsCount];
+
+          result->family = CASES[i].family;
+          result->nodes  = countNodes(context.tree.root);
+          result->depth  = countDepth(context.tree.root);
+
+          if (!measure(&STAGES[j], &context, options.minTime, result))
+            continue;
+
+          printResult(result);
+
+          ++resultsCount;
+        }
+
+      db::destroyTree(&context.derivative);
+      db::destroyTree(&context.tree);
+      free(source.buffer);
+    }
+
+  writeResults(options.output, results, resultsCount);
+
+  free(results);
+  free(table->table[0].name);
+
+  return 0;
+}
+
+static bool parseOptions(int argc, const char *const argv[], Options *options)
+{
+  for (int i = 1; i < argc; ++i)
+    {
+      if (!strcmp(argv[i], "-o") && i + 1 < argc)
+        options->output = argv[++i];
+      else if (!strcmp(argv[i], "-time") && i + 1 < argc)
+        options->minTime = atof(argv[++i]);
+      else if (!strcmp(argv[i], "-graphics"))
+        options->graphics = true;
+      else
+        {
+          fprintf(stderr,
+                  "Usage: %s [-o file.json] [-time seconds] [-graphics]\n",
+                  argv[0]);
+
+          return false;
+        }
+    }
+
+  return options->minTime > 0;
+}
+
+static bool append(Source *source, const char *text)
+{
+  size_t length = strlen(text);
+
+  while (source->size + length + 1 > source->capacity)
+    {
+      char *temp = (char *)realloc(source->buffer, (source->capacity + 1)*2);
+
+      if (!temp)
+        return false;
+
+      source->buffer = temp;
+
+      ++source->capacity;
+      source->capacity *= 2;
+    }
+
+  memcpy(source->buffer + source->size, text, length + 1);
+
+  source->size += length;
+
+  return true;
+}
+
+static bool appendLeaf(Source *source)
+{
+  if (rand() % 2)
+    return append(source, "x");
+
+  return append(source, NUMBER_NAMES[rand() % 9]);
+}
+
+/// Random expression of size nodes, operands of binary operators are
+/// split randomly, so depth is about logarithm of size
+static bool generateBalanced(Source *source, size_t size)
+{
+  if (size <= 1)
+    return appendLeaf(source);
+
+  if (size == 2 || rand() % 4 == 0)
+    return
+      append(source, UNARY_NAMES[rand() % 4]) &&
+      append(source, "(") &&
+      generateBalanced(source, size - 1) &&
+      append(source, ")");
+
+  size_t left = 1 + (size_t)rand() % (size - 2);
+
+  const char *operat = BINARY_NAMES[rand() % 4];
+
+  return
+    append(source, "(") &&
+    generateBalanced(source, left) &&
+    append(source, operat) &&
+    generateBalanced(source, size - 1 - left) &&
+    append(source, ")");
+}
+
+/// Random expression of size nodes where every operator has leaf as
+/// other operand, so depth is about size
+static bool generateChain(Source *source, size_t size)
+{
+  if (size <= 1)
+    return appendLeaf(source);
+
+  if (size == 2 || rand() % 4 == 0)
+    return
+      append(source, UNARY_NAMES[rand() % 4]) &&
+      append(source, "(") &&
+      generateChain(source, size - 1) &&
+      append(source, ")");
+
+  const char *operat = BINARY_NAMES[rand() % 4];
+
+  return
+    append(source, "(") &&
+    generateChain(source, size - 2) &&
+    append(source, operat) &&
+    appendLeaf(source) &&
+    append(source, ")");
+}
+
+static size_t countNodes(const db::TreeNode *node)
+{
+  if (!node)
+    return 0;
+
+  return 1 + countNodes(node->left) + countNodes(node->right);
+}
+
+static size_t countDepth(const db::TreeNode *node)
+{
+  if (!node)
+    return 0;
+
+  size_t left  = countDepth(node->left);
+  size_t right = countDepth(node->right);
+
+  return 1 + (left > right ? left : right);
+}
+
+/// Run stage with growing batches until it takes minTime
+static bool measure(const Stage *stage, Context *context, double minTime, Result *result)
+{
+  size_t batch       = 1;
+  size_t iterations  = 0;
+  size_t allocations = 0;
+  size_t passes      = 0;
+  double time        = 0;
+
+  while (time < minTime)
+    {
+      stage->prepare(context, batch);
+
+      context->passes = 0;
+
+      size_t allocationsBefore = ALLOCATIONS_COUNT.load();
+
+      auto start = std::chrono::steady_clock::now();
+
+      stage->run(context, batch);
+
+      auto finish = std::chrono::steady_clock::now();
+
+      allocations += ALLOCATIONS_COUNT.load() - allocationsBefore;
+      passes      += context->passes;
+
+      stage->clean(context, batch);
+
+      time       += std::chrono::duration<double>(finish - start).count();
+      iterations += batch;
+
+      if (batch < MAX_BATCH_SIZE)
+        batch *= 2;
+    }
+
+  result->stage            = stage->name;
+  result->iterations       = iterations;
+  result->nsPerOp          = time * 1e9 / (double)iterations;
+  result->allocationsPerOp = (double)allocations / (double)iterations;
+  result->passesPerOp      = (double)passes / (double)iterations;
+
+  return iterations > 0;
+}
+
+static void nothing(void *, size_t) {}
+
+/// Simplite changes tree, so every operation gets own copy
+static void prepareTrees(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  context->trees = (db::Tree *)calloc(count, sizeof(db::Tree));
+
+  if (!context->trees)
+    return;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      db::createTree(&context->trees[i]);
+
+      context->trees[i].root = db::createNode(context->tree.root);
+    }
+}
+
+/// Simplifiers are compared on derivatives which have much to simplify
+static void prepareDerivatives(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  context->trees = (db::Tree *)calloc(count, sizeof(db::Tree));
+
+  if (!context->trees)
+    return;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      db::createTree(&context->trees[i]);
+
+      context->trees[i].root = db::createNode(context->derivative.root);
+    }
+}
+
+static void cleanTrees(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  if (!context->trees)
+    return;
+
+  for (size_t i = 0; i < count; ++i)
+    db::destroyTree(&context->trees[i]);
+
+  free(context->trees);
+
+  context->trees = nullptr;
+}
+
+static void runParse(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      db::Tree tree{};
+
+      db::createTree(&tree);
+      db::parseTree(&tree, context->source);
+      db::destroyTree(&tree);
+    }
+}
+
+static void runCalculate(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  for (size_t i = 0; i < count; ++i)
+    context->sink = calculateNode(context->table, context->tree.root);
+}
+
+static void runDiff(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      db::Tree tree = diffExpresion(&context->tree, nullptr);
+
+      db::destroyTree(&tree);
+    }
+}
+
+static void runSimplite(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  if (!context->trees)
+    return;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      SimpliteStats stats{};
+
+      simpliteTree(&context->trees[i], nullptr, &stats);
+
+      context->passes += stats.passes;
+    }
+}
+
+static void runWorklist(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  if (!context->trees)
+    return;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      SimpliteStats stats{};
+
+      simpliteTree(&context->trees[i], nullptr, &stats);
+
+      context->passes += stats.passes;
+    }
+}
+
+static void runPasses(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  if (!context->trees)
+    return;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      SimpliteStats stats{};
+
+      simpliteTreeByPasses(&context->trees[i], &stats);
+
+      context->passes += stats.passes;
+    }
+}
+
+/// Iterations of saturation are counted as passes
+static void runOptimize(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  if (!context->trees)
+    return;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      db::SaturationStats stats{};
+
+      optimizeTree(&context->trees[i], &db::NODES_COST, &db::DEFAULT_SATURATION_LIMITS, nullptr, &stats);
+
+      context->passes += stats.iterations;
+    }
+}
+
+static db::Plot createPlot(db::Expression *expression)
+{
+  return {expression, 1, {-10, 10}, {-10, 10}, SAMPLE_DENSITY};
+}
+
+static void runSample(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  db::Expression expression = {&context->tree, "f"};
+
+  db::Plot plot = createPlot(&expression);
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      db::Curve curve{};
+
+      db::sampleCurves(&plot, context->table, &curve);
+      db::destroyCurve(&curve);
+    }
+}
+
+static void runSampleJit(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  db::Expression expression = {&context->tree, "f"};
+
+  db::Plot plot = createPlot(&expression);
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      db::Curve curve{};
+
+      db::sampleCurves(&plot, context->table, &curve, 0, db::Backend::JIT);
+      db::destroyCurve(&curve);
+    }
+}
+
+static void runGraphics(void *rawContext, size_t count)
+{
+  Context *context = (Context *)rawContext;
+
+  db::Expression expression = {&context->tree, "f"};
+
+  db::Plot plot = createPlot(&expression);
+
+  for (size_t i = 0; i < count; ++i)
+    free(buildGraphics(&plot));
+}
+
+static void printResult(const Result *result)
+{
+  printf("%-10s %-9s %6zu %6zu %10zu %12.1f %12.2f %12.1f %9.2f\n",
+         result->stage,
+         FAMILY_NAMES[result->family],
+         result->nodes,
+         result->depth,
+         result->iterations,
+         result->nsPerOp,
+         result->nsPerOp / (double)result->nodes,
+         result->allocationsPerOp,
+         result->passesPerOp);
+}
+
+static void writeResults(const char *fileName, const Result *results, size_t count)
+{
+  FILE *file = fopen(fileName, "w");
+
+  if (!file)
+    {
+      fprintf(stderr, "Can`t open \"%s\"\n", fileName);
+
+      return;
+    }
+
+  fprintf(file, "[\n");
+
+  for (size_t i = 0; i < count; ++i)
+    fprintf(file,
+            "  {\"stage\": \"%s\", \"family\": \"%s\", \"nodes\": %zu, \"depth\": %zu, "
+            "\"iterations\": %zu, \"ns_per_op\": %.1f, \"ns_per_node\": %.3f, "
+            "\"allocations_per_op\": %.2f, \"passes_per_op\": %.2f}%s\n",
+            results[i].stage,
+            FAMILY_NAMES[results[i].family],
+            results[i].nodes,
+            results[i].depth,
+            results[i].iterations,
+            results[i].nsPerOp,
+            results[i].nsPerOp / (double)results[i].nodes,
+            results[i].allocationsPerOp,
+            results[i].passesPerOp,
+            i + 1 < count ? "," : "");
+
+  fprintf(file, "]\n");
+
+  fclose(file);
+}
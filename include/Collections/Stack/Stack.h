@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace db {
+
+  /// Stack of elements of one size, elements are copied in and out.
+  /// It replaces recursion in traversals of deep trees
+  struct Stack {
+    char  *data;
+    size_t elementSize;
+    size_t capacity;
+    size_t size;
+
+    Stack &operator=(const Stack &original) = delete;
+  };
+
+  void createStack(Stack *stack, size_t elementSize, int *error = nullptr);
+
+  void destroyStack(Stack *stack, int *error = nullptr);
+
+  /// @param [in] element Pointer to elementSize bytes
+  /// @return Was element pushed
+  bool push(Stack *stack, const void *element, int *error = nullptr);
+
+  /// @param [out] element Pointer to elementSize bytes or nullptr
+  /// @return Was element popped
+  bool pop(Stack *stack, void *element = nullptr, int *error = nullptr);
+
+  /// @return Pointer to top element, it is valid until next push, or nullptr
+  void *top(const Stack *stack, int *error = nullptr);
+
+  bool isEmpty(const Stack *stack, int *error = nullptr);
+
+}
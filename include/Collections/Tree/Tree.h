@@ -155,4 +155,12 @@ namespace db {
                 const char *fileName,
                 int *error = nullptr
                 );
+
+  /// Read tree from infix expression like "sin(x) * (x + 2) ^ 2"
+  void parseTree(Tree *tree, const char *source, int *error = nullptr);
+
+  /// Read infix expressions of file, one by line, empty lines are skipped
+  /// @param [out] trees Address of array of trees, every tree and array must be freed
+  /// @param [out] count Count of trees
+  void loadTrees(Tree **trees, size_t *count, const char *fileName, int *error = nullptr);
 }
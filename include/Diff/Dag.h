@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Tree.h"
+
+namespace db {
+
+  /// Index of node which isn`t in DAG
+  const size_t NO_NODE = (size_t)-1;
+
+  /// Set of variables, variable i of DAG is bit i, variables
+  /// after the last but one bit share the last bit
+  typedef uint64_t dependency_t;
+
+  const size_t DEPENDENCY_BITS = 64;
+
+  /// Node of DAG, children are indices of nodes or NO_NODE.
+  /// Unary operators have only right child
+  struct DagNode {
+    type_t       type;
+    treeValue_t  value;
+    size_t       left;
+    size_t       right;
+    dependency_t depends; ///< Variables which subtree of node mentions
+    size_t       next;    ///< Next node in bucket of hash table
+  };
+
+  /// Expressions where equal subexpressions are one node (hash consing).
+  /// Names of variables are interned, so they are compared by pointers.
+  /// Nodes are only appended, so children always go before parents
+  struct Dag {
+    DagNode *nodes;
+    size_t   capacity;
+    size_t   size;
+    size_t  *buckets;
+    size_t   bucketsCount;
+    char   **names;
+    size_t   namesCapacity;
+    size_t   namesCount;
+
+    Dag &operator=(const Dag &original) = delete;
+  };
+
+  void createDag(Dag *dag, int *error = nullptr);
+
+  void destroyDag(Dag *dag, int *error = nullptr);
+
+  /// Find node or append new one
+  /// @param [in] value Value of node, name of variable is copied
+  /// @param [in] left Left child, it is ignored for unary operators
+  /// @param [in] right Right child
+  /// @return Index of node or NO_NODE
+  size_t addDagNode(Dag *dag, type_t type, treeValue_t value, size_t left, size_t right, int *error = nullptr);
+
+  /// Add all subtrees of node
+  /// @return Index of node or NO_NODE
+  size_t addDagTree(Dag *dag, const TreeNode *node, int *error = nullptr);
+
+  /// Copy node of DAG with all its children to tree, shared
+  /// nodes are copied for every use
+  /// @return Root of new tree or nullptr
+  TreeNode *expandDag(const Dag *dag, size_t node, int *error = nullptr);
+
+  /// Bit of variable, zero if no node of DAG mentions it
+  dependency_t getDependency(const Dag *dag, const char *name, int *error = nullptr);
+
+  /// Subtree of node mentions one of variables, nodes are never changed,
+  /// so dependencies are set once, when node is added
+  bool isDependent(const Dag *dag, size_t node, dependency_t variables, int *error = nullptr);
+
+  /// Unary operator uses only right operand
+  bool isUnary(operator_t operat);
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include "Dag.h"
+
+namespace db {
+
+  /// Derivatives of DAG nodes by variable. Derivatives are added to the
+  /// same DAG, every node is differentiated once (results are memoized),
+  /// so derivatives share subexpressions with expressions and each other
+  /// and their size is linear in size of DAG
+  /// @param [in] roots Nodes for differentiate
+  /// @param [out] derivatives Array for count indices of derivatives
+  /// @param [in] count Count of nodes
+  /// @param [in] variable Name of variable of differentiation
+  /// @param [out] error Error`s code
+  void diffDag(
+               Dag *dag,
+               const size_t *roots,
+               size_t *derivatives,
+               size_t count,
+               const char *variable,
+               int *error = nullptr
+              );
+
+  /// Derivative of one node of DAG
+  /// @return Index of derivative or NO_NODE
+  size_t diffDag(Dag *dag, size_t root, const char *variable, int *error = nullptr);
+
+}
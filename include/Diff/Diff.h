@@ -6,6 +6,12 @@ bool init();
 
 void start();
 
+/// Differentiate every expression of source file by main variable and save
+/// derivatives to target file, one by line. Expressions are differentiated
+/// together, so their common subexpressions are differentiated once
+/// @return Were all expressions differentiated
+bool diffBatch();
+
 db::ResourceBundle *getBundle();
 
 
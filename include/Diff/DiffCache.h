@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include "Tree.h"
+#include "Variable.h"
+#include "EGraph.h"
+
+namespace db {
+
+  /// Simplified derivative of some order
+  struct CachedDerivative {
+    size_t order;
+    Tree   tree;
+    size_t memory;  ///< Memory of nodes of tree
+    size_t lastUse; ///< Time of last use, older derivatives are evicted first
+  };
+
+  /// Derivatives of one expression by one variable. Derivative of order k + 1
+  /// is built from cached derivative of order k, least recently used derivatives
+  /// are evicted when their memory is over maxMemory. Taylor coefficients at
+  /// last values of variables are kept too, so tangent and series share them
+  struct DiffCache {
+    const Tree       *tree;
+    char             *variable;
+    CachedDerivative *derivatives;
+    size_t            capacity;
+    size_t            count;
+    size_t            memory;
+    size_t            maxMemory;
+    unsigned          threads;
+    const CostModel  *cost;   ///< Cost model of optimizeTree() or nullptr
+    SaturationLimits  limits; ///< Limits of optimizeTree()
+    size_t            time;
+    double           *coefficients;
+    size_t            coefficientsCount;
+    double           *values; ///< Values of variables which coefficients were calculated at
+    size_t            valuesCount;
+
+    DiffCache &operator=(const DiffCache &original) = delete;
+  };
+
+  /// @param [in] tree Expression, it isn`t copied
+  /// @param [in] variable Name of variable of differentiation, it is copied
+  /// @param [in] maxMemory Max memory of cached derivatives in bytes
+  /// @param [in] threads Count of threads of differentiation, zero means count of processors
+  /// @param [in] cost Derivatives are optimized for cost if it isn`t nullptr
+  /// @param [in] limits Limits of optimization, they are copied
+  void createDiffCache(
+                       DiffCache *cache,
+                       const Tree *tree,
+                       const char *variable,
+                       size_t maxMemory,
+                       unsigned threads = 1,
+                       const CostModel *cost = nullptr,
+                       const SaturationLimits *limits = &DEFAULT_SATURATION_LIMITS,
+                       int *error = nullptr
+                      );
+
+  void destroyDiffCache(DiffCache *cache, int *error = nullptr);
+
+  /// Forget all derivatives, it must be called when expression is changed
+  /// @param [in] tree New expression
+  void resetDiffCache(DiffCache *cache, const Tree *tree, int *error = nullptr);
+
+  /// Simplified derivative of order, zero order is expression itself.
+  /// Missed orders are built from nearest cached lower order
+  /// @return Derivative, it is valid until next call for cache, or nullptr
+  const Tree *getDerivative(DiffCache *cache, size_t order, int *error = nullptr);
+
+  /// Taylor coefficients at current values of variables
+  /// @param [in] order Max power of series
+  /// @return Array of at least order + 1 coefficients, it is valid until next call for cache, or nullptr
+  const double *getSeriesCoefficients(DiffCache *cache, const VarTable *table, size_t order, int *error = nullptr);
+
+}
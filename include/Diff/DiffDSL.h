@@ -13,9 +13,6 @@
 #define CopyLeft  (node->left  ? createNode(Left)  : nullptr)
 #define CopyRight (node->right ? createNode(Right) : nullptr)
 
-#define dLeft  (node->left  ? diff(Left)  : nullptr)
-#define dRight (node->right ? diff(Right) : nullptr)
-
 #define CREATE_OPERATOR(TYPE, LEFT, RIGHT)         \
   db::createNode(                                  \
                  {db::OPERATOR_ ## TYPE},          \
@@ -0,0 +1,216 @@
+#pragma once
+
+#include "Tree.h"
+#include "Dag.h"
+
+namespace db {
+
+  // Rules of differentiation are shared by DAG and trees, so both give the same
+  // expressions. Builder has type Node and value NONE of absent node and functions:
+  //   Node number  (Builder *builder, double value);
+  //   Node makeNode(Builder *builder, operator_t operat, Node left, Node right);
+  //   bool isNumber(const Builder *builder, Node node, double value);
+  //   Node share   (Builder *builder, Node node);
+  //   void drop    (Builder *builder, Node node);
+  // Every node is used once: it is put to another node or dropped. Node which is
+  // used again must be shared (DAG references it, tree copies it)
+
+  /// Operator node, zeros and ones are folded, so derivatives
+  /// of operands which don`t depend on variable vanish.
+  /// Absent operand gives NONE
+  template <class Builder>
+  typename Builder::Node operation(
+                                   Builder *builder,
+                                   operator_t operat,
+                                   typename Builder::Node left,
+                                   typename Builder::Node right
+                                  )
+  {
+    const typename Builder::Node NONE = Builder::NONE;
+
+    if (right == NONE || (!isUnary(operat) && left == NONE))
+      {
+        drop(builder, left);
+        drop(builder, right);
+
+        return NONE;
+      }
+
+#define RETURN_NUMBER(VALUE)                    \
+    do                                          \
+      {                                         \
+        drop(builder, left);                    \
+        drop(builder, right);                   \
+                                                \
+        return number(builder, VALUE);          \
+      } while (0)
+
+#define RETURN_OPERAND(OPERAND, OTHER)          \
+    do                                          \
+      {                                         \
+        drop(builder, OTHER);                   \
+                                                \
+        return OPERAND;                         \
+      } while (0)
+
+    switch (operat)
+      {
+      case OPERATOR_ADD:
+        if (isNumber(builder, left,  0)) RETURN_OPERAND(right, left);
+        if (isNumber(builder, right, 0)) RETURN_OPERAND(left, right);
+        break;
+      case OPERATOR_SUB:
+        if (isNumber(builder, right, 0)) RETURN_OPERAND(left, right);
+        break;
+      case OPERATOR_MUL:
+        if (isNumber(builder, left, 0) || isNumber(builder, right, 0)) RETURN_NUMBER(0);
+        if (isNumber(builder, left,  1)) RETURN_OPERAND(right, left);
+        if (isNumber(builder, right, 1)) RETURN_OPERAND(left, right);
+        break;
+      case OPERATOR_DIV:
+        if (isNumber(builder, left,  0)) RETURN_NUMBER(0);
+        if (isNumber(builder, right, 1)) RETURN_OPERAND(left, right);
+        break;
+      case OPERATOR_POW:
+        if (isNumber(builder, right, 0)) RETURN_NUMBER(1);
+        if (isNumber(builder, right, 1)) RETURN_OPERAND(left, right);
+        break;
+      case OPERATOR_SQRT:
+      case OPERATOR_SIN:
+      case OPERATOR_COS:
+      case OPERATOR_LOG:
+      case OPERATOR_LN:
+      case OPERATORS_COUNT:
+      default:
+        break;
+      }
+
+#undef RETURN_NUMBER
+#undef RETURN_OPERAND
+
+    return makeNode(builder, operat, left, right);
+  }
+
+  /// Derivative of operator node self by derivatives of its operands.
+  /// Operands and self are only shared, derivatives are used once.
+  /// Operand with zero derivative is const
+  template <class Builder>
+  typename Builder::Node diffOperator(
+                                      Builder *builder,
+                                      operator_t operat,
+                                      typename Builder::Node self,
+                                      typename Builder::Node left,
+                                      typename Builder::Node right,
+                                      typename Builder::Node leftDiff,
+                                      typename Builder::Node rightDiff
+                                     )
+  {
+    typedef typename Builder::Node Node;
+
+    const Node NONE = Builder::NONE;
+
+    if (right == NONE || (!isUnary(operat) && left == NONE))
+      {
+        drop(builder, leftDiff);
+        drop(builder, rightDiff);
+
+        return NONE;
+      }
+
+#define NODE_OF(OPERAT, LEFT, RIGHT) operation(builder, OPERATOR_ ## OPERAT, (LEFT), (RIGHT))
+#define SHARE(NODE) share(builder, (NODE))
+
+    switch (operat)
+      {
+      case OPERATOR_ADD:
+        return NODE_OF(ADD, leftDiff, rightDiff);
+      case OPERATOR_SUB:
+        return NODE_OF(SUB, leftDiff, rightDiff);
+      case OPERATOR_MUL:
+        return NODE_OF(ADD, NODE_OF(MUL, leftDiff, SHARE(right)), NODE_OF(MUL, SHARE(left), rightDiff));
+      case OPERATOR_DIV:
+        return NODE_OF(
+                       DIV,
+                       NODE_OF(SUB, NODE_OF(MUL, leftDiff, SHARE(right)), NODE_OF(MUL, SHARE(left), rightDiff)),
+                       NODE_OF(MUL, SHARE(right), SHARE(right))
+                      );
+      case OPERATOR_SIN:
+        return NODE_OF(MUL, NODE_OF(COS, NONE, SHARE(right)), rightDiff);
+      case OPERATOR_COS:
+        return NODE_OF(MUL, number(builder, -1), NODE_OF(MUL, NODE_OF(SIN, NONE, SHARE(right)), rightDiff));
+      case OPERATOR_POW:
+        {
+          bool isLeftConst  = isNumber(builder, leftDiff,  0);
+          bool isRightConst = isNumber(builder, rightDiff, 0);
+
+          if (isLeftConst && isRightConst)
+            {
+              drop(builder, leftDiff);
+              drop(builder, rightDiff);
+
+              return number(builder, 0);
+            }
+
+          if (isLeftConst)
+            {
+              drop(builder, leftDiff);
+
+              return NODE_OF(MUL, NODE_OF(MUL, SHARE(self), NODE_OF(LN, NONE, SHARE(left))), rightDiff);
+            }
+
+          if (isRightConst)
+            {
+              drop(builder, rightDiff);
+
+              return NODE_OF(
+                             MUL,
+                             NODE_OF(MUL, SHARE(right), NODE_OF(POW, SHARE(left), NODE_OF(SUB, SHARE(right), number(builder, 1)))),
+                             leftDiff
+                            );
+            }
+
+          return NODE_OF(
+                         MUL,
+                         SHARE(self),
+                         NODE_OF(
+                                 ADD,
+                                 NODE_OF(MUL, rightDiff, NODE_OF(LN, NONE, SHARE(left))),
+                                 NODE_OF(DIV, NODE_OF(MUL, SHARE(right), leftDiff), SHARE(left))
+                                )
+                        );
+        }
+      case OPERATOR_SQRT:
+        return NODE_OF(DIV, rightDiff, NODE_OF(MUL, number(builder, 2), SHARE(self)));
+      case OPERATOR_LOG:
+        {
+          // lnLeft is used three times, so it is shared before it is used
+          Node lnLeft  = NODE_OF(LN, NONE, SHARE(left));
+          Node lnRight = NODE_OF(LN, NONE, SHARE(right));
+
+          Node square = NODE_OF(MUL, SHARE(lnLeft), SHARE(lnLeft));
+
+          return NODE_OF(
+                         DIV,
+                         NODE_OF(
+                                 SUB,
+                                 NODE_OF(DIV, NODE_OF(MUL, rightDiff, lnLeft), SHARE(right)),
+                                 NODE_OF(DIV, NODE_OF(MUL, leftDiff, lnRight), SHARE(left))
+                                ),
+                         square
+                        );
+        }
+      case OPERATOR_LN:
+        return NODE_OF(DIV, rightDiff, SHARE(right));
+      case OPERATORS_COUNT:
+      default:
+        drop(builder, leftDiff);
+        drop(builder, rightDiff);
+
+        return NONE;
+      }
+
+#undef NODE_OF
+#undef SHARE
+  }
+
+}
@@ -3,17 +3,108 @@
 #include "Tree.h"
 #include "Variable.h"
 #include "Coordinate.h"
+#include "DiffCache.h"
+#include "EGraph.h"
 #include <stdio.h>
 
 db::Tree diffExpresion(const db::Tree *tree, FILE *file = stdout, int *error = nullptr);
 
+/// Simplified partial derivative of tree by variable
+/// @param [in] variable Name of variable of differentiation
+/// @param [in] file File for intermediate trees or nullptr
+db::Tree diffPartial(const db::Tree *tree, const char *variable, FILE *file = nullptr, int *error = nullptr);
+
+/// The same derivative as diffPartial() gives, but large trees
+/// are differentiated by several threads (see db::diffParallel())
+/// @param [in] threads Count of threads, zero means count of processors
+db::Tree diffPartial(const db::Tree *tree, const char *variable, unsigned threads, FILE *file = nullptr, int *error = nullptr);
+
+/// Simplified partial derivatives of tree by several variables.
+/// Derivatives are built on one DAG of tree, so they share subexpressions
+/// @param [in] variables Names of variables
+/// @param [in] count Count of variables
+/// @param [out] gradient Array for count trees
+void diffGradient(
+                  const db::Tree *tree,
+                  const char *const *variables,
+                  size_t count,
+                  db::Tree *gradient,
+                  int *error = nullptr
+                 );
+
+/// Simplified derivatives of several expressions by one variable.
+/// All trees are put to one DAG, so subexpressions which are common
+/// for several expressions are differentiated once
+/// @param [in] trees Array of count expressions
+/// @param [in] variable Name of variable of differentiation
+/// @param [out] derivatives Array for count trees
+void diffExpressions(
+                     const db::Tree *trees,
+                     size_t count,
+                     const char *variable,
+                     db::Tree *derivatives,
+                     int *error = nullptr
+                    );
+
+/// Work of simplification
+struct SimpliteStats {
+  size_t passes;  ///< Traversals of whole tree
+  size_t visits;  ///< Examinations of nodes
+  size_t changes; ///< Rewrites of nodes
+  double time;    ///< Seconds
+};
+
+/// Simplify tree in place until nothing changes. Node is examined after its
+/// children, and node which gets new children is examined again after them only,
+/// so one traversal reaches the fixed point
+/// @param [in] file File for simplified tree and stats or nullptr
+/// @param [out] stats Work of simplification or nullptr
+void simpliteTree(db::Tree *tree, FILE *file = nullptr, SimpliteStats *stats = nullptr, int *error = nullptr);
+
+/// The same fixed point by traversals of whole tree until one of them
+/// changes nothing, it is kept for comparison with simpliteTree()
+/// @param [out] stats Work of simplification or nullptr
+void simpliteTreeByPasses(db::Tree *tree, SimpliteStats *stats = nullptr, int *error = nullptr);
+
+/// Expand polynomial subexpressions and collect like terms where it makes
+/// tree smaller (see db::collectTerms()), derivatives get it after simplite.
+/// Series don`t get it, their small coefficients and powers stay exact
+/// @param [in] file File for collected tree or nullptr
+void collectTermsTree(db::Tree *tree, FILE *file = nullptr, int *error = nullptr);
+
+/// Replace tree by the cheapest equal tree which rules of e-graph find.
+/// Rules are applied without losing former forms, so greedy choices
+/// of simpliteTree() don`t stop it in worse forms
+/// @param [in] cost Cost of nodes, NODES_COST or CYCLES_COST for example
+/// @param [in] limits Limits of saturation, DEFAULT_SATURATION_LIMITS for example
+/// @param [in] file File for optimized tree and stats or nullptr
+/// @param [out] stats Work of saturation or nullptr
+void optimizeTree(
+                  db::Tree *tree,
+                  const db::CostModel *cost,
+                  const db::SaturationLimits *limits,
+                  FILE *file = nullptr,
+                  db::SaturationStats *stats = nullptr,
+                  int *error = nullptr
+                 );
+
 void executeExpresion(const db::Tree *tree, int *error = nullptr);
 
 double calculateNode(const db::VarTable *table, const db::TreeNode *node);
 
+/// Operator over values, unary operators use only right value
+double calculateOperator(db::operator_t operat, double leftValue, double rightValue);
+
 char *buildGraphics(const db::Plot *plot, int *error = nullptr);
 
 db::Tree calculateTanget(const db::VarTable *table, const db::Tree *tree, int *error = nullptr);
 
+/// Tangent of cached expression, it shares Taylor coefficients with calculateSeries()
+db::Tree calculateTanget(const db::VarTable *table, db::DiffCache *cache, int *error = nullptr);
+
 db::Tree calculateSeries(const db::VarTable *table, const db::Tree *tree, int power, int *error = nullptr);
 
+/// Series of cached expression, coefficients aren`t recalculated
+/// while values of variables are the same
+db::Tree calculateSeries(const db::VarTable *table, db::DiffCache *cache, int power, int *error = nullptr);
+
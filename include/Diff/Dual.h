@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include "Tree.h"
+#include "Variable.h"
+#include "Program.h"
+
+namespace db {
+
+  /// Value of expression and its derivative by one variable
+  /// (forward mode of automatic differentiation)
+  struct Dual {
+    double value;
+    double derivative;
+  };
+
+  /// Operator over dual numbers
+  /// @param [in] operat Operator
+  /// @param [in] left Left operand, it is ignored by unary operators
+  /// @param [in] right Right operand
+  Dual calculateDual(operator_t operat, Dual left, Dual right);
+
+  /// Value and derivative of expression without building derivative tree
+  /// @param [in] table Table of variables
+  /// @param [in] node Expression
+  /// @param [in] variable Name of variable of differentiation
+  /// @return Value is the same as calculateNode() gives
+  Dual calculateDual(const VarTable *table, const TreeNode *node, const char *variable);
+
+  /// Value and derivative of compiled expression
+  /// @param [in] slots Values of variables in layout of VarTable (see loadSlots())
+  /// @param [in] slot Slot of variable of differentiation
+  Dual executeDual(const Program *program, const double *slots, size_t slot, int *error = nullptr);
+
+}
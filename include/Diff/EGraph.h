@@ -0,0 +1,136 @@
+#pragma once
+
+#include <stddef.h>
+#include "Tree.h"
+#include "Rewrite.h"
+
+namespace db {
+
+  /// Index of class or node which isn`t in e-graph
+  const size_t NO_CLASS = (size_t)-1;
+
+  /// Node of e-graph, children are classes or NO_CLASS.
+  /// Unary operators have only right child
+  struct ENode {
+    type_t      type;
+    treeValue_t value;
+    size_t      left;
+    size_t      right;
+    size_t      eclass; ///< Class of node, NO_CLASS if node repeats another one
+    size_t      next;   ///< Next node in bucket of hash table
+  };
+
+  /// Class of equal expressions, classes are joined by union-find
+  struct EClass {
+    size_t   parent;   ///< Class which class was joined to, itself for root
+    size_t   size;     ///< Count of classes joined to root
+    bool     isConst;  ///< Value of class is known, so class has number node
+    number_t constant;
+  };
+
+  /// Expressions where equal subexpressions are one class of nodes.
+  /// Rules add nodes and join classes, so forms before rules are kept
+  /// and the best one is chosen at the end. Names of variables are interned
+  struct EGraph {
+    ENode  *nodes;
+    size_t  nodesCapacity;
+    size_t  nodesCount;
+    EClass *classes;
+    size_t  classesCapacity;
+    size_t  classesCount;
+    size_t *buckets;
+    size_t  bucketsCount;
+    char  **names;
+    size_t  namesCapacity;
+    size_t  namesCount;
+    bool    isClean;       ///< Hash table is up to date with joined classes
+
+    EGraph &operator=(const EGraph &original) = delete;
+  };
+
+  /// Cost of nodes for extraction, costs must be positive
+  struct CostModel {
+    double operators[OPERATORS_COUNT];
+    double number;
+    double variable;
+  };
+
+  /// Every node costs the same, so the smallest tree is chosen
+  const CostModel NODES_COST =
+    {
+      {1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+      1,
+      1
+    };
+
+  /// Rough cycles of evaluation of operators, so the fastest tree is chosen
+  const CostModel CYCLES_COST =
+    {
+      {1, 1, 3, 12, 15, 40, 40, 60, 50, 25},
+      0.5,
+      1
+    };
+
+  /// Limits of saturation, it stops at the first reached one. Time depends
+  /// on load of machine, so result of saturation which it stops does too
+  struct SaturationLimits {
+    size_t maxNodes;      ///< Max nodes of e-graph and matches of one iteration
+    size_t maxIterations;
+    double maxTime;       ///< Seconds, zero means no limit of time
+  };
+
+  /// Nodes and iterations bound saturation, so results are the same every time
+  const SaturationLimits DEFAULT_SATURATION_LIMITS = {10000, 16, 0};
+
+  /// Work of saturation
+  struct SaturationStats {
+    size_t iterations;
+    size_t matches;     ///< Applied matches of rules
+    size_t nodes;
+    size_t classes;
+    bool   isSaturated; ///< Rules add nothing new, so limits weren`t reached
+    double time;        ///< Seconds
+  };
+
+  void createEGraph(EGraph *graph, int *error = nullptr);
+
+  void destroyEGraph(EGraph *graph, int *error = nullptr);
+
+  /// Find node or add new one in new class. Operator over constant
+  /// classes is folded, its class gets number node too
+  /// @param [in] value Value of node, name of variable is copied
+  /// @param [in] left Left child class, it is ignored for unary operators
+  /// @param [in] right Right child class
+  /// @return Class of node or NO_CLASS
+  size_t addENode(EGraph *graph, type_t type, treeValue_t value, size_t left, size_t right, int *error = nullptr);
+
+  /// Add all subtrees of node
+  /// @return Class of node or NO_CLASS
+  size_t addETree(EGraph *graph, const TreeNode *node, int *error = nullptr);
+
+  /// Root of class
+  size_t findEClass(const EGraph *graph, size_t eclass, int *error = nullptr);
+
+  /// Join classes, nodes which became equal are joined by rebuildEGraph()
+  /// @return Root of joined class or NO_CLASS
+  size_t joinEClasses(EGraph *graph, size_t first, size_t second, int *error = nullptr);
+
+  /// Restore hash table and join classes of nodes whose children were joined
+  void rebuildEGraph(EGraph *graph, int *error = nullptr);
+
+  /// Apply rules to all classes until nothing changes or limits are reached.
+  /// Both sides of rule stay in e-graph, so rules may be in both directions
+  /// @param [out] stats Work of saturation or nullptr
+  void saturateEGraph(
+                      EGraph *graph,
+                      const RuleSet *rules,
+                      const SaturationLimits *limits,
+                      SaturationStats *stats = nullptr,
+                      int *error = nullptr
+                     );
+
+  /// The cheapest tree of class
+  /// @return Root of new tree or nullptr
+  TreeNode *extractETree(const EGraph *graph, size_t eclass, const CostModel *cost, int *error = nullptr);
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include "Tree.h"
+#include "Variable.h"
+#include "Program.h"
+#include "Dual.h"
+
+namespace db {
+
+  /// Value and gradient of compiled expression by all variables (reverse
+  /// mode of automatic differentiation). Forward sweep records values of
+  /// instructions on tape, backward sweep accumulates adjoints, so cost
+  /// doesn`t depend on count of variables
+  /// @param [in] slots Values of variables in layout of VarTable (see loadSlots())
+  /// @param [out] gradient Array for program->slots partial derivatives by slots
+  /// @param [out] error Error`s code
+  /// @return Value of expression, the same as executeProgram() gives
+  double executeGradient(const Program *program, const double *slots, double *gradient, int *error = nullptr);
+
+  /// Value and gradient of expression at current values of variables
+  /// @param [in] table Table of variables
+  /// @param [in] tree Expression
+  /// @param [out] gradient Array for table->size partial derivatives by slots,
+  /// variables which expression doesn`t use get zero
+  /// @param [out] error Error`s code
+  /// @return Value of expression
+  double calculateGradient(const VarTable *table, const Tree *tree, double *gradient, int *error = nullptr);
+
+  /// Product of Hessian of compiled expression and direction (forward over
+  /// reverse mode). Reverse sweep runs over dual numbers with derivatives
+  /// along direction, so it costs a few evaluations of expression
+  /// @param [in] slots Values of variables in layout of VarTable
+  /// @param [in] direction Vector of program->slots values
+  /// @param [out] product Array for program->slots values of H * direction
+  /// @param [out] error Error`s code
+  void executeHessianVector(
+                            const Program *program,
+                            const double *slots,
+                            const double *direction,
+                            double *product,
+                            int *error = nullptr
+                           );
+
+  /// Dense Hessian of compiled expression by chosen slots, one
+  /// Hessian-vector product per variable
+  /// @param [in] slots Values of variables in layout of VarTable
+  /// @param [in] variables Slots of variables
+  /// @param [in] count Count of variables
+  /// @param [out] hessian Array for count * count values, row-major
+  /// @param [out] error Error`s code
+  void executeHessian(
+                      const Program *program,
+                      const double *slots,
+                      const size_t *variables,
+                      size_t count,
+                      double *hessian,
+                      int *error = nullptr
+                     );
+
+  /// Product of Hessian of expression at current values of variables and direction
+  /// @param [in] direction Vector of table->size values indexed by slots
+  /// @param [out] product Array for table->size values indexed by slots
+  void calculateHessianVector(
+                              const VarTable *table,
+                              const Tree *tree,
+                              const double *direction,
+                              double *product,
+                              int *error = nullptr
+                             );
+
+  /// Dense Hessian of expression by chosen variables at their current values
+  /// @param [in] variables Names of variables, unknown names get zero rows
+  /// @param [in] count Count of variables
+  /// @param [out] hessian Array for count * count values, row-major
+  void calculateHessian(
+                        const VarTable *table,
+                        const Tree *tree,
+                        const char *const *variables,
+                        size_t count,
+                        double *hessian,
+                        int *error = nullptr
+                       );
+
+}
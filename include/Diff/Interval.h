@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <math.h>
+#include "Tree.h"
+#include "Variable.h"
+#include "Program.h"
+
+namespace db {
+
+  /// Closed interval [lo, hi] of real values. Interval with lo > hi is
+  /// empty, it is result of expression which is undefined on whole box
+  struct Interval {
+    double lo;
+    double hi;
+  };
+
+  const Interval EMPTY_INTERVAL  = {INFINITY, -INFINITY};
+  const Interval ENTIRE_INTERVAL = {-INFINITY, INFINITY};
+
+  inline bool isEmpty(const Interval &interval)
+  {
+    return !(interval.lo <= interval.hi);
+  }
+
+  /// Operator over intervals. Result contains every defined value of
+  /// operator for operands from intervals, bounds are rounded outward
+  /// @param [in] operat Operator
+  /// @param [in] left Left operand, it is ignored by unary operators
+  /// @param [in] right Right operand
+  Interval calculateInterval(operator_t operat, Interval left, Interval right);
+
+  /// Bounds of expression over box
+  /// @param [in] table Table which gives slots of variables
+  /// @param [in] box Intervals of variables indexed by slots of table
+  /// @param [in] node Expression
+  /// @return Interval which contains all values which calculateNode()
+  /// gives for values of variables from box
+  Interval calculateInterval(const VarTable *table, const Interval *box, const TreeNode *node);
+
+  /// Bounds of compiled expression over box indexed by slots
+  Interval executeInterval(const Program *program, const Interval *box, int *error = nullptr);
+
+  /// Bounds of all outputs of compiled program
+  /// @param [out] results Array for program->outputs intervals
+  void executeIntervals(const Program *program, const Interval *box, Interval *results, int *error = nullptr);
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include "Program.h"
+
+namespace db {
+
+  typedef double (*jitFunction_t)(const double *slots, double *stack);
+
+  /// Program translated to x86-64 machine code.
+  /// If JIT is unavailable function is nullptr and program is interpreted
+  struct JitProgram {
+    void *code;
+    size_t size;
+    jitFunction_t function;
+    const Program *program;
+
+    JitProgram &operator=(const JitProgram &original) = delete;
+  };
+
+  /// Check that machine code can be generated and executed
+  bool isJitAvailable();
+
+  /// Translate program to machine code
+  /// @param [out] jit Translated program
+  /// @param [in] program Program for translate, it must live while jit is used
+  /// @param [out] error Error`s code
+  /// @note Operators sin, cos, ln, log and pow call functions of libm
+  void compileJit(JitProgram *jit, const Program *program, int *error = nullptr);
+
+  void destroyJit(JitProgram *jit, int *error = nullptr);
+
+  /// Execute translated program with variables from context
+  double executeJit(const JitProgram *jit, Context *context, int *error = nullptr);
+
+  /// Execute translated program for each value of variable in slot
+  void executeJit(
+                  const JitProgram *jit,
+                  Context *context,
+                  size_t slot,
+                  const double *values,
+                  double *results,
+                  size_t count,
+                  int *error = nullptr
+                 );
+
+  /// Execute translated program with several outputs for each value of variable in slot
+  /// @param [out] results Array of program->outputs rows for count results
+  void executeJitOutputs(
+                         const JitProgram *jit,
+                         Context *context,
+                         size_t slot,
+                         const double *values,
+                         double *const *results,
+                         size_t count,
+                         int *error = nullptr
+                        );
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include "Tree.h"
+#include "Variable.h"
+#include "Program.h"
+
+namespace db {
+
+  /// Directory for generated sources and compiled modules
+  const char *const NATIVE_DIRECTORY = ".temp/native/";
+
+  /// Command for compile generated source: source name, module name
+  const char *const NATIVE_COMPILE_COMMAND =
+    "cc -O2 -march=native -ffp-contract=fast -shared -fPIC -o %s %s -lm";
+
+  const char *const NATIVE_FUNCTION_PREFIX = "expression";
+
+  typedef double (*nativeFunction_t)(const double *slots);
+
+  /// Shared object with one function per tree
+  struct NativeModule {
+    void *handle;
+    nativeFunction_t *functions;
+    size_t functionsCount;
+
+    NativeModule &operator=(const NativeModule &original) = delete;
+  };
+
+  /// Write C source with function expression<i>(const double *slots) for each tree
+  /// @param [out] file File for source
+  /// @param [in] trees Trees for translate
+  /// @param [in] count Count of trees
+  /// @param [in] table Table which gives slots of variables
+  /// @param [out] error Error`s code
+  void generateSource(FILE *file, const Tree *const *trees, size_t count, const VarTable *table, int *error = nullptr);
+
+  /// Generate source, compile it by system compiler and load module.
+  /// Modules are cached in NATIVE_DIRECTORY by hash of source,
+  /// so the same expressions aren`t compiled again
+  void loadNativeModule(NativeModule *module, const Tree *const *trees, size_t count, const VarTable *table, int *error = nullptr);
+
+  /// Load module with functions of expression (0) and its derivative (1)
+  void loadNativeDiff(NativeModule *module, const Tree *tree, const VarTable *table, int *error = nullptr);
+
+  void destroyNativeModule(NativeModule *module, int *error = nullptr);
+
+  /// Call all functions of module for each value of variable in slot
+  /// @param [in] context Context which gives values of other variables
+  /// @param [out] results Array of functionsCount rows for count results
+  void executeNative(
+                     const NativeModule *module,
+                     Context *context,
+                     size_t slot,
+                     const double *values,
+                     double *const *results,
+                     size_t count,
+                     int *error = nullptr
+                    );
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include "Tree.h"
+
+namespace db {
+
+  /// Subtrees which aren`t greater are differentiated by one task
+  const size_t DEFAULT_PARALLEL_THRESHOLD = 1 << 14;
+
+  /// Derivative of tree by variable (not simplified), large trees are differentiated
+  /// by several threads. Subtrees which aren`t greater than threshold and copies of
+  /// operands which nodes over threshold use are tasks, threads take them from own
+  /// queues and steal them from queues of others. Nodes over threshold are built from
+  /// results after that. Rules are the same as for DAG, so derivative is equal to
+  /// expanded derivative of DAG for any count of threads
+  /// @param [in] node Root of tree
+  /// @param [in] variable Name of variable of differentiation
+  /// @param [in] threads Count of threads, zero means count of processors
+  /// @param [in] threshold Max size of subtree which is differentiated by one task
+  /// @param [out] error Error`s code
+  /// @return Root of derivative or nullptr
+  TreeNode *diffParallel(
+                         const TreeNode *node,
+                         const char *variable,
+                         unsigned threads = 0,
+                         size_t threshold = DEFAULT_PARALLEL_THRESHOLD,
+                         int *error = nullptr
+                        );
+
+}
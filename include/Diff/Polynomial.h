@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include "Tree.h"
+
+namespace db {
+
+  /// Index of term which isn`t in polynomial
+  const size_t NO_TERM = (size_t)-1;
+
+  /// Polynomials with more terms are left as trees, so expansion is bounded
+  const size_t MAX_POLYNOMIAL_TERMS = 64;
+
+  /// Max integer power which is expanded by multiplication
+  const long MAX_EXPANDED_POWER = 8;
+
+  /// Max power of atom in monomial
+  const long MAX_FACTOR_POWER = 1 << 16;
+
+  /// Atom in power, atom is any subexpression which isn`t polynomial,
+  /// like variable or sin(x), it is index of its node in Dag
+  struct Factor {
+    size_t atom;
+    long   power;
+  };
+
+  /// Coefficient * product of factors, factors are sorted by atom
+  /// and their powers aren`t zero
+  struct Monomial {
+    number_t coefficient;
+    size_t   factors;      ///< First factor in factors of polynomial
+    size_t   factorsCount;
+    size_t   next;         ///< Next term in bucket of hash table
+  };
+
+  /// Sum of monomials, monomials are hashed by their factors, so like
+  /// terms are collected when they are added. Powers may be negative,
+  /// so quotient by monomial is polynomial too
+  struct Polynomial {
+    Monomial *terms;
+    size_t    termsCapacity;
+    size_t    termsCount;
+    Factor   *factors;
+    size_t    factorsCapacity;
+    size_t    factorsCount;
+    size_t   *buckets;
+    size_t    bucketsCount;
+
+    Polynomial &operator=(const Polynomial &original) = delete;
+  };
+
+  void createPolynomial(Polynomial *polynomial, int *error = nullptr);
+
+  void destroyPolynomial(Polynomial *polynomial, int *error = nullptr);
+
+  /// Add coefficient * factors, coefficient of like term is changed
+  /// @param [in] factors Factors sorted by atom, powers aren`t zero
+  void addMonomial(Polynomial *polynomial, number_t coefficient, const Factor *factors, size_t count, int *error = nullptr);
+
+  /// Add scale * addend
+  void addPolynomial(Polynomial *polynomial, const Polynomial *addend, number_t scale, int *error = nullptr);
+
+  /// Add first * second
+  /// @return Powers of product aren`t over MAX_FACTOR_POWER, else product is partial
+  bool multiplyPolynomials(
+                           Polynomial *polynomial,
+                           const Polynomial *first,
+                           const Polynomial *second,
+                           int *error = nullptr
+                          );
+
+  /// Count of terms whose coefficients aren`t zero
+  size_t countTerms(const Polynomial *polynomial, int *error = nullptr);
+
+  /// Copy of tree where polynomial subexpressions are expanded to sums of
+  /// monomials and like terms are collected, like x * x * 3 + 2 * x * x to
+  /// 5 * x ^ 2. Subexpression is replaced only if its sum is smaller.
+  /// Products which cancel atoms (x / x, x * x ^ -1) stay divisions, but
+  /// sums which cancel them (x - x, (x - x) * ln(x)) become zero, so sum
+  /// is defined where such atom isn`t
+  /// @return Root of new tree or nullptr
+  TreeNode *collectTerms(const TreeNode *node, int *error = nullptr);
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <stddef.h>
+#include "Tree.h"
+#include "Variable.h"
+#include "Dag.h"
+
+namespace db {
+
+  /// Instructions of the postfix evaluation program.
+  /// Operator opcodes go in the same order as operator_t.
+  /// STORE copies top of stack to register, LOAD pushes register
+  enum opcode_t {
+    OPCODE_NUMBER,
+    OPCODE_SLOT,
+    OPCODE_ADD,
+    OPCODE_SUB,
+    OPCODE_MUL,
+    OPCODE_DIV,
+    OPCODE_SQRT,
+    OPCODE_SIN,
+    OPCODE_COS,
+    OPCODE_POW,
+    OPCODE_LOG,
+    OPCODE_LN,
+    OPCODE_STORE,
+    OPCODE_LOAD,
+    OPCODES_COUNT,
+  };
+
+  union argument_t {
+    number_t number;
+    size_t   slot;
+    size_t   index; ///< Register of STORE and LOAD
+  };
+
+  struct Instruction {
+    opcode_t   opcode;
+    argument_t argument;
+  };
+
+  /// Program with variables bound to slots of VarTable.
+  /// slots is count of values which program reads.
+  /// Program leaves outputs values on stack[0..outputs), registers
+  /// are kept in memory of evaluator after depth values of stack
+  struct Program {
+    Instruction *code;
+    size_t capacity;
+    size_t size;
+    size_t depth;
+    size_t slots;
+    size_t registers;
+    size_t outputs;
+
+    Program &operator=(const Program &original) = delete;
+  };
+
+  /// Lower tree to linear postfix program and bind variables to slots
+  /// @param [out] program Program for fill
+  /// @param [in] tree Expression for compile
+  /// @param [in] table Table which gives slots of variables
+  /// @param [out] error Error`s code
+  /// @note Variables which aren`t in table are bound to NAN, so program
+  /// must be compiled again if they were added by updateVarTable()
+  void compileTree(Program *program, const Tree *tree, const VarTable *table, int *error = nullptr);
+
+  /// Compile several trees to one program with output per tree.
+  /// Equal subtrees of all trees are calculated once and kept in registers
+  /// @param [out] program Program for fill
+  /// @param [in] trees Expressions for compile
+  /// @param [in] count Count of trees
+  /// @param [in] table Table which gives slots of variables
+  /// @param [out] error Error`s code
+  void compileFused(Program *program, const Tree *const *trees, size_t count, const VarTable *table, int *error = nullptr);
+
+  /// Compile nodes of DAG to program with output per root
+  void compileDag(
+                  Program *program,
+                  const Dag *dag,
+                  const size_t *roots,
+                  size_t count,
+                  const VarTable *table,
+                  int *error = nullptr
+                 );
+
+  void destroyProgram(Program *program, int *error = nullptr);
+
+  /// Execute program
+  /// @param [in] slots Values of variables in layout of VarTable (see loadSlots())
+  /// @return The same value as calculateNode() for the compiled tree
+  double executeProgram(const Program *program, const double *slots, int *error = nullptr);
+
+  double executeProgram(const Program *program, const VarTable *table, int *error = nullptr);
+
+  /// Execute program with several outputs
+  /// @param [out] results Array for program->outputs values
+  void executeOutputs(const Program *program, const double *slots, double *results, int *error = nullptr);
+
+  /// Buffers of evaluation: snapshot of variables and stack for blocks.
+  /// Context belongs to one thread, programs can be shared between threads
+  struct Context {
+    double *slots;
+    size_t slotsCount;
+    double *stack;
+    size_t stackSize;
+
+    Context &operator=(const Context &original) = delete;
+  };
+
+  /// Create context with copy of variables values from table
+  void createContext(Context *context, const VarTable *table, int *error = nullptr);
+
+  void destroyContext(Context *context, int *error = nullptr);
+
+  /// Grow stack of context to size values
+  void reserveStack(Context *context, size_t size, int *error = nullptr);
+
+  /// Execute program for each value of one variable.
+  /// Evaluation goes instruction by instruction over blocks of values
+  /// with SIMD kernels chosen for the processor at runtime
+  /// @param [in] context Context of the calling thread
+  /// @param [in] slot Slot of variable which takes values
+  /// @param [in] values Values of variable
+  /// @param [out] results Array for results with the same size as values
+  /// @param [in] count Count of values
+  void executeProgram(
+                      const Program *program,
+                      Context *context,
+                      size_t slot,
+                      const double *values,
+                      double *results,
+                      size_t count,
+                      int *error = nullptr
+                     );
+
+  /// Execute program with several outputs for each value of one variable
+  /// @param [out] results Array of program->outputs rows for count results
+  void executeOutputs(
+                      const Program *program,
+                      Context *context,
+                      size_t slot,
+                      const double *values,
+                      double *const *results,
+                      size_t count,
+                      int *error = nullptr
+                     );
+
+}
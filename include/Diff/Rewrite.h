@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include "Tree.h"
+#include "Stack.h"
+
+namespace db {
+
+  /// Index of state, rule or edge which doesn`t exist
+  const size_t NO_RULE = (size_t)-1;
+
+  /// Max count of nodes of left side of rule, so matching is bounded
+  const size_t MAX_PATTERN_SIZE = 32;
+
+  /// Rule like "A ^ b * A ^ c -> A ^ (b + c)". Names of left side match
+  /// any subtree, names which begin with capital letter match positive
+  /// numbers only, repeated names match equal subtrees, numbers match equal
+  /// numbers and operators match the same operators. Names of right side
+  /// are replaced by subtrees which they matched
+  struct RewriteRule {
+    Tree         pattern;         ///< Left side
+    Tree         result;          ///< Right side
+    const char **variables;       ///< Names of left side by first occurrence
+    size_t       variablesCount;
+    size_t      *slots;           ///< Variable of every name of left side in preorder
+    size_t       slotsCount;
+    size_t       next;            ///< Next rule with the same pattern up to names
+  };
+
+  /// State of discrimination tree: symbols of left sides in preorder
+  /// are path from first state, names are one symbol "any subtree"
+  struct MatchState {
+    size_t   operators[OPERATORS_COUNT]; ///< Next state by operator
+    size_t   any;                        ///< Next state by any subtree
+    size_t   numbers;                    ///< First edge by number
+    size_t   rules;                      ///< First rule which ends here
+    unsigned kinds;                      ///< Bits of kinds of subtrees which edges take
+  };
+
+  struct NumberEdge {
+    number_t number;
+    size_t   state;
+    size_t   next;
+  };
+
+  /// Rules compiled to discrimination tree, so node is matched against
+  /// all rules at once and cost of matching doesn`t depend on their count.
+  /// When several rules match, the first added one is applied
+  struct RuleSet {
+    RewriteRule *rules;
+    size_t       rulesCapacity;
+    size_t       rulesCount;
+    MatchState  *states;
+    size_t       statesCapacity;
+    size_t       statesCount;
+    NumberEdge  *numbers;
+    size_t       numbersCapacity;
+    size_t       numbersCount;
+
+    RuleSet &operator=(const RuleSet &original) = delete;
+  };
+
+  void createRuleSet(RuleSet *rules, int *error = nullptr);
+
+  void destroyRuleSet(RuleSet *rules, int *error = nullptr);
+
+  /// Parse rule "pattern -> result" and add it to discrimination tree.
+  /// Rules must decrease expressions somehow, else rewriting doesn`t stop
+  /// @param [in] rule Text of rule, names of result must be in pattern
+  void addRule(RuleSet *rules, const char *rule, int *error = nullptr);
+
+  /// Name of rule matches positive numbers only, so rules which are wrong
+  /// for zero or negative operand (like A ^ b * A ^ c) can be guarded
+  bool isPositiveName(const char *name);
+
+  /// Replace node by result of the first rule which matches it. Subtrees
+  /// which names matched are moved to result (copied if name is used twice)
+  /// @param [in, out] link Link to node, it is changed to result
+  /// @param [out] fresh Stack of links (TreeNode **) or nullptr, links to new
+  /// operators of result are pushed there, children before parents
+  /// @return Was node rewritten
+  bool rewriteNode(const RuleSet *rules, TreeNode **link, Stack *fresh = nullptr, int *error = nullptr);
+
+}
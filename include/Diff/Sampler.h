@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include "Coordinate.h"
+#include "Variable.h"
+
+namespace db {
+
+  /// Code which sampler calculates expressions by
+  enum class Backend {
+    INTERPRETER, ///< Program by blocks with SIMD kernels
+    JIT,         ///< Machine code of program, interpreter if JIT is unavailable
+    NATIVE,      ///< Expressions compiled by system compiler, interpreter if it fails
+  };
+
+  /// Points of one sampled expression sorted by x
+  struct Curve {
+    double *x;
+    double *y;
+    size_t size;
+
+    Curve &operator=(const Curve &original) = delete;
+  };
+
+  /// Sample all expressions of plot adaptively. Sampling starts from coarse
+  /// grid and refines segments where some curve isn`t linear in scale of yRange
+  /// or where it comes to singularity or bound of domain. All curves are
+  /// sampled in the same points by one program, so equal subexpressions
+  /// are calculated once per point. Points are calculated by several threads,
+  /// every thread has own copy of variables, so table isn`t changed
+  /// @param [in] plot Plot for sample, plot->density is max count of points
+  /// @param [in] table Table of variables
+  /// @param [out] curves Array of expressionsCount curves
+  /// @param [in] threads Count of threads, zero means count of processors
+  /// @param [in] backend Code which expressions are calculated by
+  /// @param [out] error Error`s code
+  void sampleCurves(
+                    const Plot *plot,
+                    const VarTable *table,
+                    Curve *curves,
+                    unsigned threads = 0,
+                    Backend backend = Backend::INTERPRETER,
+                    int *error = nullptr
+                   );
+
+  void destroyCurve(Curve *curve, int *error = nullptr);
+
+}
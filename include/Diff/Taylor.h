@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include "Tree.h"
+#include "Variable.h"
+#include "Program.h"
+
+namespace db {
+
+  /// Taylor coefficients of compiled expression by one variable.
+  /// Truncated series are propagated through instructions with the
+  /// recurrences of operators, so every instruction costs O(order^2)
+  /// @param [in] slots Values of variables, slots[slot] is point of expansion
+  /// @param [in] slot Slot of variable of expansion
+  /// @param [in] order Max power of series
+  /// @param [out] coefficients Array for order + 1 coefficients, k-th is f^(k)(x0) / k!
+  /// @param [out] error Error`s code
+  void executeTaylor(
+                     const Program *program,
+                     const double *slots,
+                     size_t slot,
+                     size_t order,
+                     double *coefficients,
+                     int *error = nullptr
+                    );
+
+  /// Taylor coefficients of expression at current value of variable
+  /// @param [in] table Table of variables
+  /// @param [in] tree Expression
+  /// @param [in] variable Name of variable of expansion
+  /// @param [in] order Max power of series
+  /// @param [out] coefficients Array for order + 1 coefficients
+  /// @param [out] error Error`s code
+  void calculateTaylor(
+                       const VarTable *table,
+                       const Tree *tree,
+                       const char *variable,
+                       size_t order,
+                       double *coefficients,
+                       int *error = nullptr
+                      );
+
+}
@@ -7,6 +7,11 @@ namespace db {
 
   const char *const DEFAULT_MAIN_NAME = "x";
 
+  /// Slot of variable which isn`t in table
+  const size_t NO_SLOT = (size_t)-1;
+
+  /// Variable of table. Index in table is slot of variable and it is
+  /// saved in number, new variables are only appended to the end
   struct Variable {
     char *name;
     int number;
@@ -33,4 +38,14 @@ namespace db {
   void updateVarTable(db::VarTable *table, db::TreeNode *expression, int *error = nullptr);
 
   double *searchMainVariable(const VarTable *table, int *error = nullptr);
+
+  double getVariableValue(const VarTable *table, variable_t variable, int *error = nullptr);
+
+  /// Search slot of variable
+  /// @return Index of variable in table or NO_SLOT
+  size_t searchVariableSlot(const VarTable *table, const char *variable, int *error = nullptr);
+
+  /// Copy values of variables to array indexed by slots
+  /// @param [out] slots Array with size not less than table->size
+  void loadSlots(const VarTable *table, double *slots, int *error = nullptr);
 }
@@ -17,4 +17,8 @@
         }                                                               \
     } while (0)
 
+#else
+
+#define assert(EXPRESSION) do {} while (0)
+
 #endif
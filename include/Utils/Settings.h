@@ -2,6 +2,7 @@
 
 #include "Locale.h"
 #include "Variable.h"
+#include "Sampler.h"
 
 /// Name of default directory for files
 const char * const DEFAULT_DIRECTORY = "./resources/";
@@ -9,12 +10,23 @@ const char * const DEFAULT_DIRECTORY = "./resources/";
 const char * const DEFAULT_TARGET_FILE_NAME = "save.tex";
 /// Name of source file if didn`t input anything
 const char * const DEFAULT_SOURCE_FILE_NAME = "save.db";
+/// Max memory of cached derivatives in bytes if didn`t input anything
+const size_t DEFAULT_CACHE_MEMORY = 16 << 20;
+/// Count of threads of differentiation if didn`t input anything
+const unsigned DEFAULT_DIFF_THREADS = 1;
 
 enum class Save {
   TEXT,
   TEX,
 };
 
+/// Cost model which derivatives are optimized by e-graph for
+enum class Optimize {
+  NONE,
+  NODES,
+  CYCLES,
+};
+
 struct Settings {
   char       *source;
   char       *target;
@@ -22,6 +34,12 @@ struct Settings {
   Save   saveType;
   db::VarTable *table;
   db::Locale locale;
+  size_t cacheMemory;
+  unsigned diffThreads;
+  Optimize optimize;
+  double   optimizeTime; ///< Max seconds of optimization, zero means no limit
+  db::Backend backend; ///< Code which plots are sampled by
+  bool   isBatch;
 };
 
 void setSettings(const Settings *settings);
@@ -0,0 +1,88 @@
+#include "Stack.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "SystemLike.h"
+#include "Assert.h"
+#include "Error.h"
+
+const int DEFAULT_GROWTH_FACTOR = 2;
+
+void db::createStack(db::Stack *stack, size_t elementSize, int *error)
+{
+  if (!stack || !elementSize)
+    ERROR();
+
+  stack->data        = nullptr;
+  stack->elementSize = elementSize;
+  stack->capacity    = 0;
+  stack->size        = 0;
+}
+
+void db::destroyStack(db::Stack *stack, int *error)
+{
+  if (!stack)
+    ERROR();
+
+  free(stack->data);
+
+  stack->data     = nullptr;
+  stack->capacity = 0;
+  stack->size     = 0;
+}
+
+bool db::push(db::Stack *stack, const void *element, int *error)
+{
+  if (!stack || !element)
+    ERROR(false);
+
+  if (stack->size == stack->capacity)
+    {
+      char *temp =
+        (char *)recalloc(
+                         stack->data,
+                         (stack->capacity + 1)*DEFAULT_GROWTH_FACTOR,
+                         stack->elementSize
+                        );
+      if (!temp)
+        ERROR(false);
+
+      stack->data = temp;
+
+      ++stack->capacity;
+      stack->capacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  memcpy(stack->data + stack->size++ * stack->elementSize, element, stack->elementSize);
+
+  return true;
+}
+
+bool db::pop(db::Stack *stack, void *element, int *error)
+{
+  if (!stack || !stack->size)
+    ERROR(false);
+
+  --stack->size;
+
+  if (element)
+    memcpy(element, stack->data + stack->size * stack->elementSize, stack->elementSize);
+
+  return true;
+}
+
+void *db::top(const db::Stack *stack, int *error)
+{
+  if (!stack || !stack->size)
+    ERROR(nullptr);
+
+  return stack->data + (stack->size - 1) * stack->elementSize;
+}
+
+bool db::isEmpty(const db::Stack *stack, int *error)
+{
+  if (!stack)
+    ERROR(true);
+
+  return !stack->size;
+}
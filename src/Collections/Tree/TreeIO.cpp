@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "Settings.h"
+#include "Stack.h"
 #include "SystemLike.h"
 #include "Fiofunctions.h"
 #include "StringsUtils.h"
@@ -19,6 +20,8 @@ static_assert(MAX_NAME_SIZE > 0);
 const int MAX_LEXEME_SIZE = 48;
 static_assert(MAX_LEXEME_SIZE >= db::MAX_VARIABLE_SIZE);
 
+const int DEFAULT_GROWTH_FACTOR = 2;
+
 static char *toString(const db::treeValue_t value, db::type_t type);
 
 static db::treeValue_t toValue(const char *string, int *error);
@@ -96,33 +99,173 @@ void db::loadTree(
 
   readFile(&buffer, fileName);
 
-  bool hasError = false;
-
-  *tree = getGeneral(buffer, &hasError);
+  db::parseTree(tree, buffer, error);
 
   free(buffer);
+}
+
+void db::parseTree(db::Tree *tree, const char *source, int *error)
+{
+  CHECK_VALID(tree, error);
+
+  if (!source) ERROR();
+
+  bool hasError = false;
+
+  *tree = getGeneral(source, &hasError);
 
   if (hasError) ERROR();
 
   CHECK_VALID(tree, error);
 }
 
+void db::loadTrees(db::Tree **trees, size_t *count, const char *fileName, int *error)
+{
+  if (!trees || !count || !fileName) ERROR();
+
+  *trees = nullptr;
+  *count = 0;
+
+  char *buffer = nullptr;
+
+  size_t size = readFile(&buffer, fileName);
+
+  if (
+      size == (size_t)FIOFUNCTIONS_OUT_OF_MEM  ||
+      size == (size_t)FIOFUNCTIONS_FAIL_TO_OPEN ||
+      size == (size_t)FIOFUNCTIONS_INCORRECT_ARGUMENTS
+     )
+    ERROR();
+
+  size_t capacity   = 0;
+  size_t lineNumber = 0;
+
+  bool hasError = false;
+
+  for (char *line = buffer; line && *line && !hasError; )
+    {
+      ++lineNumber;
+
+      char *end = strchr(line, '\n');
+
+      if (end)
+        *end = '\0';
+
+      const char *current = line;
+
+      line = end ? end + 1 : nullptr;
+
+      while (isspace(*current)) ++current;
+
+      if (!*current)
+        continue;
+
+      if (*count == capacity)
+        {
+          db::Tree *temp =
+            (db::Tree *)recalloc(
+                                 *trees,
+                                 (capacity + 1)*DEFAULT_GROWTH_FACTOR,
+                                 sizeof(db::Tree)
+                                );
+          if (!temp)
+            {
+              hasError = true;
+
+              break;
+            }
+
+          *trees = temp;
+
+          ++capacity;
+          capacity *= DEFAULT_GROWTH_FACTOR;
+        }
+
+      db::Tree *tree = &(*trees)[*count];
+
+      db::createTree(tree);
+
+      int errorCode = 0;
+
+      db::parseTree(tree, current, &errorCode);
+
+      if (errorCode)
+        {
+          handleError("Invalid expression in line %zu of file [%s]", lineNumber, fileName);
+
+          db::destroyTree(tree);
+
+          hasError = true;
+        }
+      else
+        ++*count;
+    }
+
+  free(buffer);
+
+  if (hasError)
+    {
+      for (size_t i = 0; i < *count; ++i)
+        db::destroyTree(&(*trees)[i]);
+
+      free(*trees);
+
+      *trees = nullptr;
+      *count = 0;
+
+      ERROR();
+    }
+}
+
+/// Node which is printed, stage is count of its printed parts
+struct PrintFrame {
+  const db::TreeNode *node;
+  int                 stage;
+};
+
 static void printNode(const db::TreeNode *node, FILE *file)
 {
   assert(node);
   assert(file);
 
-  fprintf(file, "(");
+  db::Stack stack{};
+
+  db::createStack(&stack, sizeof(PrintFrame));
+
+  PrintFrame frame = {node, 0};
 
-  if (node->left)
-    printNode(node->left, file);
+  bool isPushed = db::push(&stack, &frame);
 
-  fprintf(file, "%s", toString(node->value, node->type));
+  while (isPushed && !db::isEmpty(&stack))
+    {
+      PrintFrame *current = (PrintFrame *)db::top(&stack);
 
-  if (node->right)
-    printNode(node->right, file);
+      const db::TreeNode *child = nullptr;
 
-  fprintf(file, ")");
+      switch (current->stage++)
+        {
+        case 0:
+          fprintf(file, "(");
+          child = current->node->left;
+          break;
+        case 1:
+          fprintf(file, "%s", toString(current->node->value, current->node->type));
+          child = current->node->right;
+          break;
+        default:
+          fprintf(file, ")");
+          db::pop(&stack);
+          break;
+        }
+
+      if (child)
+        {
+          frame    = {child, 0};
+          isPushed = db::push(&stack, &frame);
+        }
+    }
+
+  db::destroyStack(&stack);
 }
 
 static char *toString(const db::treeValue_t value, db::type_t type)
@@ -149,104 +292,130 @@ static char *toString(const db::treeValue_t value, db::type_t type)
   return buffer;
 }
 
+/// Node which is scanned, node is nullptr while its left child is scanned
+struct ScanFrame {
+  db::TreeNode *left;
+  db::TreeNode *node;
+};
+
 static db::TreeNode *scanNode(FILE *file, int *error)
 {
   assert(file);
   assert(error);
 
-  char ch = '\0';
+  db::Stack stack{};
 
-  if (!fscanf(file, " %c", &ch) || ch != '(')
+  db::createStack(&stack, sizeof(ScanFrame));
+
+  db::TreeNode *result   = nullptr;
+  bool          isOpened = false;
+
+  do
     {
-      if (ch != EOF) ungetc(ch, file);
+      char ch = '\0';
 
-      return nullptr;
-    }
+      int count = fscanf(file, " %c", &ch);
+
+      isOpened = count == 1 && ch == '(';
+
+      if (isOpened)
+        {
+          ScanFrame frame = {nullptr, nullptr};
 
-    db::TreeNode *leftChild = scanNode(file, error);
+          if (!db::push(&stack, &frame))
+            *error = true;
 
-    if (*error) return nullptr;
+          continue;
+        }
 
-    db::TreeNode *newNode = nullptr;
+      if (count == 1)
+        ungetc(ch, file);
 
-    char buff[MAX_LEXEME_SIZE] = "";
+      // Child is absent, so nodes are finished until one which waits for right child
+      result = nullptr;
 
-    if (fscanf(file, " %[^ ()]", buff) == 1)
-      {
-        trimString(buff);
+      while (!*error && !db::isEmpty(&stack))
+        {
+          ScanFrame *frame = (ScanFrame *)db::top(&stack);
 
-        db::treeValue_t value = toValue(buff, error);
+          if (!frame->node)
+            {
+              frame->left = result;
+              result      = nullptr;
 
-        if (*error)
-          {
-            if (leftChild) db::removeNode(leftChild);
+              char buff[MAX_LEXEME_SIZE] = "";
 
-            return nullptr;
-          }
+              if (fscanf(file, " %[^ ()]", buff) != 1)
+                {
+                  *error = true;
 
-        db::type_t type = getType(buff, error);
+                  break;
+                }
 
-        if (*error)
-          {
-            if (leftChild) db::removeNode(leftChild);
+              trimString(buff);
 
-            return nullptr;
-          }
+              db::treeValue_t value = toValue(buff, error);
 
-        bool isNodeBinary = isBinary(value, type);
+              if (*error)
+                break;
 
-        if (( isNodeBinary && !leftChild) ||
-            (!isNodeBinary &&  leftChild))
-          {
-            db::removeNode(leftChild);
+              db::type_t type = getType(buff, error);
 
-            return nullptr;
-          }
+              if (!*error && isBinary(value, type) != (bool)frame->left)
+                *error = true;
 
-        newNode = createNode(value, type, error);
+              if (!*error)
+                frame->node = db::createNode(value, type, error);
 
-        if (type == db::type_t::VARIABLE)
-          free(value.variable);
+              if (type == db::type_t::VARIABLE)
+                free(value.variable);
 
-        if (*error)
-          {
-            if (leftChild) db::removeNode(leftChild);
+              if (*error)
+                break;
 
-            return nullptr;
-          }
-      }
-    else
-      {
-        if (leftChild) db::removeNode(leftChild);
+              frame->node->left = frame->left;
+              frame->left       = nullptr;
 
-        return nullptr;
-      }
+              break;
+            }
 
-    db::TreeNode *rightChild = scanNode(file, error);
+          frame->node->right = result;
+          result             = nullptr;
 
-    newNode->left  = leftChild;
-    newNode->right = rightChild;
+          if (
+              hasRightOperant(frame->node) != (bool)frame->node->right ||
+              fscanf(file, " %c", &ch) != 1 || ch != ')'
+             )
+            {
+              *error = true;
 
-    bool hasNodeRightOperant = hasRightOperant(newNode);
+              break;
+            }
 
-    if (( hasNodeRightOperant && !rightChild) ||
-        (!hasNodeRightOperant && rightChild))
-      {
-        db::removeNode(newNode);
+          result = frame->node;
 
-        return nullptr;
-      }
+          db::pop(&stack);
+        }
+    } while (!*error && !db::isEmpty(&stack));
 
-    if (*error || !fscanf(file, " %c", &ch) || ch != ')')
+  if (*error)
     {
-      *error = true;
+      ScanFrame frame{};
 
-      if (newNode) removeNode(newNode);
+      while (db::pop(&stack, &frame))
+        {
+          if (frame.node) db::removeNode(frame.node);
+          if (frame.left) db::removeNode(frame.left);
+        }
+
+      if (result) db::removeNode(result);
 
-      return nullptr;
+      result = nullptr;
     }
 
-  return newNode;
+  db::destroyStack(&stack);
+
+  return result;
 }
 
 static db::treeValue_t toValue(const char *string, int *error)
@@ -363,12 +532,22 @@ static void skipSpaces(const char **source, bool *fail);
 
 //static db::Tree      getGeneral          (const char *source, bool *fail);
 static db::TreeNode *getExpression       (const char **source, bool *fail);
-static db::TreeNode *getTermin           (const char **source, bool *fail);
-static db::TreeNode *getPrimaryExpression(const char **source, bool *fail);
-static db::TreeNode *getFunction         (const char **source, bool *fail);
 static db::TreeNode *getNumber           (const char **source, bool *fail);
 static db::TreeNode *getName             (const char **source, bool *fail);
 
+/// Operator, bracket or function which waits for its operands
+struct ParserFrame {
+  char          operat;   ///< One of "+-*/^", '(' or FUNCTION_FRAME
+  db::TreeNode *function; ///< Name of function for FUNCTION_FRAME
+};
+
+const char FUNCTION_FRAME = 'f';
+
+static int  getPriority(char operat);
+static bool reduceOperator(db::Stack *operands, db::Stack *operators);
+static bool reduceFunctions(db::Stack *operands, db::Stack *operators, bool *fail);
+static void clearParser(db::Stack *operands, db::Stack *operators);
+
 static db::TreeNode *createNumber(db::number_t value);
 static db::TreeNode *createVariable(db::variable_t value);
 
@@ -421,136 +600,256 @@ static db::Tree getGeneral(const char *source, bool *fail)
   return value;
 }
 
+/// Expression is parsed by operator precedence with explicit stacks of
+/// operands and operators, so depth of brackets doesn`t use native stack.
+/// Name which is followed by bracket, name or number is function
 static db::TreeNode *getExpression(const char **source, bool *fail)
 {
   if (!source || !*source || !fail) FAIL(nullptr);
 
-  db::TreeNode *value = getTermin(source, fail);
+  db::Stack operands {};
+  db::Stack operators{};
 
-  skipSpaces(source, fail);
+  db::createStack(&operands , sizeof(db::TreeNode *));
+  db::createStack(&operators, sizeof(ParserFrame   ));
+
+  size_t brackets    = 0;
+  bool   needOperand = true;
+  bool   isFinished  = false;
 
-  while (strchr("+-", **source) && **source)
+  while (!*fail && !isFinished)
     {
-      char operat = *(*source)++;
+      skipSpaces(source, fail);
 
-      db::TreeNode *tempValue = getTermin(source, fail);
+      char ch = **source;
 
-      if (operat == '+')
-        value = ADD(value, tempValue);
-      else
-        value = SUB(value, tempValue);
+      if (needOperand && ch == '(')
+        {
+          ++*source;
 
-      skipSpaces(source, fail);
-    }
+          ParserFrame frame = {'(', nullptr};
 
-  return value;
-}
+          *fail = !db::push(&operators, &frame);
 
-static db::TreeNode *getTermin(const char **source, bool *fail)
-{
-  if (!source || !*source || !fail) FAIL(nullptr);
+          ++brackets;
+        }
+      else if (needOperand)
+        {
+          bool isntName = false;
 
-  db::TreeNode *value = getFunction(source, fail);
+          db::TreeNode *operand = getName(source, &isntName);
 
-  skipSpaces(source, fail);
+          skipSpaces(source, fail);
 
-  while (strchr("*/", **source) && **source)
-    {
-      char operat = *(*source)++;
+          if (!isntName && (**source == '(' || isalnum(**source)))
+            {
+              ParserFrame frame = {FUNCTION_FRAME, operand};
 
-      db::TreeNode *tempValue = getFunction(source, fail);
+              if (!db::push(&operators, &frame))
+                {
+                  db::removeNode(operand);
 
-      if (operat == '*')
-        value = MUL(value, tempValue);
-      else
-        value = DIV(value, tempValue);
+                  *fail = true;
+                }
 
-      skipSpaces(source, fail);
-    }
+              continue;
+            }
 
-  return value;
-}
+          if (isntName)
+            operand = getNumber(source, fail);
 
-static db::TreeNode *getFunction(const char **source, bool *fail)
-{
-  if (!source || !*source || !fail) FAIL(nullptr);
+          if (!operand)
+            {
+              handleError("Expected operand, but found '%c'=%d", isprint(**source) ? **source : '~', **source);
 
-  bool isntFunction = false;
+              *fail = true;
+            }
+          else if (!db::push(&operands, &operand))
+            {
+              db::removeNode(operand);
 
-  db::TreeNode *value = getName(source, &isntFunction);
+              *fail = true;
+            }
+          else if (reduceFunctions(&operands, &operators, fail))
+            needOperand = false;
+        }
+      else if (ch && strchr("+-*/^", ch))
+        {
+          ++*source;
 
-  if (!isntFunction)
-    {
-      SET_TO_OPERATOR(value);
+          ParserFrame *top = nullptr;
 
-      value->right = getPrimaryExpression(source, &isntFunction);
+          // Power is right associative, so equal power on top waits
+          while (
+                 (top = (ParserFrame *)db::top(&operators)) &&
+                 getPriority(top->operat) >= getPriority(ch) + (ch == '^') &&
+                 reduceOperator(&operands, &operators)
+                )
+            continue;
 
-      if (isntFunction)
-        {
-          SET_TO_VARIABLE(value);
+          ParserFrame frame = {ch, nullptr};
+
+          *fail = !db::push(&operators, &frame);
 
-          return value;
+          needOperand = true;
         }
+      else if (ch == ')' && brackets)
+        {
+          ++*source;
 
-      for (int i = 0; i < db::OPERATORS_COUNT; ++i)
-        if (!strcmp(db::OPERATOR_NAMES[i], VARIABLE(value)))
-          {
-            OPERATOR(value) = (db::operator_t)i;
+          ParserFrame *top = nullptr;
 
-            break;
-          }
+          while ((top = (ParserFrame *)db::top(&operators)) && top->operat != '(')
+            if (!reduceOperator(&operands, &operators))
+              *fail = true;
 
-      if (OPERATOR(value) >= db::OPERATORS_COUNT || OPERATOR(value) < 0)
-        {
-          handleError("Unknown function \"%s\"", VARIABLE(value));
+          db::pop(&operators);
 
-          db::removeNode(value);
+          --brackets;
 
-          return nullptr;
+          reduceFunctions(&operands, &operators, fail);
         }
+      else
+        isFinished = true;
     }
-  else
-    value = getPrimaryExpression(source, fail);
+
+  if (!*fail && brackets)
+    {
+      handleError("Expected ')', but found '%c'=%d", isprint(**source) ? **source : '~', **source);
+
+      *fail = true;
+    }
+
+  while (!*fail && !db::isEmpty(&operators))
+    *fail = !reduceOperator(&operands, &operators);
+
+  db::TreeNode *value = nullptr;
+
+  if (!*fail)
+    db::pop(&operands, &value);
+
+  clearParser(&operands, &operators);
 
   return value;
 }
 
-static db::TreeNode *getPrimaryExpression(const char **source, bool *fail)
+static int getPriority(char operat)
 {
-  if (!source || !*source || !fail) FAIL(nullptr);
+  switch (operat)
+    {
+    case '+': case '-': return 1;
+    case '*': case '/': return 2;
+    case '^':           return 3;
+    default:            return 0;
+    }
+}
 
-  db::TreeNode *value = nullptr;
+/// Replace two operands by operator on top of stack
+static bool reduceOperator(db::Stack *operands, db::Stack *operators)
+{
+  assert(operands);
+  assert(operators);
 
-  skipSpaces(source, fail);
+  ParserFrame   frame = {};
+  db::TreeNode *left  = nullptr;
+  db::TreeNode *right = nullptr;
 
-  if (**source == '(')
-    {
-      value = getExpression(&++*source, fail);
+  if (!db::pop(operators, &frame) || !strchr("+-*/^", frame.operat))
+    return false;
 
-      skipSpaces(source, fail);
+  db::pop(operands, &right);
+  db::pop(operands, &left );
 
-      char ch = **source;
-      if (ch != ')')
-        {
-          handleError("Expected '(', but found '%c'=%d", isprint(ch) ? ch : '~', ch);
+  db::TreeNode *value = nullptr;
 
-          if (value) db::removeNode(value);
+  if (left && right)
+    switch (frame.operat)
+      {
+      case '+': value = ADD(left, right); break;
+      case '-': value = SUB(left, right); break;
+      case '*': value = MUL(left, right); break;
+      case '^': value = POW(left, right); break;
+      default : value = DIV(left, right); break;
+      }
 
-          FAIL(nullptr);
+  if (!value || !db::push(operands, &value))
+    {
+      if (value) db::removeNode(value);
+      else
+        {
+          if (left ) db::removeNode(left );
+          if (right) db::removeNode(right);
         }
 
-      ++*source;
+      return false;
     }
-  else
+
+  return true;
+}
+
+/// Apply functions on top of stack to operand which was just finished
+/// @return Are all functions known
+static bool reduceFunctions(db::Stack *operands, db::Stack *operators, bool *fail)
+{
+  assert(operands);
+  assert(operators);
+  assert(fail);
+
+  ParserFrame *top = nullptr;
+
+  while (!*fail && (top = (ParserFrame *)db::top(operators)) && top->operat == FUNCTION_FRAME)
     {
-      bool hasntVariable = false;
-      value = getName(source, &hasntVariable);
+      ParserFrame frame = {};
+
+      db::pop(operators, &frame);
+
+      int operat = 0;
+
+      while (operat < db::OPERATORS_COUNT && strcmp(db::OPERATOR_NAMES[operat], VARIABLE(frame.function)))
+        ++operat;
+
+      if (operat == db::OPERATORS_COUNT)
+        handleError("Unknown function \"%s\"", VARIABLE(frame.function));
+
+      db::removeNode(frame.function);
+
+      db::TreeNode *operand = nullptr;
 
-      if (hasntVariable)
-        value = getNumber(source, fail);
+      db::pop(operands, &operand);
+
+      db::TreeNode *value =
+        operat == db::OPERATORS_COUNT ? nullptr :
+        db::createNode({.operat = (db::operator_t)operat}, db::type_t::OPERATOR, nullptr, operand);
+
+      if (!value || !db::push(operands, &value))
+        {
+          db::removeNode(value ? value : operand);
+
+          *fail = true;
+        }
     }
 
-  return value;
+  return !*fail;
+}
+
+static void clearParser(db::Stack *operands, db::Stack *operators)
+{
+  assert(operands);
+  assert(operators);
+
+  db::TreeNode *operand = nullptr;
+
+  while (db::pop(operands, &operand))
+    db::removeNode(operand);
+
+  ParserFrame frame = {};
+
+  while (db::pop(operators, &frame))
+    if (frame.function)
+      db::removeNode(frame.function);
+
+  db::destroyStack(operands );
+  db::destroyStack(operators);
 }
 
 static db::TreeNode *getNumber(const char **source, bool *fail)
@@ -584,7 +883,18 @@ static db::TreeNode *getName(const char **source, bool *fail)
   const char *startPosition = *source;
 
   while (isalpha(**source))
-    buffer[i++] = *(*source)++;
+    {
+      if (i >= MAX_NAME_SIZE - 1)
+        {
+          handleError("Name is longer than %d letters", MAX_NAME_SIZE - 1);
+
+          *source = startPosition;
+
+          FAIL(nullptr);
+        }
+
+      buffer[i++] = *(*source)++;
+    }
 
   if (*source <= startPosition) { *fail = true; return nullptr; }
 
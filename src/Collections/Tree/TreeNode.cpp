@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include "Stack.h"
 #include "Assert.h"
 
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -76,26 +77,63 @@ db::TreeNode *db::createNode(db::treeValue_t value, db::type_t type, db::TreeNod
   return node;
 }
 
+/// Node of original which must be copied to link
+struct CopyFrame {
+  const db::TreeNode  *original;
+  db::TreeNode        *parent;
+  db::TreeNode       **link;
+};
+
 db::TreeNode *db::createNode(const db::TreeNode *original, int *error)
 {
   if (!original)
     ERROR(nullptr);
 
-  int errorCode = 0;
+  db::TreeNode *root = nullptr;
 
-  db::TreeNode *node =
-    createNode(
-               original->value,
-               original->type,
-               original->left ? db::createNode(original->left) : nullptr,
-               original->right ? db::createNode(original->right) : nullptr,
-               &errorCode
-               );
+  db::Stack stack{};
 
-  if (errorCode)
-    ERROR(nullptr);
+  db::createStack(&stack, sizeof(CopyFrame));
 
-  return node;
+  CopyFrame frame = {original, nullptr, &root};
+
+  bool isCopied = db::push(&stack, &frame);
+
+  while (isCopied && db::pop(&stack, &frame))
+    {
+      db::TreeNode *node = createNode(frame.original->value, frame.original->type);
+
+      if (!node)
+        {
+          isCopied = false;
+
+          break;
+        }
+
+      node->parent = frame.parent;
+      *frame.link  = node;
+
+      CopyFrame left  = {frame.original->left , node, &node->left };
+      CopyFrame right = {frame.original->right, node, &node->right};
+
+      if (
+          (left .original && !db::push(&stack, &left )) ||
+          (right.original && !db::push(&stack, &right))
+         )
+        isCopied = false;
+    }
+
+  db::destroyStack(&stack);
+
+  if (!isCopied)
+    {
+      if (root)
+        db::removeNode(root);
+
+      ERROR(nullptr);
+    }
+
+  return root;
 }
 
 db::TreeNode *db::setParent(db::TreeNode *child, db::TreeNode *parent, int leftChild, int *error)
@@ -113,18 +151,33 @@ db::TreeNode *db::setParent(db::TreeNode *child, db::TreeNode *parent, int leftC
   return child;
 }
 
+/// Left child is rotated up until node has no left child, then node is
+/// removed and its right child is next, so no stack is needed
 void db::removeNode(db::TreeNode *node, int *error)
 {
   assert(node);
 
-  if (node->left)
-    removeNode(node->left);
+  while (node)
+    {
+      if (node->left)
+        {
+          db::TreeNode *left = node->left;
+
+          node->left  = left->right;
+          left->right = node;
 
-  if (node->right)
-    removeNode(node->right);
+          node = left;
+
+          continue;
+        }
 
-  if (node->type == db::type_t::VARIABLE)
-      free(node->value.variable);
+      db::TreeNode *right = node->right;
 
-  free(node);
+      if (node->type == db::type_t::VARIABLE)
+        free(node->value.variable);
+
+      free(node);
+
+      node = right;
+    }
 }
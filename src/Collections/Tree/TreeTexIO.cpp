@@ -2,6 +2,7 @@
 #include "TreeDump.h"
 #include "DiffDSL.h"
 
+#include "Stack.h"
 #include "Assert.h"
 #include <string.h>
 
@@ -59,33 +60,70 @@ void db::saveTexTree(const db::Tree *tree, FILE *file, int *error)
     }
 }
 
+/// Node which is printed, stage is count of its printed parts
+struct PrintFrame {
+  const db::TreeNode *node;
+  int                 stage;
+};
+
 static void printNode(const db::TreeNode *node, FILE *file)
 {
   assert(node);
   assert(file);
 
-  fprintf(file, "{");
+  db::Stack stack{};
 
-  bool needForLeft  = Left &&
-    IS_IT_OPERATOR(node, OPERATOR_POW) && IS_OPERATOR(Left);
-  bool needForRight = Right &&
-    (IS_IT_OPERATOR(node, OPERATOR_SIN ) ||
-     IS_IT_OPERATOR(node, OPERATOR_COS ) ||
-     IS_IT_OPERATOR(node, OPERATOR_SQRT) ||
-     IS_IT_OPERATOR(node, OPERATOR_LOG ) ||
-     IS_IT_OPERATOR(node, OPERATOR_LN  )) && IS_OPERATOR(Right);
+  db::createStack(&stack, sizeof(PrintFrame));
 
-  if (needForLeft) fprintf(file, "(");
-  if (node->left) printNode(node->left, file);
-  if (needForLeft) fprintf(file, ")");
+  PrintFrame frame = {node, 0};
 
-  fprintf(file, " %s ", toString(node->value, node->type));
+  bool isPushed = db::push(&stack, &frame);
 
-  if (needForRight) fprintf(file, "(");
-  if (node->right) printNode(node->right, file);
-  if (needForRight) fprintf(file, ")");
+  while (isPushed && !db::isEmpty(&stack))
+    {
+      PrintFrame *current = (PrintFrame *)db::top(&stack);
+
+      node = current->node;
+
+      bool needForLeft  = Left &&
+        IS_IT_OPERATOR(node, OPERATOR_POW) && IS_OPERATOR(Left);
+      bool needForRight = Right &&
+        (IS_IT_OPERATOR(node, OPERATOR_SIN ) ||
+         IS_IT_OPERATOR(node, OPERATOR_COS ) ||
+         IS_IT_OPERATOR(node, OPERATOR_SQRT) ||
+         IS_IT_OPERATOR(node, OPERATOR_LOG ) ||
+         IS_IT_OPERATOR(node, OPERATOR_LN  )) && IS_OPERATOR(Right);
+
+      const db::TreeNode *child = nullptr;
+
+      switch (current->stage++)
+        {
+        case 0:
+          fprintf(file, "{");
+          if (needForLeft) fprintf(file, "(");
+          child = node->left;
+          break;
+        case 1:
+          if (needForLeft) fprintf(file, ")");
+          fprintf(file, " %s ", toString(node->value, node->type));
+          if (needForRight) fprintf(file, "(");
+          child = node->right;
+          break;
+        default:
+          if (needForRight) fprintf(file, ")");
+          fprintf(file, "}");
+          db::pop(&stack);
+          break;
+        }
+
+      if (child)
+        {
+          frame    = {child, 0};
+          isPushed = db::push(&stack, &frame);
+        }
+    }
 
-  fprintf(file, "}");
+  db::destroyStack(&stack);
 }
 
 static char *toString(const db::treeValue_t value, db::type_t type)
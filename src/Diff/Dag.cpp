@@ -0,0 +1,432 @@
+#include "Dag.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "Stack.h"
+#include "SystemLike.h"
+#include "Assert.h"
+#include "Error.h"
+
+const int DEFAULT_GROWTH_FACTOR = 2;
+
+const size_t DEFAULT_BUCKETS_COUNT = 64;
+
+static uint64_t hashNode(db::type_t type, db::treeValue_t value, size_t left, size_t right);
+
+static bool isEqualNode(const db::DagNode *node, db::type_t type, db::treeValue_t value, size_t left, size_t right);
+
+static char *internName(db::Dag *dag, const char *name, size_t *index);
+
+static db::dependency_t getNameBit(size_t index);
+
+static bool growNodes(db::Dag *dag);
+
+static bool rehash(db::Dag *dag, size_t bucketsCount);
+
+void db::createDag(db::Dag *dag, int *error)
+{
+  if (!dag)
+    ERROR();
+
+  dag->nodes         = nullptr;
+  dag->capacity      = 0;
+  dag->size          = 0;
+  dag->buckets       = nullptr;
+  dag->bucketsCount  = 0;
+  dag->names         = nullptr;
+  dag->namesCapacity = 0;
+  dag->namesCount    = 0;
+
+  if (!rehash(dag, DEFAULT_BUCKETS_COUNT))
+    ERROR();
+}
+
+void db::destroyDag(db::Dag *dag, int *error)
+{
+  if (!dag)
+    ERROR();
+
+  for (size_t i = 0; i < dag->namesCount; ++i)
+    free(dag->names[i]);
+
+  free(dag->names);
+  free(dag->nodes);
+  free(dag->buckets);
+
+  dag->nodes         = nullptr;
+  dag->capacity      = 0;
+  dag->size          = 0;
+  dag->buckets       = nullptr;
+  dag->bucketsCount  = 0;
+  dag->names         = nullptr;
+  dag->namesCapacity = 0;
+  dag->namesCount    = 0;
+}
+
+size_t db::addDagNode(db::Dag *dag, db::type_t type, db::treeValue_t value, size_t left, size_t right, int *error)
+{
+  if (!dag || !dag->buckets)
+    ERROR(db::NO_NODE);
+
+  if ((left != db::NO_NODE && left >= dag->size) || (right != db::NO_NODE && right >= dag->size))
+    ERROR(db::NO_NODE);
+
+  if (type == db::type_t::OPERATOR && db::isUnary(value.operat))
+    left = db::NO_NODE;
+
+  if (type != db::type_t::OPERATOR)
+    left = right = db::NO_NODE;
+
+  db::dependency_t depends = 0;
+
+  if (type == db::type_t::VARIABLE)
+    {
+      size_t name = 0;
+
+      value.variable = internName(dag, value.variable, &name);
+
+      if (!value.variable)
+        ERROR(db::NO_NODE);
+
+      depends = getNameBit(name);
+    }
+
+  if (left  != db::NO_NODE) depends |= dag->nodes[left ].depends;
+  if (right != db::NO_NODE) depends |= dag->nodes[right].depends;
+
+  uint64_t hash = hashNode(type, value, left, right);
+
+  for (size_t index = dag->buckets[hash % dag->bucketsCount]; index != db::NO_NODE; index = dag->nodes[index].next)
+    if (isEqualNode(&dag->nodes[index], type, value, left, right))
+      return index;
+
+  if (dag->size >= dag->bucketsCount && !rehash(dag, dag->bucketsCount * DEFAULT_GROWTH_FACTOR))
+    ERROR(db::NO_NODE);
+
+  if (dag->size == dag->capacity && !growNodes(dag))
+    ERROR(db::NO_NODE);
+
+  size_t bucket = hash % dag->bucketsCount;
+
+  dag->nodes[dag->size] = {type, value, left, right, depends, dag->buckets[bucket]};
+
+  dag->buckets[bucket] = dag->size;
+
+  return dag->size++;
+}
+
+/// Node of tree which is added after its children
+struct AddFrame {
+  const db::TreeNode *node;
+  bool                isVisited;
+};
+
+size_t db::addDagTree(db::Dag *dag, const db::TreeNode *node, int *error)
+{
+  if (!dag || !node)
+    ERROR(db::NO_NODE);
+
+  db::Stack frames {};
+  db::Stack indices{};
+
+  db::createStack(&frames , sizeof(AddFrame));
+  db::createStack(&indices, sizeof(size_t  ));
+
+  AddFrame frame = {node, false};
+
+  bool isAdded = db::push(&frames, &frame);
+
+  while (isAdded && db::pop(&frames, &frame))
+    {
+      const db::TreeNode *current = frame.node;
+
+      bool isOperator = current->type == db::type_t::OPERATOR;
+      bool hasLeft    = isOperator && current->left && !db::isUnary(current->value.operat);
+      bool hasRight   = isOperator && current->right;
+
+      if (!frame.isVisited && (hasLeft || hasRight))
+        {
+          AddFrame visited = {current       , true };
+          AddFrame right   = {current->right, false};
+          AddFrame left    = {current->left , false};
+
+          isAdded =
+            db::push(&frames, &visited) &&
+            (!hasRight || db::push(&frames, &right)) &&
+            (!hasLeft  || db::push(&frames, &left ));
+
+          continue;
+        }
+
+      size_t left  = db::NO_NODE;
+      size_t right = db::NO_NODE;
+
+      if (hasRight) db::pop(&indices, &right);
+      if (hasLeft ) db::pop(&indices, &left );
+
+      size_t index = db::addDagNode(dag, current->type, current->value, left, right);
+
+      isAdded = index != db::NO_NODE && db::push(&indices, &index);
+    }
+
+  size_t root = db::NO_NODE;
+
+  if (isAdded)
+    db::pop(&indices, &root);
+
+  db::destroyStack(&frames );
+  db::destroyStack(&indices);
+
+  if (root == db::NO_NODE)
+    ERROR(db::NO_NODE);
+
+  return root;
+}
+
+/// Node of DAG which must be copied to link
+struct ExpandFrame {
+  size_t          node;
+  db::TreeNode   *parent;
+  db::TreeNode  **link;
+};
+
+db::TreeNode *db::expandDag(const db::Dag *dag, size_t node, int *error)
+{
+  if (!dag || node >= dag->size)
+    ERROR(nullptr);
+
+  db::TreeNode *root = nullptr;
+
+  db::Stack stack{};
+
+  db::createStack(&stack, sizeof(ExpandFrame));
+
+  ExpandFrame frame = {node, nullptr, &root};
+
+  bool isExpanded = db::push(&stack, &frame);
+
+  while (isExpanded && db::pop(&stack, &frame))
+    {
+      const db::DagNode *dagNode = &dag->nodes[frame.node];
+
+      db::TreeNode *treeNode = db::createNode(dagNode->value, dagNode->type);
+
+      if (!treeNode)
+        {
+          isExpanded = false;
+
+          break;
+        }
+
+      treeNode->parent = frame.parent;
+      *frame.link      = treeNode;
+
+      ExpandFrame left  = {dagNode->left , treeNode, &treeNode->left };
+      ExpandFrame right = {dagNode->right, treeNode, &treeNode->right};
+
+      isExpanded =
+        (left .node == db::NO_NODE || db::push(&stack, &left )) &&
+        (right.node == db::NO_NODE || db::push(&stack, &right));
+    }
+
+  db::destroyStack(&stack);
+
+  if (!isExpanded)
+    {
+      if (root)
+        db::removeNode(root);
+
+      ERROR(nullptr);
+    }
+
+  return root;
+}
+
+db::dependency_t db::getDependency(const db::Dag *dag, const char *name, int *error)
+{
+  if (!dag || !name)
+    ERROR(0);
+
+  for (size_t i = 0; i < dag->namesCount; ++i)
+    if (!strcmp(dag->names[i], name))
+      return getNameBit(i);
+
+  return 0;
+}
+
+bool db::isDependent(const db::Dag *dag, size_t node, db::dependency_t variables, int *error)
+{
+  if (!dag || node >= dag->size)
+    ERROR(true);
+
+  return dag->nodes[node].depends & variables;
+}
+
+bool db::isUnary(db::operator_t operat)
+{
+  for (int i = 0; i < db::BINARY_OPERATORS_COUNT; ++i)
+    if (operat == db::BINARY_OPERATORS[i])
+      return false;
+
+  return true;
+}
+
+static inline uint64_t mix(uint64_t hash, uint64_t value)
+{
+  hash ^= value + 0x9E3779B97F4A7C15 + (hash << 6) + (hash >> 2);
+
+  return hash;
+}
+
+static uint64_t hashNode(db::type_t type, db::treeValue_t value, size_t left, size_t right)
+{
+  uint64_t bits = 0;
+
+  switch (type)
+    {
+    case db::type_t::NUMBER:
+      memcpy(&bits, &value.number, sizeof(bits));
+      break;
+    case db::type_t::VARIABLE:
+      bits = (uintptr_t)value.variable;
+      break;
+    case db::type_t::OPERATOR:
+      bits = (uint64_t)value.operat;
+      break;
+    default:
+      break;
+    }
+
+  uint64_t hash = mix((uint64_t)type, bits);
+
+  hash = mix(hash, left);
+  hash = mix(hash, right);
+
+  return hash;
+}
+
+/// Numbers are compared by bits, so 0 and -0 are different nodes and NAN is equal to itself
+static bool isEqualNode(const db::DagNode *node, db::type_t type, db::treeValue_t value, size_t left, size_t right)
+{
+  assert(node);
+
+  if (node->type != type || node->left != left || node->right != right)
+    return false;
+
+  switch (type)
+    {
+    case db::type_t::NUMBER:
+      return !memcmp(&node->value.number, &value.number, sizeof(value.number));
+    case db::type_t::VARIABLE:
+      return node->value.variable == value.variable;
+    case db::type_t::OPERATOR:
+      return node->value.operat == value.operat;
+    default:
+      return false;
+    }
+}
+
+/// @param [out] index Index of name, it is bit of name in dependencies
+static char *internName(db::Dag *dag, const char *name, size_t *index)
+{
+  assert(dag);
+  assert(index);
+
+  if (!name)
+    return nullptr;
+
+  for (size_t i = 0; i < dag->namesCount; ++i)
+    if (dag->names[i] == name || !strcmp(dag->names[i], name))
+      {
+        *index = i;
+
+        return dag->names[i];
+      }
+
+  if (dag->namesCount == dag->namesCapacity)
+    {
+      char **temp =
+        (char **)recalloc(
+                          dag->names,
+                          (dag->namesCapacity + 1)*DEFAULT_GROWTH_FACTOR,
+                          sizeof(char *)
+                         );
+      if (!temp)
+        return nullptr;
+
+      dag->names = temp;
+
+      ++dag->namesCapacity;
+      dag->namesCapacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  char *copy = strdup(name);
+
+  if (!copy)
+    return nullptr;
+
+  *index = dag->namesCount;
+
+  return dag->names[dag->namesCount++] = copy;
+}
+
+static db::dependency_t getNameBit(size_t index)
+{
+  if (index >= db::DEPENDENCY_BITS - 1)
+    index = db::DEPENDENCY_BITS - 1;
+
+  return (db::dependency_t)1 << index;
+}
+
+static bool growNodes(db::Dag *dag)
+{
+  assert(dag);
+
+  db::DagNode *temp =
+    (db::DagNode *)recalloc(
+                            dag->nodes,
+                            (dag->capacity + 1)*DEFAULT_GROWTH_FACTOR,
+                            sizeof(db::DagNode)
+                           );
+  if (!temp)
+    return false;
+
+  dag->nodes = temp;
+
+  ++dag->capacity;
+  dag->capacity *= DEFAULT_GROWTH_FACTOR;
+
+  return true;
+}
+
+static bool rehash(db::Dag *dag, size_t bucketsCount)
+{
+  assert(dag);
+  assert(bucketsCount);
+
+  size_t *buckets = (size_t *)calloc(bucketsCount, sizeof(size_t));
+
+  if (!buckets)
+    return false;
+
+  for (size_t i = 0; i < bucketsCount; ++i)
+    buckets[i] = db::NO_NODE;
+
+  for (size_t i = 0; i < dag->size; ++i)
+    {
+      db::DagNode *node = &dag->nodes[i];
+
+      size_t bucket = hashNode(node->type, node->value, node->left, node->right) % bucketsCount;
+
+      node->next = buckets[bucket];
+      buckets[bucket] = i;
+    }
+
+  free(dag->buckets);
+
+  dag->buckets      = buckets;
+  dag->bucketsCount = bucketsCount;
+
+  return true;
+}
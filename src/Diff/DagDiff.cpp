@@ -0,0 +1,208 @@
+#include "DagDiff.h"
+#include "DiffRules.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Assert.h"
+#include "Error.h"
+
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+
+/// State of differentiation. Memo keeps derivatives of nodes
+/// which were in DAG before differentiation
+struct DagDiffer {
+  typedef size_t Node;
+
+  static constexpr size_t NONE = db::NO_NODE;
+
+  db::Dag    *dag;
+  const char *variable;
+  size_t     *memo;
+  size_t      memoSize;
+};
+
+static size_t diffNode(DagDiffer *differ, size_t node);
+
+static size_t number  (DagDiffer *differ, double value);
+static size_t makeNode(DagDiffer *differ, db::operator_t operat, size_t left, size_t right);
+
+static bool isNumber(const DagDiffer *differ, size_t node, double value);
+
+static size_t share(DagDiffer *differ, size_t node);
+static void   drop (DagDiffer *differ, size_t node);
+
+void db::diffDag(
+                 db::Dag *dag,
+                 const size_t *roots,
+                 size_t *derivatives,
+                 size_t count,
+                 const char *variable,
+                 int *error
+                )
+{
+  if (!dag || !variable)
+    ERROR();
+
+  if (count && (!roots || !derivatives))
+    ERROR();
+
+  size_t last = 0;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      if (roots[i] >= dag->size)
+        ERROR();
+
+      if (roots[i] > last)
+        last = roots[i];
+    }
+
+  DagDiffer differ = {dag, variable, nullptr, dag->size};
+
+  differ.memo = (size_t *)calloc(differ.memoSize + 1, sizeof(size_t));
+
+  bool *isReached = (bool *)calloc(differ.memoSize + 1, sizeof(bool));
+
+  if (!differ.memo || !isReached)
+    {
+      free(differ.memo);
+      free(isReached);
+
+      ERROR();
+    }
+
+  for (size_t i = 0; i < differ.memoSize; ++i)
+    differ.memo[i] = db::NO_NODE;
+
+  db::dependency_t dependency = db::getDependency(dag, variable);
+
+  // Children go before parents, so one backward sweep finds nodes
+  // which roots use, and one forward sweep differentiates them.
+  // Derivative of node which doesn`t mention variable is zero,
+  // so its children aren`t reached through it
+  for (size_t i = 0; i < count; ++i)
+    isReached[roots[i]] = true;
+
+  for (size_t i = last + 1; count && i-- > 0; )
+    if (isReached[i] && db::isDependent(dag, i, dependency))
+      {
+        if (dag->nodes[i].left  != db::NO_NODE) isReached[dag->nodes[i].left ] = true;
+        if (dag->nodes[i].right != db::NO_NODE) isReached[dag->nodes[i].right] = true;
+      }
+
+  size_t zero = count ? number(&differ, 0) : db::NO_NODE;
+
+  for (size_t i = 0; count && i <= last; ++i)
+    if (isReached[i])
+      differ.memo[i] = db::isDependent(dag, i, dependency) ? diffNode(&differ, i) : zero;
+
+  bool isFailed = false;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      derivatives[i] = differ.memo[roots[i]];
+
+      isFailed = isFailed || derivatives[i] == db::NO_NODE;
+    }
+
+  free(differ.memo);
+  free(isReached);
+
+  if (isFailed)
+    ERROR();
+}
+
+size_t db::diffDag(db::Dag *dag, size_t root, const char *variable, int *error)
+{
+  size_t derivative = db::NO_NODE;
+
+  db::diffDag(dag, &root, &derivative, 1, variable, error);
+
+  return derivative;
+}
+
+/// Derivatives of children of node must be in memo already,
+/// NO_NODE derivative of child fails node too
+static size_t diffNode(DagDiffer *differ, size_t node)
+{
+  assert(differ);
+  assert(node < differ->memoSize);
+
+  // Copy, because nodes of DAG are moved when it grows
+  db::DagNode dagNode = differ->dag->nodes[node];
+
+  switch (dagNode.type)
+    {
+    case db::type_t::NUMBER:
+      return number(differ, 0);
+    case db::type_t::VARIABLE:
+      return number(differ, strcmp(dagNode.value.variable, differ->variable) ? 0 : 1);
+    case db::type_t::OPERATOR:
+      {
+        size_t leftDiff  = dagNode.left  == db::NO_NODE ? db::NO_NODE : differ->memo[dagNode.left ];
+        size_t rightDiff = dagNode.right == db::NO_NODE ? db::NO_NODE : differ->memo[dagNode.right];
+
+        if (
+            (dagNode.left  != db::NO_NODE && leftDiff  == db::NO_NODE) ||
+            (dagNode.right != db::NO_NODE && rightDiff == db::NO_NODE)
+           )
+          return db::NO_NODE;
+
+        return db::diffOperator(
+                                differ,
+                                dagNode.value.operat,
+                                node,
+                                dagNode.left,
+                                dagNode.right,
+                                leftDiff,
+                                rightDiff
+                               );
+      }
+    default:
+      return db::NO_NODE;
+    }
+}
+
+static size_t number(DagDiffer *differ, double value)
+{
+  assert(differ);
+
+  db::treeValue_t nodeValue{};
+  nodeValue.number = value;
+
+  return db::addDagNode(differ->dag, db::type_t::NUMBER, nodeValue, db::NO_NODE, db::NO_NODE);
+}
+
+static size_t makeNode(DagDiffer *differ, db::operator_t operat, size_t left, size_t right)
+{
+  assert(differ);
+
+  db::treeValue_t value{};
+  value.operat = operat;
+
+  return db::addDagNode(differ->dag, db::type_t::OPERATOR, value, left, right);
+}
+
+static bool isNumber(const DagDiffer *differ, size_t node, double value)
+{
+  assert(differ);
+
+  return
+    node != db::NO_NODE &&
+    differ->dag->nodes[node].type == db::type_t::NUMBER &&
+    differ->dag->nodes[node].value.number == value;
+}
+
+/// Nodes of DAG are referenced as many times as need
+static size_t share(DagDiffer *differ, size_t node)
+{
+  assert(differ);
+
+  return node;
+}
+
+static void drop(DagDiffer *differ, size_t)
+{
+  assert(differ);
+}
@@ -1,5 +1,6 @@
 #include "Diff.h"
 #include "DiffUtils.h"
+#include "DiffCache.h"
 
 
 #include "Coordinate.h"
@@ -8,6 +9,7 @@
 #include "Tree.h"
 #include "Settings.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "Logging.h"
@@ -44,6 +46,12 @@ static int  convertAnswer(const char *answer, int answerSize);
 
 static FILE *changeFile(Settings *settings);
 
+/// Cost model of setting or nullptr if derivatives aren`t optimized
+static const db::CostModel *getCostModel(Optimize optimize);
+
+/// Default limits, time limits them only if it is set
+static db::SaturationLimits getSaturationLimits(double maxTime);
+
 bool init()
 {
   db::getBundle(&Bundle, "messages");
@@ -69,13 +77,25 @@ void start()
   getSettings(&settings);
 
   db::Tree tree{};
-  db::Tree diffTree{};
   db::Tree tangetTree{};
 
   db::createTree(&tree);
-  db::createTree(&diffTree);
   db::createTree(&tangetTree);
 
+  db::DiffCache cache{};
+
+  db::SaturationLimits limits = getSaturationLimits(settings.optimizeTime);
+
+  db::createDiffCache(
+                      &cache,
+                      &tree,
+                      db::DEFAULT_MAIN_NAME,
+                      settings.cacheMemory,
+                      settings.diffThreads,
+                      getCostModel(settings.optimize),
+                      &limits
+                     );
+
   FILE *source = fopen(settings.source, "r");
 
   FILE *target = fopen(".temp/temp_tex.tex", "w");
@@ -105,6 +125,7 @@ void start()
               }
 
             db::updateVarTable(settings.table, tree.root);
+            db::resetDiffCache(&cache, &tree);
             break;
           }
         case CHANGE:
@@ -130,43 +151,67 @@ void start()
           {
             if (!tree.root) continue;
             wasDiff = true;
-            if (diffTree.root)
-              db::removeNode(diffTree.root);
-            diffTree = diffExpresion(&tree, target);
-            db::saveTree(&diffTree, stdout);
-            executeExpresion(&diffTree);
+            const db::Tree *diffTree = db::getDerivative(&cache, 1);
+            if (!diffTree) continue;
+            db::saveTree(diffTree, stdout);
+            executeExpresion(diffTree);
             break;
           }
         case SHOW:
           {
             if (!tree.root) continue;
             if (!wasRead) continue;
+
+            // Derivative and its steps are got before document is written,
+            // so failed derivative doesn`t leave half-written document
+            char  *steps     = nullptr;
+            size_t stepsSize = 0;
+
+            FILE *stepsFile = open_memstream(&steps, &stepsSize);
+
+            if (!stepsFile) continue;
+
+            int errorCode = 0;
+
+            db::Tree diffTree = diffExpresion(&tree, stepsFile, &errorCode);
+
+            fclose(stepsFile);
+
+            if (errorCode)
+              {
+                free(steps);
+
+                if (diffTree.root)
+                  db::destroyTree(&diffTree);
+
+                continue;
+              }
+
+            Save saveType = settings.saveType;
+
             settings.saveType = Save::TEX;
             setSettings(&settings);
 
             rewind(target);
             fprintf(target, "\\documentclass{book}\n\\usepackage{graphicx}\n\\begin{document}\n");
             db::saveTree(&tree, target);
+            fwrite(steps, sizeof(char), stepsSize, target);
 
-            if (diffTree.root)
-              {
-              db::removeNode(diffTree.root);
-              diffTree.root = nullptr;
-              }
-            diffTree = diffExpresion(&tree, target);
+            free(steps);
+
+            settings.saveType = saveType;
+            setSettings(&settings);
 
             if (tangetTree.root)
               {
                 db::removeNode(tangetTree.root);
                 tangetTree.root = nullptr;
               }
-            tangetTree = calculateTanget(settings.table, &tree);
 
-            db::Tree seriesTree{};
+            // Series takes coefficients of the greatest order first, so tangent reuses them
+            db::Tree seriesTree = calculateSeries(settings.table, &cache, 100);
 
-            db::createTree(&seriesTree);
-
-            seriesTree = calculateSeries(settings.table, &tree, 100);
+            tangetTree = calculateTanget(settings.table, &cache);
 
             db::Expression *trees = (db::Expression *)calloc(4, sizeof(db::Expression));
             trees[0] = db::Expression {&tree, "original"};
@@ -176,9 +221,6 @@ void start()
 
             db::Plot plot{trees, 4, {-10, 10}, {-10, 10}, 5000};
 
-            settings.saveType = Save::TEXT;
-            setSettings(&settings);
-
             char *graphics = buildGraphics(&plot);
 
             fprintf(target, "\\includegraphics[width=15cm]{%s}", graphics);
@@ -186,7 +228,10 @@ void start()
             free(graphics);
             free(trees);
 
-            db::destroyTree(&seriesTree);
+            if (seriesTree.root)
+              db::destroyTree(&seriesTree);
+
+            db::destroyTree(&diffTree);
 
             fprintf(target, " \\end{document}");
             fflush(target);
@@ -211,15 +256,69 @@ void start()
 
   fclose(target);
 
-  //dumpTree(&diffTree, 0, fopen(".log/temp.html", "w"));
+  db::destroyDiffCache(&cache);
 
   db::destroyTree(&tree);
-  db::destroyTree(&diffTree);
   db::destroyTree(&tangetTree);
 
   system("rm -f .temp/output temp_tex.pdf temp_tex.log");
 }
 
+bool diffBatch()
+{
+  Settings settings{};
+  getSettings(&settings);
+
+  db::Tree *trees = nullptr;
+  size_t    count = 0;
+
+  int errorCode = 0;
+
+  db::loadTrees(&trees, &count, settings.source, &errorCode);
+
+  if (errorCode)
+    return false;
+
+  db::Tree *derivatives = (db::Tree *)calloc(count + 1, sizeof(db::Tree));
+
+  if (derivatives)
+    diffExpressions(trees, count, db::DEFAULT_MAIN_NAME, derivatives, &errorCode);
+
+  const db::CostModel *cost = getCostModel(settings.optimize);
+
+  db::SaturationLimits limits = getSaturationLimits(settings.optimizeTime);
+
+  for (size_t i = 0; derivatives && cost && i < count && !errorCode; ++i)
+    optimizeTree(&derivatives[i], cost, &limits, nullptr, nullptr, &errorCode);
+
+  FILE *target = derivatives && !errorCode ? fopen(settings.target, "w") : nullptr;
+
+  bool isSaved = target;
+
+  if (target)
+    {
+      for (size_t i = 0; i < count; ++i)
+        db::saveTree(&derivatives[i], target);
+
+      fclose(target);
+    }
+  else
+    handleError("Expressions of [%s] aren`t differentiated to [%s]", settings.source, settings.target);
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      db::destroyTree(&trees[i]);
+
+      if (derivatives)
+        db::destroyTree(&derivatives[i]);
+    }
+
+  free(trees);
+  free(derivatives);
+
+  return isSaved;
+}
+
 static int menu(Settings *settings, bool needSave, bool wasRead)
 {
   printf("%s\n", db::getString(&Bundle, "separator"));
@@ -348,3 +447,23 @@ static FILE *changeFile(Settings *settings)
 
   return file;
 }
+
+static const db::CostModel *getCostModel(Optimize optimize)
+{
+  switch (optimize)
+    {
+    case Optimize::NODES : return &db::NODES_COST;
+    case Optimize::CYCLES: return &db::CYCLES_COST;
+    case Optimize::NONE  :
+    default: return nullptr;
+    }
+}
+
+static db::SaturationLimits getSaturationLimits(double maxTime)
+{
+  db::SaturationLimits limits = db::DEFAULT_SATURATION_LIMITS;
+
+  limits.maxTime = maxTime;
+
+  return limits;
+}
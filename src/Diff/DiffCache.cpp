@@ -0,0 +1,308 @@
+#include "DiffCache.h"
+#include "DiffUtils.h"
+#include "Taylor.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "Stack.h"
+#include "SystemLike.h"
+#include "Assert.h"
+#include "Error.h"
+
+const int DEFAULT_GROWTH_FACTOR = 2;
+
+const size_t NO_DERIVATIVE = (size_t)-1;
+
+static void clearDerivatives(db::DiffCache *cache);
+
+static size_t findNearest(const db::DiffCache *cache, size_t order);
+
+static size_t addDerivative(db::DiffCache *cache, size_t order, db::Tree *tree);
+
+static void evictDerivative(db::DiffCache *cache);
+
+static size_t countNodes(const db::TreeNode *node);
+
+static bool isSameValues(const db::DiffCache *cache, const db::VarTable *table);
+
+void db::createDiffCache(
+                         db::DiffCache *cache,
+                         const db::Tree *tree,
+                         const char *variable,
+                         size_t maxMemory,
+                         unsigned threads,
+                         const db::CostModel *cost,
+                         const db::SaturationLimits *limits,
+                         int *error
+                        )
+{
+  if (!cache || !tree || !variable || !limits)
+    ERROR();
+
+  cache->tree              = tree;
+  cache->variable          = strdup(variable);
+  cache->derivatives       = nullptr;
+  cache->capacity          = 0;
+  cache->count             = 0;
+  cache->memory            = 0;
+  cache->maxMemory         = maxMemory;
+  cache->threads           = threads;
+  cache->cost              = cost;
+  cache->limits            = *limits;
+  cache->time              = 0;
+  cache->coefficients      = nullptr;
+  cache->coefficientsCount = 0;
+  cache->values            = nullptr;
+  cache->valuesCount       = 0;
+
+  if (!cache->variable)
+    ERROR();
+}
+
+void db::destroyDiffCache(db::DiffCache *cache, int *error)
+{
+  if (!cache)
+    ERROR();
+
+  clearDerivatives(cache);
+
+  free(cache->derivatives);
+  free(cache->variable);
+  free(cache->coefficients);
+  free(cache->values);
+
+  cache->derivatives  = nullptr;
+  cache->variable     = nullptr;
+  cache->coefficients = nullptr;
+  cache->values       = nullptr;
+  cache->capacity     = 0;
+}
+
+void db::resetDiffCache(db::DiffCache *cache, const db::Tree *tree, int *error)
+{
+  if (!cache || !tree)
+    ERROR();
+
+  clearDerivatives(cache);
+
+  cache->tree              = tree;
+  cache->coefficientsCount = 0;
+  cache->valuesCount       = 0;
+}
+
+const db::Tree *db::getDerivative(db::DiffCache *cache, size_t order, int *error)
+{
+  if (!cache || !cache->tree)
+    ERROR(nullptr);
+
+  if (!order)
+    return cache->tree;
+
+  size_t index = findNearest(cache, order);
+
+  const db::Tree *current = cache->tree;
+  size_t          reached = 0;
+
+  if (index != NO_DERIVATIVE)
+    {
+      cache->derivatives[index].lastUse = ++cache->time;
+
+      current = &cache->derivatives[index].tree;
+      reached = cache->derivatives[index].order;
+    }
+
+  while (reached < order)
+    {
+      int errorCode = 0;
+
+      db::Tree next = diffPartial(current, cache->variable, cache->threads, nullptr, &errorCode);
+
+      if (!errorCode && cache->cost)
+        optimizeTree(&next, cache->cost, &cache->limits, nullptr, nullptr, &errorCode);
+
+      if (errorCode)
+        {
+          db::destroyTree(&next);
+
+          ERROR(nullptr);
+        }
+
+      // Derivative which current points to may be evicted here
+      index = addDerivative(cache, ++reached, &next);
+
+      if (index == NO_DERIVATIVE)
+        {
+          db::destroyTree(&next);
+
+          ERROR(nullptr);
+        }
+
+      current = &cache->derivatives[index].tree;
+    }
+
+  return current;
+}
+
+const double *db::getSeriesCoefficients(db::DiffCache *cache, const db::VarTable *table, size_t order, int *error)
+{
+  if (!cache || !cache->tree || !db::isVarTableValid(table))
+    ERROR(nullptr);
+
+  bool isSame = isSameValues(cache, table);
+
+  if (isSame && cache->coefficientsCount > order)
+    return cache->coefficients;
+
+  double *coefficients = (double *)calloc(order + 1, sizeof(double));
+  double *values       = (double *)calloc(table->size + 1, sizeof(double));
+
+  int errorCode = 0;
+
+  if (coefficients && values)
+    db::calculateTaylor(table, cache->tree, cache->variable, order, coefficients, &errorCode);
+
+  if (!coefficients || !values || errorCode)
+    {
+      free(coefficients);
+      free(values);
+
+      ERROR(nullptr);
+    }
+
+  for (size_t i = 0; i < table->size; ++i)
+    values[i] = table->table[i].value;
+
+  free(cache->coefficients);
+  free(cache->values);
+
+  cache->coefficients      = coefficients;
+  cache->coefficientsCount = order + 1;
+  cache->values            = values;
+  cache->valuesCount       = table->size;
+
+  return cache->coefficients;
+}
+
+static void clearDerivatives(db::DiffCache *cache)
+{
+  assert(cache);
+
+  for (size_t i = 0; i < cache->count; ++i)
+    db::destroyTree(&cache->derivatives[i].tree);
+
+  cache->count  = 0;
+  cache->memory = 0;
+}
+
+/// Cached derivative of the greatest order which isn`t greater than order
+static size_t findNearest(const db::DiffCache *cache, size_t order)
+{
+  assert(cache);
+
+  size_t nearest = NO_DERIVATIVE;
+
+  for (size_t i = 0; i < cache->count; ++i)
+    if (
+        cache->derivatives[i].order <= order &&
+        (nearest == NO_DERIVATIVE || cache->derivatives[i].order > cache->derivatives[nearest].order)
+       )
+      nearest = i;
+
+  return nearest;
+}
+
+/// Tree is moved to cache, least recently used derivatives are evicted
+/// before it, but the new one is kept even if it alone is over limit
+/// @return Index of derivative or NO_DERIVATIVE
+static size_t addDerivative(db::DiffCache *cache, size_t order, db::Tree *tree)
+{
+  assert(cache);
+  assert(tree);
+
+  size_t memory = countNodes(tree->root) * sizeof(db::TreeNode);
+
+  while (cache->count && cache->memory + memory > cache->maxMemory)
+    evictDerivative(cache);
+
+  if (cache->count == cache->capacity)
+    {
+      db::CachedDerivative *temp =
+        (db::CachedDerivative *)recalloc(
+                                         cache->derivatives,
+                                         (cache->capacity + 1)*DEFAULT_GROWTH_FACTOR,
+                                         sizeof(db::CachedDerivative)
+                                        );
+      if (!temp)
+        return NO_DERIVATIVE;
+
+      cache->derivatives = temp;
+
+      ++cache->capacity;
+      cache->capacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  size_t index = cache->count++;
+
+  cache->derivatives[index] = {order, *tree, memory, ++cache->time};
+  cache->memory += memory;
+
+  return index;
+}
+
+static void evictDerivative(db::DiffCache *cache)
+{
+  assert(cache);
+  assert(cache->count);
+
+  size_t oldest = 0;
+
+  for (size_t i = 1; i < cache->count; ++i)
+    if (cache->derivatives[i].lastUse < cache->derivatives[oldest].lastUse)
+      oldest = i;
+
+  cache->memory -= cache->derivatives[oldest].memory;
+
+  db::destroyTree(&cache->derivatives[oldest].tree);
+
+  cache->derivatives[oldest] = cache->derivatives[--cache->count];
+}
+
+static size_t countNodes(const db::TreeNode *node)
+{
+  db::Stack stack{};
+
+  db::createStack(&stack, sizeof(const db::TreeNode *));
+
+  size_t count = 0;
+
+  bool isPushed = !node || db::push(&stack, &node);
+
+  while (isPushed && db::pop(&stack, &node))
+    {
+      ++count;
+
+      isPushed =
+        (!node->left  || db::push(&stack, &node->left )) &&
+        (!node->right || db::push(&stack, &node->right));
+    }
+
+  db::destroyStack(&stack);
+
+  return count;
+}
+
+/// Values are compared by bits, so NAN is equal to itself
+static bool isSameValues(const db::DiffCache *cache, const db::VarTable *table)
+{
+  assert(cache);
+  assert(table);
+
+  if (!cache->coefficientsCount || cache->valuesCount != table->size)
+    return false;
+
+  for (size_t i = 0; i < table->size; ++i)
+    if (memcmp(&cache->values[i], &table->table[i].value, sizeof(double)))
+      return false;
+
+  return true;
+}
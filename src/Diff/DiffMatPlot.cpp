@@ -11,6 +11,7 @@
 #include <array>
 
 #include "DiffUtils.h"
+#include "Sampler.h"
 #include "GenerateName.h"
 #include "Assert.h"
 #include "Error.h"
@@ -30,44 +31,50 @@ char *buildGraphics(const db::Plot *plot, int *error)
 
   db::VarTable *table = settings.table;
 
-  double *mainValue = db::searchMainVariable(table);
+  namespace plt = matplot;
+
+  std::array<double, 2> xRange{plot->xRange.min, plot->xRange.max};
+  std::array<double, 2> yRange{plot->yRange.min, plot->yRange.max};
+
+  plt::xlim(xRange);
+  plt::ylim(yRange);
+
+  db::Curve *curves = (db::Curve *)calloc(plot->expressionsCount, sizeof(db::Curve));
 
-  if (!mainValue)
+  if (!curves && plot->expressionsCount)
     {
-      handleError("No main variable!!");
+      free(name);
 
       ERROR(nullptr);
     }
 
-  double originMainValue = *mainValue;
+  int errorCode = 0;
 
-  namespace plt = matplot;
+  db::sampleCurves(plot, table, curves, 0, settings.backend, &errorCode);
 
-  std::array<double, 2> xRange{plot->xRange.min, plot->xRange.max};
-  std::array<double, 2> yRange{plot->yRange.min, plot->yRange.max};
+  if (errorCode)
+    {
+      free(curves);
+      free(name);
 
-  plt::ylim(xRange);
-  plt::ylim(yRange);
+      ERROR(nullptr);
+    }
 
-  std::vector<double> x(plot->density);
+  plt::hold(plt::on);
 
-  double range = plot->xRange.max - plot->xRange.min;
-  for (size_t i = 0; i < plot->density; ++i)
-    x.at(i) = plot->xRange.min + range * (double)i/plot->density;
+  for (size_t i = 0; i < plot->expressionsCount; ++i)
+    {
+      std::vector<double> x(curves[i].x, curves[i].x + curves[i].size);
+      std::vector<double> y(curves[i].y, curves[i].y + curves[i].size);
 
-  std::vector<std::vector<double>>
-    y(plot->expressionsCount, std::vector<double>(plot->density));
+      plt::plot(x, y);
 
-  for (size_t i = 0; i < plot->expressionsCount; ++i)
-    y[i] = plt::transform(x,
-                          [main=mainValue, &table, &plot, i](auto val)
-                          {
-                            *main = (double)val;
+      db::destroyCurve(&curves[i]);
+    }
 
-                            return calculateNode(table, plot->expressions[i].expression->root);
-                          });
+  plt::hold(plt::off);
 
-  plt::plot(y);
+  free(curves);
 
   std::vector<std::string> legends{};
 
@@ -78,7 +85,5 @@ char *buildGraphics(const db::Plot *plot, int *error)
 
   plt::save(name);
 
-  *mainValue = originMainValue;
-
   return name;
 }
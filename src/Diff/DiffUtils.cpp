@@ -1,7 +1,15 @@
 #include "Diff.h"
 #include "DiffUtils.h"
 #include "DiffDSL.h"
+#include "Dual.h"
+#include "Taylor.h"
+#include "DagDiff.h"
+#include "ParallelDiff.h"
+#include "Rewrite.h"
+#include "EGraph.h"
+#include "Polynomial.h"
 #include "TreeTexIO.h"
+#include "Stack.h"
 
 #include "Settings.h"
 #include "Assert.h"
@@ -9,9 +17,11 @@
 #include "ResourceBundle.h"
 #include "Error.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <chrono>
 
 #pragma GCC diagnostic ignored "-Wtautological-compare"
 #pragma GCC diagnostic ignored "-Wcast-qual"
@@ -23,27 +33,104 @@ static inline bool isEqual(double first, double second)
   return fabs(first - second) < ACCURACY;
 }
 
-static inline double factorial(int n)
-{
-  double result = 1;
+/// Identities of simplite, the first matching rule is applied. Constants
+/// are folded and signs of numbers are moved to operators by simpliteNode().
+/// a / a and a ^ 0 aren`t rules and powers are merged for positive numbers
+/// only, else result is defined where x / x or ln(x) isn`t. Rules which drop
+/// operand (0 * a, 0 / a, 1 ^ a, a - a) still widen domain to points where
+/// it is undefined, like 0 * ln(x) for x < 0
+const char *const SIMPLITE_RULES[] =
+  {
+    "0 + a -> a",
+    "a + 0 -> a",
+    "a - 0 -> a",
+    "0 * a -> 0",
+    "a * 0 -> 0",
+    "1 * a -> a",
+    "a * 1 -> a",
+    "0 / a -> 0",
+    "a / 1 -> a",
+    "1 ^ a -> 1",
+    "a ^ 1 -> a",
+    "a - a -> 0",
+    "A ^ b * A ^ c -> A ^ (b + c)",
+    "A ^ b * A -> A ^ (b + 1)",
+    "A * A ^ b -> A ^ (b + 1)",
+    "A ^ b / A ^ c -> A ^ (b - c)",
+    "A ^ b / A -> A ^ (b - 1)",
+    "A / A ^ b -> A ^ (1 - b)",
+  };
+
+const size_t SIMPLITE_RULES_COUNT = sizeof(SIMPLITE_RULES) / sizeof(SIMPLITE_RULES[0]);
+
+static db::RuleSet SIMPLITE_RULE_SET{};
+
+/// Equalities of optimizeTree(), both sides stay in e-graph, so rules may
+/// grow expressions and go in both directions. Constants are folded by
+/// e-graph, (0 - 1) is number -1. Powers are merged like SIMPLITE_RULES do
+const char *const OPTIMIZE_RULES[] =
+  {
+    "a + b -> b + a",
+    "a * b -> b * a",
+    "a + (b + c) -> (a + b) + c",
+    "(a + b) + c -> a + (b + c)",
+    "a * (b * c) -> (a * b) * c",
+    "(a * b) * c -> a * (b * c)",
+    "a - b -> a + (0 - 1) * b",
+    "a + (0 - 1) * b -> a - b",
+    "a * b + a * c -> a * (b + c)",
+    "a * b + b -> (a + 1) * b",
+    "a + a -> 2 * a",
+    "a * a -> a ^ 2",
+    "A ^ b * A -> A ^ (b + 1)",
+    "A ^ b * A ^ c -> A ^ (b + c)",
+    "a * b / c -> a * (b / c)",
+    "a / b * c -> a * c / b",
+    "0 + a -> a",
+    "0 * a -> 0",
+    "1 * a -> a",
+    "a - a -> 0",
+    "a / 1 -> a",
+    "a ^ 1 -> a",
+  };
+
+const size_t OPTIMIZE_RULES_COUNT = sizeof(OPTIMIZE_RULES) / sizeof(OPTIMIZE_RULES[0]);
+
+static db::RuleSet OPTIMIZE_RULE_SET{};
 
-  for (int i = 2; i <= n; ++i)
-    result *= i;
+static db::TreeNode *createNumber(db::number_t value);
 
-  return result;
-}
+static db::TreeNode *createVariable(db::variable_t value);
 
-static double getVariableValue(const db::VarTable *table,  db::variable_t variable);
+/// One traversal of tree, incremental one examines new children of changed nodes too
+static db::TreeNode *simplite(db::TreeNode *node, bool isIncremental, SimpliteStats *stats);
 
-static db::TreeNode *createNumber(db::number_t value);
+static db::TreeNode *simpliteNode(db::TreeNode *node, bool *wasChange);
 
-static db::TreeNode *createVariable(db::variable_t value);
+static const db::RuleSet *getSimpliteRules();
+
+static bool compileSimpliteRules();
+
+static void destroySimpliteRules();
+
+static const db::RuleSet *getOptimizeRules();
 
-static bool isConst(const db::TreeNode *node);
+static bool compileOptimizeRules();
 
-static db::TreeNode *simplite(db::TreeNode *node, bool *wasChange, FILE *file);
+static void destroyOptimizeRules();
 
-static db::TreeNode *diff(db::TreeNode *node);
+static db::Tree buildTangent(double value, double derivative, double point);
+
+/// Sum of coefficients[k] * (x - point)^k
+static db::Tree buildSeries(const double *coefficients, int power, double point);
+
+static bool diffShared(
+                       const db::TreeNode *const *nodes,
+                       size_t nodesCount,
+                       const char *const *variables,
+                       size_t variablesCount,
+                       db::TreeNode **derivatives
+                      );
 
 static db::TreeNode *createNumber(db::number_t value)
 {
@@ -59,57 +146,309 @@ static db::TreeNode *createVariable(db::variable_t value)
   return node;
 }
 
-static bool isConst(const db::TreeNode *node)
+db::Tree diffExpresion(const db::Tree *tree, FILE *file, int *error)
 {
-  assert(node);
-
-  if (IS_VAR(node) && !strcmp(VARIABLE(node), db::DEFAULT_MAIN_NAME))
-    return false;
+  Settings settings{};
+  getSettings(&settings);
 
-  if (Left  && !isConst(Left )) return false;
-  if (Right && !isConst(Right)) return false;
+  return diffPartial(tree, db::DEFAULT_MAIN_NAME, settings.diffThreads, file, error);
+}
 
-  return true;
+db::Tree diffPartial(const db::Tree *tree, const char *variable, FILE *file, int *error)
+{
+  return diffPartial(tree, variable, 1, file, error);
 }
 
-db::Tree diffExpresion(const db::Tree *tree, FILE *file, int *error)
+db::Tree diffPartial(const db::Tree *tree, const char *variable, unsigned threads, FILE *file, int *error)
 {
   assert(tree);
 
   db::Tree diffTree{};
 
+  if (!variable)
+    ERROR(diffTree);
+
   db::createTree(&diffTree);
 
-  if (tree->root)
+  if (tree->root && threads == 1)
+    {
+      if (!diffShared(&tree->root, 1, &variable, 1, &diffTree.root))
+        ERROR(diffTree);
+    }
+  else if (tree->root)
     {
-      diffTree.root = diff(tree->root);
+      int errorCode = 0;
 
-      if (!diffTree.root)
+      diffTree.root = db::diffParallel(tree->root, variable, threads, db::DEFAULT_PARALLEL_THRESHOLD, &errorCode);
+
+      if (errorCode)
         ERROR(diffTree);
     }
 
-  bool wasChange = false;
+  if (file)
+    {
+      fprintf(file, "After diff:\n");
+      db::saveTexTree(&diffTree, file);
+    }
 
-  do
+  int errorCode = 0;
+
+  simpliteTree(&diffTree, file, nullptr, &errorCode);
+
+  if (!errorCode)
+    collectTermsTree(&diffTree, file, &errorCode);
+
+  if (errorCode)
+    ERROR(diffTree);
+
+  return diffTree;
+}
+
+void diffGradient(
+                  const db::Tree *tree,
+                  const char *const *variables,
+                  size_t count,
+                  db::Tree *gradient,
+                  int *error
+                 )
+{
+  if (!tree || !tree->root)
+    ERROR();
+
+  if (count && (!variables || !gradient))
+    ERROR();
+
+  for (size_t i = 0; i < count; ++i)
+    if (!variables[i])
+      ERROR();
+
+  db::TreeNode **derivatives = (db::TreeNode **)calloc(count + 1, sizeof(db::TreeNode *));
+
+  if (!derivatives)
+    ERROR();
+
+  bool isBuilt = diffShared(&tree->root, 1, variables, count, derivatives);
+
+  int errorCode = 0;
+
+  // Trees are given even after error, so caller destroys all of them
+  for (size_t i = 0; i < count; ++i)
     {
-      if (file)
+      db::createTree(&gradient[i]);
+
+      gradient[i].root = derivatives[i];
+
+      if (isBuilt && !errorCode)
         {
-          fprintf(file, "After diff:\n");
-          db::saveTexTree(tree, file);
+          simpliteTree(&gradient[i], nullptr, nullptr, &errorCode);
+
+          if (!errorCode)
+            collectTermsTree(&gradient[i], nullptr, &errorCode);
         }
+    }
+
+  free(derivatives);
+
+  if (!isBuilt || errorCode)
+    ERROR();
+}
+
+void diffExpressions(
+                     const db::Tree *trees,
+                     size_t count,
+                     const char *variable,
+                     db::Tree *derivatives,
+                     int *error
+                    )
+{
+  if (!variable || (count && (!trees || !derivatives)))
+    ERROR();
+
+  const db::TreeNode **nodes = (const db::TreeNode **)calloc(count + 1, sizeof(db::TreeNode *));
+  db::TreeNode **results     = (db::TreeNode **)      calloc(count + 1, sizeof(db::TreeNode *));
+
+  size_t nodesCount = 0;
 
-      wasChange = false;
+  // Empty trees have empty derivatives
+  for (size_t i = 0; nodes && i < count; ++i)
+    if (trees[i].root)
+      nodes[nodesCount++] = trees[i].root;
 
-      diffTree.root = simplite(diffTree.root, &wasChange, file);
+  bool isBuilt = nodes && results && diffShared(nodes, nodesCount, &variable, 1, results);
 
-      if (file)
+  int errorCode = 0;
+
+  for (size_t i = 0, j = 0; i < count; ++i)
+    {
+      db::createTree(&derivatives[i]);
+
+      if (isBuilt && trees[i].root)
         {
-          fprintf(file, "After simplite:\n");
-          db::saveTexTree(tree, file);
+          derivatives[i].root = results[j++];
+
+          if (!errorCode)
+            simpliteTree(&derivatives[i], nullptr, nullptr, &errorCode);
+
+          if (!errorCode)
+            collectTermsTree(&derivatives[i], nullptr, &errorCode);
         }
-    } while (wasChange);
+    }
 
-  return diffTree;
+  free(nodes);
+  free(results);
+
+  if (!isBuilt || errorCode)
+    ERROR();
+}
+
+void simpliteTree(db::Tree *tree, FILE *file, SimpliteStats *stats, int *error)
+{
+  if (!tree)
+    ERROR();
+
+  SimpliteStats work{};
+
+  auto start = std::chrono::steady_clock::now();
+
+  if (tree->root)
+    tree->root = simplite(tree->root, true, &work);
+
+  work.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (file)
+    {
+      fprintf(file, "After simplite:\n");
+      db::saveTexTree(tree, file);
+
+      fprintf(
+              file,
+              "Simplified by %zu passes, %zu visits and %zu changes in %lg s\n",
+              work.passes,
+              work.visits,
+              work.changes,
+              work.time
+             );
+    }
+
+  if (stats)
+    *stats = work;
+}
+
+void simpliteTreeByPasses(db::Tree *tree, SimpliteStats *stats, int *error)
+{
+  if (!tree)
+    ERROR();
+
+  SimpliteStats work{};
+
+  auto start = std::chrono::steady_clock::now();
+
+  size_t changes = 0;
+
+  do
+    {
+      changes = work.changes;
+
+      if (tree->root)
+        tree->root = simplite(tree->root, false, &work);
+    } while (tree->root && work.changes != changes);
+
+  work.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (stats)
+    *stats = work;
+}
+
+void collectTermsTree(db::Tree *tree, FILE *file, int *error)
+{
+  if (!tree)
+    ERROR();
+
+  if (!tree->root)
+    return;
+
+  db::TreeNode *collected = db::collectTerms(tree->root);
+
+  if (!collected)
+    ERROR();
+
+  db::removeNode(tree->root);
+
+  tree->root = collected;
+
+  if (file)
+    {
+      fprintf(file, "After collecting terms:\n");
+      db::saveTexTree(tree, file);
+    }
+}
+
+void optimizeTree(
+                  db::Tree *tree,
+                  const db::CostModel *cost,
+                  const db::SaturationLimits *limits,
+                  FILE *file,
+                  db::SaturationStats *stats,
+                  int *error
+                 )
+{
+  if (!tree || !cost || !limits)
+    ERROR();
+
+  const db::RuleSet *rules = getOptimizeRules();
+
+  if (!rules)
+    ERROR();
+
+  if (!tree->root)
+    return;
+
+  db::EGraph graph{};
+
+  db::SaturationStats work{};
+
+  int errorCode = 0;
+
+  db::createEGraph(&graph, &errorCode);
+
+  size_t root = errorCode ? db::NO_CLASS : db::addETree(&graph, tree->root, &errorCode);
+
+  db::TreeNode *optimized = nullptr;
+
+  if (!errorCode)
+    db::saturateEGraph(&graph, rules, limits, &work, &errorCode);
+
+  if (!errorCode)
+    optimized = db::extractETree(&graph, root, cost, &errorCode);
+
+  db::destroyEGraph(&graph);
+
+  if (!optimized)
+    ERROR();
+
+  db::removeNode(tree->root);
+
+  tree->root = optimized;
+
+  if (file)
+    {
+      fprintf(file, "After optimize:\n");
+      db::saveTexTree(tree, file);
+
+      fprintf(
+              file,
+              "Optimized by %zu iterations and %zu matches to %zu nodes of %zu classes in %lg s%s\n",
+              work.iterations,
+              work.matches,
+              work.nodes,
+              work.classes,
+              work.time,
+              work.isSaturated ? ", saturated" : ""
+             );
+    }
+
+  if (stats)
+    *stats = work;
 }
 
 db::Tree calculateTanget(const db::VarTable *table, const db::Tree *originTree, int *error)
@@ -119,31 +458,34 @@ db::Tree calculateTanget(const db::VarTable *table, const db::Tree *originTree,
   if (!originTree || !originTree->root)
     ERROR({});
 
-  db::TreeNode *var = VAR((char *)"x");
-
   double *value = db::searchMainVariable(table);
 
-  db::Tree diffTree{};
+  if (!value)
+    ERROR({});
 
-  diffTree = diffExpresion(originTree, nullptr);
+  db::Dual tangent = db::calculateDual(table, originTree->root, db::DEFAULT_MAIN_NAME);
 
-  db::Tree tree{};
+  return buildTangent(tangent.value, tangent.derivative, *value);
+}
 
-  tree.root = ADD(
-                  MUL(
-                      NUM(calculateNode(table,   diffTree.root)),
-                      SUB(var, NUM(*value))
-                     ),
-                  NUM(    calculateNode(
-                                        table,
-                                        originTree->root
-                                       )
-                     )
-                 );
+db::Tree calculateTanget(const db::VarTable *table, db::DiffCache *cache, int *error)
+{
+  if (!isVarTableValid(table))
+    ERROR({});
+  if (!cache || !cache->tree || !cache->tree->root)
+    ERROR({});
 
-  db::destroyTree(&diffTree);
+  double *value = db::searchMainVariable(table);
 
-  return tree;
+  if (!value)
+    ERROR({});
+
+  const double *coefficients = db::getSeriesCoefficients(cache, table, 1, error);
+
+  if (!coefficients)
+    return {};
+
+  return buildTangent(coefficients[0], coefficients[1], *value);
 }
 
 db::Tree calculateSeries(const db::VarTable *table, const db::Tree *originTree, int power, int *error)
@@ -152,43 +494,93 @@ db::Tree calculateSeries(const db::VarTable *table, const db::Tree *originTree,
     ERROR({});
   if (!originTree || !originTree->root)
     ERROR({});
-
-  db::TreeNode *var = VAR((char *)"x");
+  if (power < 0)
+    ERROR({});
 
   double *value = db::searchMainVariable(table);
 
-  db::Tree diffTree{};
+  if (!value)
+    ERROR({});
 
-  db::Tree series{};
+  double *coefficients = (double *)calloc((size_t)power + 1, sizeof(double));
 
-  diffTree = diffExpresion(originTree, nullptr);
+  if (!coefficients)
+    ERROR({});
 
-  series.root = NUM(calculateNode(table, diffTree.root));
+  int errorCode = 0;
 
-  for (int k = 1; k <= power; ++k)
+  db::calculateTaylor(table, originTree, db::DEFAULT_MAIN_NAME, (size_t)power, coefficients, &errorCode);
+
+  if (errorCode)
     {
-      series.root = ADD(
-                        series.root,
-                        DIV(
-                            MUL(
-                                NUM(calculateNode(table, diffTree.root)),
-                                POW(
-                                    SUB(db::createNode(var), NUM(*value)),
-                                    NUM(k)
-                                   )
-                               ),
-                            NUM(factorial(k))
-                           )
-                       );
-
-      db::TreeNode *temp = diffTree.root;
-      diffTree = diffExpresion(&diffTree, nullptr);
-      db::removeNode(temp);
+      free(coefficients);
+
+      ERROR({});
     }
 
-  db::destroyTree(&diffTree);
+  db::Tree series = buildSeries(coefficients, power, *value);
+
+  free(coefficients);
+
+  return series;
+}
+
+db::Tree calculateSeries(const db::VarTable *table, db::DiffCache *cache, int power, int *error)
+{
+  if (!isVarTableValid(table))
+    ERROR({});
+  if (!cache || !cache->tree || !cache->tree->root)
+    ERROR({});
+  if (power < 0)
+    ERROR({});
+
+  double *value = db::searchMainVariable(table);
+
+  if (!value)
+    ERROR({});
+
+  const double *coefficients = db::getSeriesCoefficients(cache, table, (size_t)power, error);
+
+  if (!coefficients)
+    return {};
 
-  db::removeNode(var);
+  return buildSeries(coefficients, power, *value);
+}
+
+static db::Tree buildTangent(double value, double derivative, double point)
+{
+  db::Tree tree{};
+
+  tree.root = ADD(
+                  MUL(
+                      NUM(derivative),
+                      SUB(VAR((char *)db::DEFAULT_MAIN_NAME), NUM(point))
+                     ),
+                  NUM(value)
+                 );
+
+  return tree;
+}
+
+static db::Tree buildSeries(const double *coefficients, int power, double point)
+{
+  assert(coefficients);
+
+  db::Tree series{};
+
+  series.root = NUM(coefficients[0]);
+
+  for (int k = 1; k <= power; ++k)
+    series.root = ADD(
+                      series.root,
+                      MUL(
+                          NUM(coefficients[k]),
+                          POW(
+                              SUB(VAR((char *)db::DEFAULT_MAIN_NAME), NUM(point)),
+                              NUM(k)
+                             )
+                         )
+                     );
 
   return series;
 }
@@ -209,39 +601,79 @@ void executeExpresion(const db::Tree *tree, int *error)
   printf("%lg\n", result);
 }
 
-static double getVariableValue(const db::VarTable *table, db::variable_t variable)
+/// Node which is calculated after its children
+struct CalculateFrame {
+  const db::TreeNode *node;
+  bool                isVisited;
+};
+
+double calculateNode(const db::VarTable *table, const db::TreeNode *node)
 {
   assert(table);
-  assert(variable);
 
-  for (size_t i = 0; i < table->size; ++i)
-    if (!strcmp(table->table[i].name, variable))
-      return table->table[i].value;
+  if (!node) return NAN;
 
-  return NAN;
-}
+  db::Stack frames{};
+  db::Stack values{};
 
-double calculateNode(const db::VarTable *table, const db::TreeNode *node)
-{
-  assert(table);
-  //assert(node);
+  db::createStack(&frames, sizeof(CalculateFrame));
+  db::createStack(&values, sizeof(double        ));
 
-  if (IS_NUM(node)) return NUMBER(node);
-  if (IS_VAR(node))
+  CalculateFrame frame = {node, false};
+
+  bool isPushed = db::push(&frames, &frame);
+
+  while (isPushed && db::pop(&frames, &frame))
     {
-      if (!isnan(*db::searchMainVariable(table)) && !strcmp(
-                                               VARIABLE(node),
-                                               db::DEFAULT_MAIN_NAME
-                                              ))
-        return *db::searchMainVariable(table);
+      const db::TreeNode *current = frame.node;
+
+      double value = NAN;
+
+      if (IS_NUM(current))
+        value = NUMBER(current);
+      else if (IS_VAR(current))
+        value = db::getVariableValue(table, VARIABLE(current));
+      else if (!frame.isVisited)
+        {
+          CalculateFrame visited = {current       , true };
+          CalculateFrame left    = {current->left , false};
+          CalculateFrame right   = {current->right, false};
 
-      return getVariableValue(table, VARIABLE(node));
+          isPushed =
+            db::push(&frames, &visited) &&
+            (!right.node || db::push(&frames, &right)) &&
+            (!left .node || db::push(&frames, &left ));
+
+          continue;
+        }
+      else
+        {
+          double leftValue  = NAN;
+          double rightValue = NAN;
+
+          if (current->right) db::pop(&values, &rightValue);
+          if (current->left ) db::pop(&values, &leftValue );
+
+          value = calculateOperator(OPERATOR(current), leftValue, rightValue);
+        }
+
+      isPushed = db::push(&values, &value);
     }
 
-  double leftValue  = (Left  ? calculateNode(table, Left ) : NAN);
-  double rightValue = (Right ? calculateNode(table, Right) : NAN);
+  double result = NAN;
+
+  if (isPushed)
+    db::pop(&values, &result);
+
+  db::destroyStack(&frames);
+  db::destroyStack(&values);
+
+  return result;
+}
 
-  switch (OPERATOR(node))
+double calculateOperator(db::operator_t operat, double leftValue, double rightValue)
+{
+  switch (operat)
     {
     case db::OPERATOR_ADD : return leftValue + rightValue;
     case db::OPERATOR_SUB : return leftValue - rightValue;
@@ -258,86 +690,174 @@ double calculateNode(const db::VarTable *table, const db::TreeNode *node)
     }
 }
 
-static db::TreeNode *diff(db::TreeNode *node)
+/// Derivatives are built on one DAG, where every distinct subexpression of all
+/// nodes is differentiated once by every variable, and expanded to trees after that
+/// @param [out] derivatives Array for nodesCount * variablesCount trees,
+/// derivative of node i by variable j is derivatives[i * variablesCount + j]
+static bool diffShared(
+                       const db::TreeNode *const *nodes,
+                       size_t nodesCount,
+                       const char *const *variables,
+                       size_t variablesCount,
+                       db::TreeNode **derivatives
+                      )
+{
+  assert(nodes       || !nodesCount);
+  assert(variables   || !variablesCount);
+  assert(derivatives || !nodesCount || !variablesCount);
+
+  size_t count = nodesCount * variablesCount;
+
+  for (size_t i = 0; i < count; ++i)
+    derivatives[i] = nullptr;
+
+  size_t *roots   = (size_t *)calloc(nodesCount + 1, sizeof(size_t));
+  size_t *indices = (size_t *)calloc(nodesCount + 1, sizeof(size_t));
+
+  db::Dag dag{};
+
+  int errorCode = 0;
+
+  if (roots && indices)
+    db::createDag(&dag, &errorCode);
+
+  if (!roots || !indices || errorCode)
+    {
+      free(roots);
+      free(indices);
+
+      return false;
+    }
+
+  for (size_t i = 0; i < nodesCount && !errorCode; ++i)
+    roots[i] = db::addDagTree(&dag, nodes[i], &errorCode);
+
+  for (size_t j = 0; j < variablesCount && !errorCode; ++j)
+    {
+      db::diffDag(&dag, roots, indices, nodesCount, variables[j], &errorCode);
+
+      for (size_t i = 0; i < nodesCount && !errorCode; ++i)
+        derivatives[i * variablesCount + j] = db::expandDag(&dag, indices[i], &errorCode);
+    }
+
+  db::destroyDag(&dag);
+
+  free(roots);
+  free(indices);
+
+  if (errorCode)
+    for (size_t i = 0; i < count; ++i)
+      if (derivatives[i])
+        {
+          db::removeNode(derivatives[i]);
+
+          derivatives[i] = nullptr;
+        }
+
+  return !errorCode;
+}
+
+/// Link to node which is simplified after its children
+struct SimpliteFrame {
+  db::TreeNode **link;
+  bool           isVisited;
+};
+
+static db::TreeNode *simplite(db::TreeNode *node, bool isIncremental, SimpliteStats *stats)
 {
   assert(node);
+  assert(stats);
+
+  db::TreeNode *root = node;
 
-  switch (node->type)
+  const db::RuleSet *rules = getSimpliteRules();
+
+  db::Stack stack{};
+  db::Stack fresh{};
+
+  db::createStack(&stack, sizeof(SimpliteFrame));
+  db::createStack(&fresh, sizeof(db::TreeNode **));
+
+  SimpliteFrame frame = {&root, false};
+
+  bool isPushed = db::push(&stack, &frame);
+
+  ++stats->passes;
+
+  while (isPushed && db::pop(&stack, &frame))
     {
-    case db::type_t::NUMBER:   return NUM(0);
-    case db::type_t::VARIABLE:
-      {
-        if (!strcmp(VARIABLE(node), db::DEFAULT_MAIN_NAME))
-          return NUM(1);
-        else
-          return NUM(0);
-      }
-    case db::type_t::OPERATOR:
-      switch (OP_VAL(node))
+      db::TreeNode *current = *frame.link;
+
+      if (frame.isVisited || !IS_OPERATOR(current))
         {
-        case db::OPERATOR_ADD:
-          return ADD(dLeft, dRight);
-        case db::OPERATOR_SUB:
-          return SUB(dLeft, dRight);
-        case db::OPERATOR_MUL:
-          return ADD(MUL(dLeft, CopyRight), MUL(CopyLeft, dRight));
-        case db::OPERATOR_DIV:
-          return DIV(
-                     SUB(MUL(dLeft, CopyRight), MUL(CopyLeft, dRight)),
-                     MUL(CopyRight, CopyRight)
-                    );
-        case db::OPERATOR_SIN:
-          return MUL(COS(CopyRight), dRight);
-        case db::OPERATOR_COS:
-          return MUL(NUM(-1), MUL(SIN(CopyRight), dRight));
-        case db::OPERATOR_POW:
-          {
-            bool isLeftConst  = isConst(Left);
-            bool isRightConst = isConst(Right);
+          db::TreeNode *left  = current->left;
+          db::TreeNode *right = current->right;
 
-            if (isLeftConst && isRightConst)
-              return NUM(0);
-
-            if (isLeftConst && !isRightConst)
-              return MUL(
-                         MUL(POW(CopyLeft, CopyRight), LN(CopyLeft)),
-                         dRight
-                        );
-
-            if (!isLeftConst && isRightConst)
-              return MUL(
-                         MUL(
-                             CopyRight,
-                             POW(CopyLeft, SUB(CopyRight, NUM(1)))
-                            ),
-                         dLeft
-                        );
-
-            if (!isLeftConst && !isRightConst)
-              return MUL(
-                         POW(CopyLeft, CopyRight),
-                         ADD(
-                             MUL(dLeft, CopyRight),
-                             MUL(CopyLeft, dRight)
-                            )
-                        );
+          bool wasChange = false;
 
-            return nullptr;
-          }
-        case db::OPERATOR_SQRT:
-          return DIV(dRight, MUL(NUM(2), SQRT(CopyRight)));
-        case db::OPERATOR_LOG:
-          return DIV(MUL(dRight, LN(CopyLeft)), CopyRight);
-        case db::OPERATOR_LN:
-          return DIV(dRight, CopyRight);
-        case db::OPERATORS_COUNT:
-        default: return nullptr;
+          *frame.link = simpliteNode(current, &wasChange);
+
+          bool wasRewritten =
+            !wasChange && rules && *frame.link && IS_OPERATOR((*frame.link)) &&
+            db::rewriteNode(rules, frame.link, isIncremental ? &fresh : nullptr);
+
+          ++stats->visits;
+
+          if (wasChange || wasRewritten)
+            ++stats->changes;
+
+          // New operators of result are examined children first, subtrees
+          // which rule moved or copied are simplified already
+          db::TreeNode **freshLink = nullptr;
+
+          while (db::pop(&fresh, &freshLink))
+            {
+              SimpliteFrame again = {freshLink, true};
+
+              isPushed = isPushed && db::push(&stack, &again);
+            }
+
+          if (wasRewritten)
+            continue;
+
+          // Other children are simplified, and parent is examined after node anyway
+          if (
+              !isIncremental || *frame.link != current || !IS_OPERATOR(current) ||
+              (current->left == left && current->right == right)
+             )
+            continue;
+
+          SimpliteFrame again    = {frame.link     , true };
+          SimpliteFrame newLeft  = {&current->left , false};
+          SimpliteFrame newRight = {&current->right, false};
+
+          isPushed =
+            db::push(&stack, &again) &&
+            (!current->right || current->right == right || db::push(&stack, &newRight)) &&
+            (!current->left  || current->left  == left  || db::push(&stack, &newLeft ));
+
+          continue;
         }
-    default: return nullptr;
+
+      SimpliteFrame visited = {frame.link     , true };
+      SimpliteFrame left    = {&current->left , false};
+      SimpliteFrame right   = {&current->right, false};
+
+      isPushed =
+        db::push(&stack, &visited) &&
+        (!current->right || db::push(&stack, &right)) &&
+        (!current->left  || db::push(&stack, &left ));
     }
+
+  db::destroyStack(&stack);
+  db::destroyStack(&fresh);
+
+  return root;
 }
 
-static db::TreeNode *simplite(db::TreeNode *node, bool *wasChange, FILE *file)
+/// Fold node whose children are simplified already, so const children
+/// are numbers. Other identities are rules of SIMPLITE_RULES
+static db::TreeNode *simpliteNode(db::TreeNode *node, bool *wasChange)
 {
   assert(node);
   assert(wasChange);
@@ -348,11 +868,8 @@ static db::TreeNode *simplite(db::TreeNode *node, bool *wasChange, FILE *file)
 
   if (IS_OPERATOR(node))
     {
-      if (Left ) Left  = simplite(Left , wasChange, file);
-      if (Right) Right = simplite(Right, wasChange, file);
-
-      bool isLeftConst  = (Left  ? isConst(Left ) : true);
-      bool isRightConst = (Right ? isConst(Right) : true);
+      bool isLeftConst  = (Left  ? IS_NUM(Left ) : true);
+      bool isRightConst = (Right ? IS_NUM(Right) : true);
 
       switch (OPERATOR(node))
         {
@@ -360,13 +877,13 @@ static db::TreeNode *simplite(db::TreeNode *node, bool *wasChange, FILE *file)
           {
             if (isLeftConst && isRightConst)
               CALC_CONST(NUMBER(Left) + NUMBER(Right));
-            else if (IS_EQUAL(Left, 0)|| IS_EQUAL(Right, 0))
-              UPPER_NODE(IS_EQUAL(Left, 0) ? Right  : Left);
             else if (IS_NUM(Right) && NUMBER(Right) < 0)
               {
                 OPERATOR(node) = db::OPERATOR_SUB;
 
                 Right = MUL(NUM(-1), Right);
+
+                *wasChange = true;
               }
 
             break;
@@ -375,13 +892,13 @@ static db::TreeNode *simplite(db::TreeNode *node, bool *wasChange, FILE *file)
           {
             if (isLeftConst && isRightConst)
               CALC_CONST(NUMBER(Left) - NUMBER(Right));
-            else if (IS_EQUAL(Right, 0))
-              UPPER_NODE(Left);
             else if (IS_NUM(Right) && NUMBER(Right) < 0)
               {
                 OPERATOR(node) = db::OPERATOR_ADD;
 
                 Right = MUL(NUM(-1), Right);
+
+                *wasChange = true;
               }
 
             break;
@@ -390,10 +907,6 @@ static db::TreeNode *simplite(db::TreeNode *node, bool *wasChange, FILE *file)
           {
             if (isLeftConst && isRightConst)
               CALC_CONST(NUMBER(Left) * NUMBER(Right));
-            else if (IS_EQUAL(Left, 0) || IS_EQUAL(Right, 0))
-              TO_NUMBER(0);
-            else if (IS_EQUAL(Left, 1) || IS_EQUAL(Right, 1))
-              UPPER_NODE(IS_EQUAL(Left, 1) ? Right : Left);
 
             break;
           }
@@ -401,10 +914,6 @@ static db::TreeNode *simplite(db::TreeNode *node, bool *wasChange, FILE *file)
           {
               if (isLeftConst && isRightConst)
                 CALC_CONST(NUMBER(Left) / NUMBER(Right));
-              else if (IS_EQUAL(Left, 0))
-                TO_NUMBER(0);
-              else if (IS_EQUAL(Right, 1))
-                UPPER_NODE(Left);
 
             break;
           }
@@ -434,11 +943,6 @@ static db::TreeNode *simplite(db::TreeNode *node, bool *wasChange, FILE *file)
             if (isLeftConst && isRightConst)
               CALC_CONST(pow(NUMBER(Left), NUMBER(Right)));
 
-            else if (IS_EQUAL(Left, 1) || IS_EQUAL(Right, 0))
-              TO_NUMBER(1);
-            else if (IS_EQUAL(Right, 1))
-              UPPER_NODE(Left);
-
             break;
           }
         case db::OPERATOR_LOG:
@@ -463,3 +967,57 @@ static db::TreeNode *simplite(db::TreeNode *node, bool *wasChange, FILE *file)
 
   return node;
 }
+
+/// Rules are compiled once, when simplite is used first
+static const db::RuleSet *getSimpliteRules()
+{
+  static const bool isCompiled = compileSimpliteRules();
+
+  return isCompiled ? &SIMPLITE_RULE_SET : nullptr;
+}
+
+static bool compileSimpliteRules()
+{
+  int errorCode = 0;
+
+  db::createRuleSet(&SIMPLITE_RULE_SET, &errorCode);
+
+  for (size_t i = 0; i < SIMPLITE_RULES_COUNT && !errorCode; ++i)
+    db::addRule(&SIMPLITE_RULE_SET, SIMPLITE_RULES[i], &errorCode);
+
+  atexit(destroySimpliteRules);
+
+  return !errorCode;
+}
+
+static void destroySimpliteRules()
+{
+  db::destroyRuleSet(&SIMPLITE_RULE_SET);
+}
+
+/// Rules are compiled once, when optimizeTree() is used first
+static const db::RuleSet *getOptimizeRules()
+{
+  static const bool isCompiled = compileOptimizeRules();
+
+  return isCompiled ? &OPTIMIZE_RULE_SET : nullptr;
+}
+
+static bool compileOptimizeRules()
+{
+  int errorCode = 0;
+
+  db::createRuleSet(&OPTIMIZE_RULE_SET, &errorCode);
+
+  for (size_t i = 0; i < OPTIMIZE_RULES_COUNT && !errorCode; ++i)
+    db::addRule(&OPTIMIZE_RULE_SET, OPTIMIZE_RULES[i], &errorCode);
+
+  atexit(destroyOptimizeRules);
+
+  return !errorCode;
+}
+
+static void destroyOptimizeRules()
+{
+  db::destroyRuleSet(&OPTIMIZE_RULE_SET);
+}
@@ -0,0 +1,248 @@
+#include "Dual.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Stack.h"
+#include "Assert.h"
+#include "Error.h"
+
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+
+const size_t MAX_LOCAL_DEPTH = 64;
+
+const db::Dual NAN_DUAL = {NAN, NAN};
+
+/// Node which is calculated after its children
+struct DualFrame {
+  const db::TreeNode *node;
+  bool                isVisited;
+};
+
+static inline db::Dual constant(double value)
+{
+  return {value, 0};
+}
+
+static db::Dual mul (db::Dual left, db::Dual right);
+static db::Dual div (db::Dual left, db::Dual right);
+static db::Dual pow (db::Dual left, db::Dual right);
+static db::Dual log (db::Dual left, db::Dual right);
+static db::Dual sqrt(db::Dual value);
+static db::Dual sin (db::Dual value);
+static db::Dual cos (db::Dual value);
+static db::Dual ln  (db::Dual value);
+
+db::Dual db::calculateDual(db::operator_t operat, db::Dual left, db::Dual right)
+{
+  switch (operat)
+    {
+    case db::OPERATOR_ADD : return {left.value + right.value, left.derivative + right.derivative};
+    case db::OPERATOR_SUB : return {left.value - right.value, left.derivative - right.derivative};
+    case db::OPERATOR_MUL : return mul(left, right);
+    case db::OPERATOR_DIV : return div(left, right);
+    case db::OPERATOR_POW : return pow(left, right);
+    case db::OPERATOR_LOG : return log(left, right);
+    case db::OPERATOR_SQRT: return sqrt(right);
+    case db::OPERATOR_SIN : return sin (right);
+    case db::OPERATOR_COS : return cos (right);
+    case db::OPERATOR_LN  : return ln  (right);
+    case db::OPERATORS_COUNT:
+    default: return NAN_DUAL;
+    }
+}
+
+db::Dual db::calculateDual(const db::VarTable *table, const db::TreeNode *node, const char *variable)
+{
+  assert(table);
+  assert(node);
+  assert(variable);
+
+  db::Stack frames{};
+  db::Stack values{};
+
+  db::createStack(&frames, sizeof(DualFrame));
+  db::createStack(&values, sizeof(db::Dual));
+
+  DualFrame frame = {node, false};
+
+  bool isPushed = db::push(&frames, &frame);
+
+  while (isPushed && db::pop(&frames, &frame))
+    {
+      const db::TreeNode *current = frame.node;
+
+      db::Dual value = NAN_DUAL;
+
+      switch (current->type)
+        {
+        case db::type_t::NUMBER:
+          value = constant(current->value.number);
+          break;
+        case db::type_t::VARIABLE:
+          value = {
+            db::getVariableValue(table, current->value.variable),
+            strcmp(current->value.variable, variable) ? 0. : 1.
+          };
+          break;
+        case db::type_t::OPERATOR:
+          {
+            if (!frame.isVisited)
+              {
+                DualFrame visited = {current       , true };
+                DualFrame left    = {current->left , false};
+                DualFrame right   = {current->right, false};
+
+                isPushed =
+                  db::push(&frames, &visited) &&
+                  (!right.node || db::push(&frames, &right)) &&
+                  (!left .node || db::push(&frames, &left ));
+
+                continue;
+              }
+
+            db::Dual left  = NAN_DUAL;
+            db::Dual right = NAN_DUAL;
+
+            if (current->right) db::pop(&values, &right);
+            if (current->left ) db::pop(&values, &left );
+
+            value = db::calculateDual(current->value.operat, left, right);
+            break;
+          }
+        default:
+          break;
+        }
+
+      isPushed = db::push(&values, &value);
+    }
+
+  db::Dual result = NAN_DUAL;
+
+  if (isPushed)
+    db::pop(&values, &result);
+
+  db::destroyStack(&frames);
+  db::destroyStack(&values);
+
+  return result;
+}
+
+db::Dual db::executeDual(const db::Program *program, const double *slots, size_t slot, int *error)
+{
+  if (!program || !program->code)
+    ERROR(NAN_DUAL);
+
+  if (!slots && program->slots)
+    ERROR(NAN_DUAL);
+
+  db::Dual  localMemory[MAX_LOCAL_DEPTH] = {};
+  db::Dual *memory = localMemory;
+
+  if (program->depth + program->registers > MAX_LOCAL_DEPTH)
+    {
+      memory = (db::Dual *)calloc(program->depth + program->registers, sizeof(db::Dual));
+
+      if (!memory)
+        ERROR(NAN_DUAL);
+    }
+
+  db::Dual *top       = memory;
+  db::Dual *registers = memory + program->depth;
+
+  const db::Instruction *end = program->code + program->size;
+
+  for (const db::Instruction *ip = program->code; ip < end; ++ip)
+    switch (ip->opcode)
+      {
+      case db::OPCODE_NUMBER: *top++ = constant(ip->argument.number); break;
+      case db::OPCODE_SLOT:
+        *top++ = {slots[ip->argument.slot], ip->argument.slot == slot ? 1. : 0.};
+        break;
+      case db::OPCODE_ADD:
+      case db::OPCODE_SUB:
+      case db::OPCODE_MUL:
+      case db::OPCODE_DIV:
+      case db::OPCODE_POW:
+      case db::OPCODE_LOG:
+        --top;
+        top[-1] = db::calculateDual((db::operator_t)(ip->opcode - db::OPCODE_ADD), top[-1], top[0]);
+        break;
+      case db::OPCODE_SQRT:
+      case db::OPCODE_SIN:
+      case db::OPCODE_COS:
+      case db::OPCODE_LN:
+        top[-1] = db::calculateDual((db::operator_t)(ip->opcode - db::OPCODE_ADD), top[-1], top[-1]);
+        break;
+      case db::OPCODE_STORE: registers[ip->argument.index] = top[-1]; break;
+      case db::OPCODE_LOAD : *top++ = registers[ip->argument.index];  break;
+      case db::OPCODES_COUNT:
+      default: assert(0 && "Invalid opcode");
+      }
+
+  db::Dual result = memory[0];
+
+  if (memory != localMemory)
+    free(memory);
+
+  return result;
+}
+
+static db::Dual mul(db::Dual left, db::Dual right)
+{
+  return {
+    left.value * right.value,
+    left.derivative * right.value + left.value * right.derivative
+  };
+}
+
+static db::Dual div(db::Dual left, db::Dual right)
+{
+  double value = left.value / right.value;
+
+  return {value, (left.derivative - value * right.derivative) / right.value};
+}
+
+/// Terms with zero derivative are skipped, so x^2 has derivative for
+/// negative x and 2^x doesn`t need ln of negative base
+static db::Dual pow(db::Dual left, db::Dual right)
+{
+  double value      = ::pow(left.value, right.value);
+  double derivative = 0;
+
+  if (left.derivative != 0)
+    derivative += right.value * ::pow(left.value, right.value - 1) * left.derivative;
+
+  if (right.derivative != 0)
+    derivative += value * ::log(left.value) * right.derivative;
+
+  return {value, derivative};
+}
+
+/// Logarithm of right by base left
+static db::Dual log(db::Dual left, db::Dual right)
+{
+  return div(ln(right), ln(left));
+}
+
+static db::Dual sqrt(db::Dual value)
+{
+  double root = ::sqrt(value.value);
+
+  return {root, value.derivative / (2 * root)};
+}
+
+static db::Dual sin(db::Dual value)
+{
+  return {::sin(value.value), ::cos(value.value) * value.derivative};
+}
+
+static db::Dual cos(db::Dual value)
+{
+  return {::cos(value.value), -::sin(value.value) * value.derivative};
+}
+
+static db::Dual ln(db::Dual value)
+{
+  return {::log(value.value), value.derivative / value.value};
+}
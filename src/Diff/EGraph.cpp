@@ -0,0 +1,1085 @@
+#include "EGraph.h"
+#include "Dag.h"
+#include "DiffUtils.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include "Stack.h"
+#include "SystemLike.h"
+#include "Assert.h"
+#include "Error.h"
+
+const int DEFAULT_GROWTH_FACTOR = 2;
+
+const size_t DEFAULT_BUCKETS_COUNT = 64;
+
+/// Numbers of patterns are compared like simplite compares them
+const double ACCURACY = 1. / 10000.;
+
+/// Subtree of pattern which must match class
+struct PendingPattern {
+  const db::TreeNode *pattern;
+  size_t              eclass;
+};
+
+/// Matching of rules, classes which names of pattern matched are bound
+/// by index of name. Found matches are pushed as bindings, class and rule,
+/// so they are popped in reverse order. Matches after maxFound are dropped
+struct EMatch {
+  const db::EGraph      *graph;
+  const size_t          *starts;   ///< Nodes of class i are members[starts[i]..starts[i + 1]]
+  const size_t          *members;
+  const db::RewriteRule *rule;
+  size_t                 ruleIndex;
+  size_t                 eclass;
+  size_t                 bindings[db::MAX_PATTERN_SIZE];
+  PendingPattern         pending [db::MAX_PATTERN_SIZE + 1];
+  size_t                 pendingCount;
+  db::Stack             *found;
+  size_t                 foundCount;
+  size_t                 maxFound;
+  bool                   isFailed;
+};
+
+/// Class of e-graph which must be copied to link
+struct ExtractFrame {
+  size_t          eclass;
+  db::TreeNode   *parent;
+  db::TreeNode  **link;
+};
+
+static inline bool isEqual(double first, double second)
+{
+  return fabs(first - second) < ACCURACY;
+}
+
+static uint64_t hashNode(db::type_t type, db::treeValue_t value, size_t left, size_t right);
+
+static bool isEqualNode(const db::ENode *node, db::type_t type, db::treeValue_t value, size_t left, size_t right);
+
+static size_t findNode(const db::EGraph *graph, db::type_t type, db::treeValue_t value, size_t left, size_t right);
+
+static char *internName(db::EGraph *graph, const char *name);
+
+static size_t addClass(db::EGraph *graph);
+
+static bool foldNode(db::EGraph *graph, size_t node);
+
+static bool growNodes(db::EGraph *graph);
+
+static bool rehash(db::EGraph *graph, size_t bucketsCount);
+
+static bool indexClasses(const db::EGraph *graph, size_t **starts, size_t **members);
+
+static size_t findVariable(const db::RewriteRule *rule, const char *name);
+
+static bool getConstant(const db::TreeNode *pattern, db::number_t *value);
+
+static void matchPattern(EMatch *match);
+
+static size_t addResult(db::EGraph *graph, const db::RewriteRule *rule, const db::TreeNode *node, const size_t *bindings);
+
+static double getCost(const db::CostModel *cost, const db::ENode *node);
+
+void db::createEGraph(db::EGraph *graph, int *error)
+{
+  if (!graph)
+    ERROR();
+
+  graph->nodes           = nullptr;
+  graph->nodesCapacity   = 0;
+  graph->nodesCount      = 0;
+  graph->classes         = nullptr;
+  graph->classesCapacity = 0;
+  graph->classesCount    = 0;
+  graph->buckets         = nullptr;
+  graph->bucketsCount    = 0;
+  graph->names           = nullptr;
+  graph->namesCapacity   = 0;
+  graph->namesCount      = 0;
+  graph->isClean         = true;
+
+  if (!rehash(graph, DEFAULT_BUCKETS_COUNT))
+    ERROR();
+}
+
+void db::destroyEGraph(db::EGraph *graph, int *error)
+{
+  if (!graph)
+    ERROR();
+
+  for (size_t i = 0; i < graph->namesCount; ++i)
+    free(graph->names[i]);
+
+  free(graph->names);
+  free(graph->nodes);
+  free(graph->classes);
+  free(graph->buckets);
+
+  graph->nodes           = nullptr;
+  graph->nodesCapacity   = 0;
+  graph->nodesCount      = 0;
+  graph->classes         = nullptr;
+  graph->classesCapacity = 0;
+  graph->classesCount    = 0;
+  graph->buckets         = nullptr;
+  graph->bucketsCount    = 0;
+  graph->names           = nullptr;
+  graph->namesCapacity   = 0;
+  graph->namesCount      = 0;
+}
+
+size_t db::addENode(db::EGraph *graph, db::type_t type, db::treeValue_t value, size_t left, size_t right, int *error)
+{
+  if (!graph || !graph->buckets)
+    ERROR(db::NO_CLASS);
+
+  if ((left != db::NO_CLASS && left >= graph->classesCount) || (right != db::NO_CLASS && right >= graph->classesCount))
+    ERROR(db::NO_CLASS);
+
+  if (type == db::type_t::OPERATOR && db::isUnary(value.operat))
+    left = db::NO_CLASS;
+
+  if (type != db::type_t::OPERATOR)
+    left = right = db::NO_CLASS;
+
+  if (left  != db::NO_CLASS) left  = db::findEClass(graph, left );
+  if (right != db::NO_CLASS) right = db::findEClass(graph, right);
+
+  if (type == db::type_t::VARIABLE && !(value.variable = internName(graph, value.variable)))
+    ERROR(db::NO_CLASS);
+
+  size_t found = findNode(graph, type, value, left, right);
+
+  if (found != db::NO_CLASS)
+    return db::findEClass(graph, graph->nodes[found].eclass);
+
+  if (graph->nodesCount >= graph->bucketsCount && !rehash(graph, graph->bucketsCount * DEFAULT_GROWTH_FACTOR))
+    ERROR(db::NO_CLASS);
+
+  if (graph->nodesCount == graph->nodesCapacity && !growNodes(graph))
+    ERROR(db::NO_CLASS);
+
+  size_t eclass = addClass(graph);
+
+  if (eclass == db::NO_CLASS)
+    ERROR(db::NO_CLASS);
+
+  size_t bucket = hashNode(type, value, left, right) % graph->bucketsCount;
+  size_t node   = graph->nodesCount++;
+
+  graph->nodes[node] = {type, value, left, right, eclass, graph->buckets[bucket]};
+
+  graph->buckets[bucket] = node;
+
+  if (type == db::type_t::NUMBER)
+    {
+      graph->classes[eclass].isConst  = true;
+      graph->classes[eclass].constant = value.number;
+    }
+  else if (type == db::type_t::OPERATOR && !foldNode(graph, node))
+    ERROR(db::NO_CLASS);
+
+  return db::findEClass(graph, eclass);
+}
+
+/// Node of tree which is added after its children
+struct AddFrame {
+  const db::TreeNode *node;
+  bool                isVisited;
+};
+
+size_t db::addETree(db::EGraph *graph, const db::TreeNode *node, int *error)
+{
+  if (!graph || !node)
+    ERROR(db::NO_CLASS);
+
+  db::Stack frames {};
+  db::Stack classes{};
+
+  db::createStack(&frames , sizeof(AddFrame));
+  db::createStack(&classes, sizeof(size_t  ));
+
+  AddFrame frame = {node, false};
+
+  bool isAdded = db::push(&frames, &frame);
+
+  while (isAdded && db::pop(&frames, &frame))
+    {
+      const db::TreeNode *current = frame.node;
+
+      bool isOperator = current->type == db::type_t::OPERATOR;
+      bool hasLeft    = isOperator && current->left && !db::isUnary(current->value.operat);
+      bool hasRight   = isOperator && current->right;
+
+      if (!frame.isVisited && (hasLeft || hasRight))
+        {
+          AddFrame visited = {current       , true };
+          AddFrame right   = {current->right, false};
+          AddFrame left    = {current->left , false};
+
+          isAdded =
+            db::push(&frames, &visited) &&
+            (!hasRight || db::push(&frames, &right)) &&
+            (!hasLeft  || db::push(&frames, &left ));
+
+          continue;
+        }
+
+      size_t left  = db::NO_CLASS;
+      size_t right = db::NO_CLASS;
+
+      if (hasRight) db::pop(&classes, &right);
+      if (hasLeft ) db::pop(&classes, &left );
+
+      size_t eclass = db::addENode(graph, current->type, current->value, left, right);
+
+      isAdded = eclass != db::NO_CLASS && db::push(&classes, &eclass);
+    }
+
+  size_t root = db::NO_CLASS;
+
+  if (isAdded)
+    db::pop(&classes, &root);
+
+  db::destroyStack(&frames );
+  db::destroyStack(&classes);
+
+  if (root == db::NO_CLASS)
+    ERROR(db::NO_CLASS);
+
+  return root;
+}
+
+size_t db::findEClass(const db::EGraph *graph, size_t eclass, int *error)
+{
+  if (!graph || eclass >= graph->classesCount)
+    ERROR(db::NO_CLASS);
+
+  while (graph->classes[eclass].parent != eclass)
+    eclass = graph->classes[eclass].parent;
+
+  return eclass;
+}
+
+size_t db::joinEClasses(db::EGraph *graph, size_t first, size_t second, int *error)
+{
+  if (!graph || first >= graph->classesCount || second >= graph->classesCount)
+    ERROR(db::NO_CLASS);
+
+  first  = db::findEClass(graph, first );
+  second = db::findEClass(graph, second);
+
+  if (first == second)
+    return first;
+
+  // Smaller class is joined to larger one, so paths to roots stay short
+  if (graph->classes[first].size < graph->classes[second].size)
+    {
+      size_t temp = first;
+
+      first  = second;
+      second = temp;
+    }
+
+  db::EClass *root  = &graph->classes[first ];
+  db::EClass *child = &graph->classes[second];
+
+  child->parent = first;
+  root->size   += child->size;
+
+  if (!root->isConst && child->isConst)
+    {
+      root->isConst  = true;
+      root->constant = child->constant;
+    }
+
+  graph->isClean = false;
+
+  return first;
+}
+
+void db::rebuildEGraph(db::EGraph *graph, int *error)
+{
+  if (!graph || !graph->buckets)
+    ERROR();
+
+  bool isChanged = !graph->isClean;
+
+  while (isChanged)
+    {
+      isChanged = false;
+
+      for (size_t i = 0; i < graph->bucketsCount; ++i)
+        graph->buckets[i] = db::NO_CLASS;
+
+      // Nodes whose children were joined may repeat other nodes now,
+      // their classes are joined and the repeating node is dropped
+      for (size_t i = 0; i < graph->nodesCount; ++i)
+        {
+          db::ENode *node = &graph->nodes[i];
+
+          if (node->eclass == db::NO_CLASS)
+            continue;
+
+          if (node->left  != db::NO_CLASS) node->left  = db::findEClass(graph, node->left );
+          if (node->right != db::NO_CLASS) node->right = db::findEClass(graph, node->right);
+
+          node->eclass = db::findEClass(graph, node->eclass);
+
+          size_t found = findNode(graph, node->type, node->value, node->left, node->right);
+
+          if (found != db::NO_CLASS)
+            {
+              if (db::findEClass(graph, graph->nodes[found].eclass) != node->eclass)
+                {
+                  db::joinEClasses(graph, graph->nodes[found].eclass, node->eclass);
+
+                  isChanged = true;
+                }
+
+              node->eclass = db::NO_CLASS;
+
+              continue;
+            }
+
+          size_t bucket = hashNode(node->type, node->value, node->left, node->right) % graph->bucketsCount;
+
+          node->next = graph->buckets[bucket];
+          graph->buckets[bucket] = i;
+        }
+
+      // Joined classes may make operands constant
+      for (size_t i = 0, count = graph->nodesCount; i < count; ++i)
+        if (graph->nodes[i].type == db::type_t::OPERATOR && graph->nodes[i].eclass != db::NO_CLASS)
+          {
+            size_t eclass = db::findEClass(graph, graph->nodes[i].eclass);
+
+            if (graph->classes[eclass].isConst)
+              continue;
+
+            if (!foldNode(graph, i))
+              ERROR();
+
+            isChanged = isChanged || graph->classes[db::findEClass(graph, eclass)].isConst;
+          }
+
+      isChanged = isChanged || !graph->isClean;
+
+      graph->isClean = true;
+    }
+
+  graph->isClean = true;
+}
+
+void db::saturateEGraph(
+                        db::EGraph *graph,
+                        const db::RuleSet *rules,
+                        const db::SaturationLimits *limits,
+                        db::SaturationStats *stats,
+                        int *error
+                       )
+{
+  if (!graph || !graph->buckets || !rules || !limits)
+    ERROR();
+
+  db::SaturationStats work{};
+
+  auto start = std::chrono::steady_clock::now();
+
+  db::Stack found{};
+
+  db::createStack(&found, sizeof(size_t));
+
+  size_t *starts  = nullptr;
+  size_t *members = nullptr;
+
+  bool isFailed  = false;
+  bool isTimeout = false;
+
+  while (!work.isSaturated && !isFailed && !isTimeout && work.iterations < limits->maxIterations)
+    {
+      if (graph->nodesCount >= limits->maxNodes)
+        break;
+
+      ++work.iterations;
+
+      int errorCode = 0;
+
+      db::rebuildEGraph(graph, &errorCode);
+
+      free(starts );
+      free(members);
+
+      if (errorCode || !indexClasses(graph, &starts, &members))
+        {
+          isFailed = true;
+
+          break;
+        }
+
+      // All matches are found before any is applied, so rules
+      // see the same e-graph and their order doesn`t matter
+      EMatch match{};
+
+      match.graph    = graph;
+      match.starts   = starts;
+      match.members  = members;
+      match.found    = &found;
+      match.maxFound = limits->maxNodes;
+
+      for (size_t i = 0; i < rules->rulesCount && !match.isFailed && !isTimeout; ++i)
+        {
+          match.rule      = &rules->rules[i];
+          match.ruleIndex = i;
+
+          for (size_t eclass = 0; eclass < graph->classesCount && !match.isFailed && !isTimeout; ++eclass)
+            {
+              if (graph->classes[eclass].parent != eclass)
+                continue;
+
+              for (size_t j = 0; j < match.rule->variablesCount; ++j)
+                match.bindings[j] = db::NO_CLASS;
+
+              match.eclass       = eclass;
+              match.pending[0]   = {match.rule->pattern.root, eclass};
+              match.pendingCount = 1;
+
+              matchPattern(&match);
+
+              isTimeout =
+                limits->maxTime > 0 &&
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > limits->maxTime;
+            }
+        }
+
+      isFailed = match.isFailed;
+
+      size_t nodesCount = graph->nodesCount;
+      bool   isJoined   = false;
+      bool   isSkipped  = match.foundCount >= match.maxFound;
+      size_t ruleIndex  = 0;
+
+      while (!isFailed && db::pop(&found, &ruleIndex))
+        {
+          const db::RewriteRule *rule = &rules->rules[ruleIndex];
+
+          size_t eclass = 0;
+          size_t bindings[db::MAX_PATTERN_SIZE] = {};
+
+          db::pop(&found, &eclass);
+
+          for (size_t i = rule->variablesCount; i-- > 0; )
+            db::pop(&found, &bindings[i]);
+
+          if (graph->nodesCount >= limits->maxNodes)
+            {
+              isSkipped = true;
+
+              continue;
+            }
+
+          size_t result = addResult(graph, rule, rule->result.root, bindings);
+
+          if (result == db::NO_CLASS)
+            {
+              isFailed = true;
+
+              break;
+            }
+
+          if (db::findEClass(graph, result) != db::findEClass(graph, eclass))
+            {
+              db::joinEClasses(graph, result, eclass);
+
+              isJoined = true;
+            }
+
+          ++work.matches;
+        }
+
+      while (db::pop(&found))
+        ;
+
+      work.isSaturated = !isFailed && !isTimeout && !isSkipped && !isJoined && graph->nodesCount == nodesCount;
+    }
+
+  int errorCode = 0;
+
+  db::rebuildEGraph(graph, &errorCode);
+
+  free(starts );
+  free(members);
+
+  db::destroyStack(&found);
+
+  work.nodes = 0;
+
+  for (size_t i = 0; i < graph->nodesCount; ++i)
+    work.nodes += graph->nodes[i].eclass != db::NO_CLASS;
+
+  for (size_t i = 0; i < graph->classesCount; ++i)
+    work.classes += graph->classes[i].parent == i;
+
+  work.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (stats)
+    *stats = work;
+
+  if (isFailed || errorCode)
+    ERROR();
+}
+
+db::TreeNode *db::extractETree(const db::EGraph *graph, size_t eclass, const db::CostModel *cost, int *error)
+{
+  if (!graph || !cost || eclass >= graph->classesCount)
+    ERROR(nullptr);
+
+  double *costs   = (double *)calloc(graph->classesCount, sizeof(double));
+  size_t *choices = (size_t *)calloc(graph->classesCount, sizeof(size_t));
+
+  if (!costs || !choices)
+    {
+      free(costs  );
+      free(choices);
+
+      ERROR(nullptr);
+    }
+
+  for (size_t i = 0; i < graph->classesCount; ++i)
+    {
+      costs  [i] = INFINITY;
+      choices[i] = db::NO_CLASS;
+    }
+
+  // Children are mostly before parents, so few sweeps reach the fixed point.
+  // Costs are positive, so the cheapest node never uses its own class
+  bool isImproved = true;
+
+  while (isImproved)
+    {
+      isImproved = false;
+
+      for (size_t i = 0; i < graph->nodesCount; ++i)
+        {
+          const db::ENode *node = &graph->nodes[i];
+
+          if (node->eclass == db::NO_CLASS)
+            continue;
+
+          double nodeCost = getCost(cost, node);
+
+          if (node->left  != db::NO_CLASS) nodeCost += costs[db::findEClass(graph, node->left )];
+          if (node->right != db::NO_CLASS) nodeCost += costs[db::findEClass(graph, node->right)];
+
+          size_t nodeClass = db::findEClass(graph, node->eclass);
+
+          if (nodeCost < costs[nodeClass])
+            {
+              costs  [nodeClass] = nodeCost;
+              choices[nodeClass] = i;
+
+              isImproved = true;
+            }
+        }
+    }
+
+  free(costs);
+
+  db::TreeNode *root = nullptr;
+
+  db::Stack stack{};
+
+  db::createStack(&stack, sizeof(ExtractFrame));
+
+  ExtractFrame frame = {eclass, nullptr, &root};
+
+  bool isExtracted = db::push(&stack, &frame);
+
+  while (isExtracted && db::pop(&stack, &frame))
+    {
+      size_t choice = choices[db::findEClass(graph, frame.eclass)];
+
+      if (choice == db::NO_CLASS)
+        {
+          isExtracted = false;
+
+          break;
+        }
+
+      const db::ENode *node = &graph->nodes[choice];
+
+      db::TreeNode *treeNode = db::createNode(node->value, node->type);
+
+      if (!treeNode)
+        {
+          isExtracted = false;
+
+          break;
+        }
+
+      treeNode->parent = frame.parent;
+      *frame.link      = treeNode;
+
+      ExtractFrame left  = {node->left , treeNode, &treeNode->left };
+      ExtractFrame right = {node->right, treeNode, &treeNode->right};
+
+      isExtracted =
+        (left .eclass == db::NO_CLASS || db::push(&stack, &left )) &&
+        (right.eclass == db::NO_CLASS || db::push(&stack, &right));
+    }
+
+  db::destroyStack(&stack);
+
+  free(choices);
+
+  if (!isExtracted)
+    {
+      if (root)
+        db::removeNode(root);
+
+      ERROR(nullptr);
+    }
+
+  return root;
+}
+
+static inline uint64_t mix(uint64_t hash, uint64_t value)
+{
+  hash ^= value + 0x9E3779B97F4A7C15 + (hash << 6) + (hash >> 2);
+
+  return hash;
+}
+
+static uint64_t hashNode(db::type_t type, db::treeValue_t value, size_t left, size_t right)
+{
+  uint64_t bits = 0;
+
+  switch (type)
+    {
+    case db::type_t::NUMBER:
+      memcpy(&bits, &value.number, sizeof(bits));
+      break;
+    case db::type_t::VARIABLE:
+      bits = (uintptr_t)value.variable;
+      break;
+    case db::type_t::OPERATOR:
+      bits = (uint64_t)value.operat;
+      break;
+    default:
+      break;
+    }
+
+  uint64_t hash = mix((uint64_t)type, bits);
+
+  hash = mix(hash, left);
+  hash = mix(hash, right);
+
+  return hash;
+}
+
+/// Numbers are compared by bits like in Dag
+static bool isEqualNode(const db::ENode *node, db::type_t type, db::treeValue_t value, size_t left, size_t right)
+{
+  assert(node);
+
+  if (node->type != type || node->left != left || node->right != right)
+    return false;
+
+  switch (type)
+    {
+    case db::type_t::NUMBER:
+      return !memcmp(&node->value.number, &value.number, sizeof(value.number));
+    case db::type_t::VARIABLE:
+      return node->value.variable == value.variable;
+    case db::type_t::OPERATOR:
+      return node->value.operat == value.operat;
+    default:
+      return false;
+    }
+}
+
+/// Node of hash table, children must be roots of classes
+/// @return Index of node or NO_CLASS
+static size_t findNode(const db::EGraph *graph, db::type_t type, db::treeValue_t value, size_t left, size_t right)
+{
+  assert(graph);
+
+  uint64_t hash = hashNode(type, value, left, right);
+
+  for (size_t index = graph->buckets[hash % graph->bucketsCount]; index != db::NO_CLASS; index = graph->nodes[index].next)
+    if (isEqualNode(&graph->nodes[index], type, value, left, right))
+      return index;
+
+  return db::NO_CLASS;
+}
+
+static char *internName(db::EGraph *graph, const char *name)
+{
+  assert(graph);
+
+  if (!name)
+    return nullptr;
+
+  for (size_t i = 0; i < graph->namesCount; ++i)
+    if (graph->names[i] == name || !strcmp(graph->names[i], name))
+      return graph->names[i];
+
+  if (graph->namesCount == graph->namesCapacity)
+    {
+      char **temp =
+        (char **)recalloc(
+                          graph->names,
+                          (graph->namesCapacity + 1)*DEFAULT_GROWTH_FACTOR,
+                          sizeof(char *)
+                         );
+      if (!temp)
+        return nullptr;
+
+      graph->names = temp;
+
+      ++graph->namesCapacity;
+      graph->namesCapacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  char *copy = strdup(name);
+
+  if (!copy)
+    return nullptr;
+
+  return graph->names[graph->namesCount++] = copy;
+}
+
+/// @return Index of new class or NO_CLASS
+static size_t addClass(db::EGraph *graph)
+{
+  assert(graph);
+
+  if (graph->classesCount == graph->classesCapacity)
+    {
+      db::EClass *temp =
+        (db::EClass *)recalloc(
+                               graph->classes,
+                               (graph->classesCapacity + 1)*DEFAULT_GROWTH_FACTOR,
+                               sizeof(db::EClass)
+                              );
+      if (!temp)
+        return db::NO_CLASS;
+
+      graph->classes = temp;
+
+      ++graph->classesCapacity;
+      graph->classesCapacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  size_t eclass = graph->classesCount++;
+
+  graph->classes[eclass] = {eclass, 1, false, 0};
+
+  return eclass;
+}
+
+/// Operator over constant classes gets number node in its class.
+/// Values which aren`t finite aren`t folded
+/// @return Was folding successful, false only if memory is over
+static bool foldNode(db::EGraph *graph, size_t node)
+{
+  assert(graph);
+  assert(node < graph->nodesCount);
+
+  db::ENode operat = graph->nodes[node];
+
+  const db::EClass *left  = operat.left  == db::NO_CLASS ? nullptr : &graph->classes[db::findEClass(graph, operat.left )];
+  const db::EClass *right = operat.right == db::NO_CLASS ? nullptr : &graph->classes[db::findEClass(graph, operat.right)];
+
+  if (!right || !right->isConst || (left && !left->isConst))
+    return true;
+
+  db::number_t value = calculateOperator(operat.value.operat, left ? left->constant : 0, right->constant);
+
+  if (!isfinite(value))
+    return true;
+
+  size_t number = db::addENode(graph, db::type_t::NUMBER, {.number = value}, db::NO_CLASS, db::NO_CLASS);
+
+  if (number == db::NO_CLASS)
+    return false;
+
+  db::joinEClasses(graph, number, operat.eclass);
+
+  return true;
+}
+
+static bool growNodes(db::EGraph *graph)
+{
+  assert(graph);
+
+  db::ENode *temp =
+    (db::ENode *)recalloc(
+                          graph->nodes,
+                          (graph->nodesCapacity + 1)*DEFAULT_GROWTH_FACTOR,
+                          sizeof(db::ENode)
+                         );
+  if (!temp)
+    return false;
+
+  graph->nodes = temp;
+
+  ++graph->nodesCapacity;
+  graph->nodesCapacity *= DEFAULT_GROWTH_FACTOR;
+
+  return true;
+}
+
+/// Dropped nodes aren`t put to table
+static bool rehash(db::EGraph *graph, size_t bucketsCount)
+{
+  assert(graph);
+  assert(bucketsCount);
+
+  size_t *buckets = (size_t *)calloc(bucketsCount, sizeof(size_t));
+
+  if (!buckets)
+    return false;
+
+  for (size_t i = 0; i < bucketsCount; ++i)
+    buckets[i] = db::NO_CLASS;
+
+  for (size_t i = 0; i < graph->nodesCount; ++i)
+    {
+      db::ENode *node = &graph->nodes[i];
+
+      if (node->eclass == db::NO_CLASS)
+        continue;
+
+      size_t bucket = hashNode(node->type, node->value, node->left, node->right) % bucketsCount;
+
+      node->next = buckets[bucket];
+      buckets[bucket] = i;
+    }
+
+  free(graph->buckets);
+
+  graph->buckets      = buckets;
+  graph->bucketsCount = bucketsCount;
+
+  return true;
+}
+
+/// Nodes grouped by root of class, e-graph must be rebuilt
+/// @param [out] starts Array of classesCount + 1 offsets, it must be freed
+/// @param [out] members Array of nodes, it must be freed
+static bool indexClasses(const db::EGraph *graph, size_t **starts, size_t **members)
+{
+  assert(graph);
+  assert(starts);
+  assert(members);
+
+  *starts  = (size_t *)calloc(graph->classesCount + 1, sizeof(size_t));
+  *members = (size_t *)calloc(graph->nodesCount    + 1, sizeof(size_t));
+
+  if (!*starts || !*members)
+    return false;
+
+  size_t *offsets = *starts;
+
+  for (size_t i = 0; i < graph->nodesCount; ++i)
+    if (graph->nodes[i].eclass != db::NO_CLASS)
+      ++offsets[graph->nodes[i].eclass + 1];
+
+  for (size_t i = 0; i < graph->classesCount; ++i)
+    offsets[i + 1] += offsets[i];
+
+  // Offsets are moved by one class while nodes are put, so they become starts
+  for (size_t i = 0; i < graph->nodesCount; ++i)
+    if (graph->nodes[i].eclass != db::NO_CLASS)
+      (*members)[offsets[graph->nodes[i].eclass]++] = i;
+
+  for (size_t i = graph->classesCount; i > 0; --i)
+    offsets[i] = offsets[i - 1];
+
+  offsets[0] = 0;
+
+  return true;
+}
+
+static size_t findVariable(const db::RewriteRule *rule, const char *name)
+{
+  assert(rule);
+  assert(name);
+
+  for (size_t i = 0; i < rule->variablesCount; ++i)
+    if (!strcmp(rule->variables[i], name))
+      return i;
+
+  return db::NO_RULE;
+}
+
+/// Subtree of pattern without names like (0 - 1) is one number,
+/// parser has no negative numbers, so rules write them so.
+/// Depth is bounded by MAX_PATTERN_SIZE
+static bool getConstant(const db::TreeNode *pattern, db::number_t *value)
+{
+  assert(pattern);
+  assert(value);
+
+  if (pattern->type == db::type_t::NUMBER)
+    {
+      *value = pattern->value.number;
+
+      return true;
+    }
+
+  if (pattern->type != db::type_t::OPERATOR || !pattern->right)
+    return false;
+
+  db::number_t left  = 0;
+  db::number_t right = 0;
+
+  bool hasLeft = !db::isUnary(pattern->value.operat);
+
+  if ((hasLeft && (!pattern->left || !getConstant(pattern->left, &left))) || !getConstant(pattern->right, &right))
+    return false;
+
+  *value = calculateOperator(pattern->value.operat, left, right);
+
+  return true;
+}
+
+/// Match the last pending subtree of pattern and the rest after it.
+/// Pending subtrees are restored after call, depth is bounded by MAX_PATTERN_SIZE
+static void matchPattern(EMatch *match)
+{
+  assert(match);
+
+  if (match->isFailed || match->foundCount >= match->maxFound)
+    return;
+
+  if (!match->pendingCount)
+    {
+      const size_t *bindings = match->bindings;
+
+      bool isFound = true;
+
+      for (size_t i = 0; i < match->rule->variablesCount && isFound; ++i)
+        isFound = db::push(match->found, &bindings[i]);
+
+      match->isFailed =
+        !isFound ||
+        !db::push(match->found, &match->eclass) ||
+        !db::push(match->found, &match->ruleIndex);
+
+      ++match->foundCount;
+
+      return;
+    }
+
+  const db::EGraph *graph = match->graph;
+
+  PendingPattern next = match->pending[--match->pendingCount];
+
+  const db::TreeNode *pattern = next.pattern;
+
+  db::number_t constant = 0;
+
+  if (pattern->type == db::type_t::VARIABLE)
+    {
+      size_t variable = findVariable(match->rule, pattern->value.variable);
+
+      assert(variable != db::NO_RULE);
+
+      const db::EClass *eclass = &graph->classes[next.eclass];
+
+      bool isAllowed = !db::isPositiveName(pattern->value.variable) || (eclass->isConst && eclass->constant > 0);
+
+      if (match->bindings[variable] == db::NO_CLASS && isAllowed)
+        {
+          match->bindings[variable] = next.eclass;
+
+          matchPattern(match);
+
+          match->bindings[variable] = db::NO_CLASS;
+        }
+      else if (match->bindings[variable] == next.eclass)
+        matchPattern(match);
+    }
+  else if (getConstant(pattern, &constant))
+    {
+      if (graph->classes[next.eclass].isConst && isEqual(graph->classes[next.eclass].constant, constant))
+        matchPattern(match);
+    }
+  else if (pattern->type == db::type_t::OPERATOR)
+    {
+      bool isUnary = db::isUnary(pattern->value.operat);
+
+      for (size_t i = match->starts[next.eclass]; i < match->starts[next.eclass + 1]; ++i)
+        {
+          const db::ENode *node = &graph->nodes[match->members[i]];
+
+          if (node->type != db::type_t::OPERATOR || node->value.operat != pattern->value.operat)
+            continue;
+
+          match->pending[match->pendingCount++] = {pattern->right, node->right};
+
+          if (!isUnary)
+            match->pending[match->pendingCount++] = {pattern->left, node->left};
+
+          matchPattern(match);
+
+          match->pendingCount -= isUnary ? 1 : 2;
+        }
+    }
+
+  match->pending[match->pendingCount++] = next;
+}
+
+/// Add right side of rule, names are classes which they matched.
+/// Depth is bounded by MAX_PATTERN_SIZE
+/// @return Class of result or NO_CLASS
+static size_t addResult(db::EGraph *graph, const db::RewriteRule *rule, const db::TreeNode *node, const size_t *bindings)
+{
+  assert(graph);
+  assert(rule);
+  assert(node);
+  assert(bindings);
+
+  if (node->type == db::type_t::VARIABLE)
+    return bindings[findVariable(rule, node->value.variable)];
+
+  size_t left  = db::NO_CLASS;
+  size_t right = db::NO_CLASS;
+
+  if (node->type == db::type_t::OPERATOR)
+    {
+      bool hasLeft = !db::isUnary(node->value.operat);
+
+      if (hasLeft && (!node->left || (left = addResult(graph, rule, node->left, bindings)) == db::NO_CLASS))
+        return db::NO_CLASS;
+
+      if (!node->right || (right = addResult(graph, rule, node->right, bindings)) == db::NO_CLASS)
+        return db::NO_CLASS;
+    }
+
+  return db::addENode(graph, node->type, node->value, left, right);
+}
+
+static double getCost(const db::CostModel *cost, const db::ENode *node)
+{
+  assert(cost);
+  assert(node);
+
+  switch (node->type)
+    {
+    case db::type_t::NUMBER:
+      return cost->number;
+    case db::type_t::VARIABLE:
+      return cost->variable;
+    case db::type_t::OPERATOR:
+      return node->value.operat < db::OPERATORS_COUNT ? cost->operators[node->value.operat] : INFINITY;
+    default:
+      return INFINITY;
+    }
+}
@@ -0,0 +1,640 @@
+#include "Gradient.h"
+#include "DiffUtils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Assert.h"
+#include "Error.h"
+
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+
+/// Instruction which isn`t operand of any instruction
+const size_t NO_OPERAND = (size_t)-1;
+
+/// Record of forward sweep. Operands are indices of instructions which
+/// made values, LOAD is replaced by instruction which made value of register.
+/// Values are double for gradient and Dual for Hessian-vector products
+template <typename Value>
+struct Tape {
+  Value  *values;
+  Value  *adjoints;
+  size_t *left;
+  size_t *right;
+  bool   *isConstant; ///< Value doesn`t depend on slots
+  size_t *stack;
+  size_t  size;
+};
+
+static inline double apply(db::operator_t operat, double left, double right)
+{
+  return calculateOperator(operat, left, right);
+}
+
+static inline db::Dual apply(db::operator_t operat, db::Dual left, db::Dual right)
+{
+  return db::calculateDual(operat, left, right);
+}
+
+static inline void seed(double *value, const double *slots, const double *, size_t slot)
+{
+  *value = slots[slot];
+}
+
+static inline void seed(db::Dual *value, const double *slots, const double *direction, size_t slot)
+{
+  *value = {slots[slot], direction[slot]};
+}
+
+static inline bool isZero(double value)
+{
+  return value == 0;
+}
+
+static inline bool isZero(db::Dual value)
+{
+  return value.value == 0 && value.derivative == 0;
+}
+
+static inline void constant(double *value, double number)
+{
+  *value = number;
+}
+
+static inline void constant(db::Dual *value, double number)
+{
+  *value = {number, 0};
+}
+
+template <typename Value>
+static bool createTape(Tape<Value> *tape, const db::Program *program);
+
+template <typename Value>
+static void destroyTape(Tape<Value> *tape);
+
+template <typename Value>
+static void forwardSweep(Tape<Value> *tape, const db::Program *program, const double *slots, const double *direction);
+
+template <typename Value>
+static void backwardSweep(Tape<Value> *tape, const db::Program *program, Value *gradient);
+
+template <typename Value>
+static void partials(db::opcode_t opcode, Value left, Value right, Value value, Value *dLeft, Value *dRight);
+
+static bool compileWithSlots(const db::VarTable *table, const db::Tree *tree, db::Program *program, double **slots);
+
+static void hessianVector(
+                          Tape<db::Dual> *tape,
+                          const db::Program *program,
+                          const double *slots,
+                          const double *direction,
+                          db::Dual *gradient
+                         );
+
+double db::executeGradient(const db::Program *program, const double *slots, double *gradient, int *error)
+{
+  if (!program || !program->code || !program->size)
+    ERROR(NAN);
+
+  if (!slots && program->slots)
+    ERROR(NAN);
+
+  if (!gradient && program->slots)
+    ERROR(NAN);
+
+  Tape<double> tape{};
+
+  if (!createTape(&tape, program))
+    ERROR(NAN);
+
+  forwardSweep(&tape, program, slots, nullptr);
+
+  double value = tape.values[tape.stack[0]];
+
+  backwardSweep(&tape, program, gradient);
+
+  destroyTape(&tape);
+
+  return value;
+}
+
+double db::calculateGradient(const db::VarTable *table, const db::Tree *tree, double *gradient, int *error)
+{
+  if (!gradient && table && table->size)
+    ERROR(NAN);
+
+  db::Program program{};
+
+  double *slots = nullptr;
+
+  if (!compileWithSlots(table, tree, &program, &slots))
+    ERROR(NAN);
+
+  for (size_t i = 0; i < table->size; ++i)
+    gradient[i] = 0;
+
+  int errorCode = 0;
+
+  double value = db::executeGradient(&program, slots, gradient, &errorCode);
+
+  free(slots);
+
+  db::destroyProgram(&program);
+
+  if (errorCode)
+    ERROR(NAN);
+
+  return value;
+}
+
+void db::executeHessianVector(
+                              const db::Program *program,
+                              const double *slots,
+                              const double *direction,
+                              double *product,
+                              int *error
+                             )
+{
+  if (!program || !program->code || !program->size)
+    ERROR();
+
+  if ((!slots || !direction || !product) && program->slots)
+    ERROR();
+
+  Tape<db::Dual> tape{};
+
+  if (!createTape(&tape, program))
+    ERROR();
+
+  db::Dual *gradient = (db::Dual *)calloc(program->slots + 1, sizeof(db::Dual));
+
+  if (!gradient)
+    {
+      destroyTape(&tape);
+
+      ERROR();
+    }
+
+  hessianVector(&tape, program, slots, direction, gradient);
+
+  for (size_t i = 0; i < program->slots; ++i)
+    product[i] = gradient[i].derivative;
+
+  free(gradient);
+
+  destroyTape(&tape);
+}
+
+void db::executeHessian(
+                        const db::Program *program,
+                        const double *slots,
+                        const size_t *variables,
+                        size_t count,
+                        double *hessian,
+                        int *error
+                       )
+{
+  if (!program || !program->code || !program->size)
+    ERROR();
+
+  if ((!slots && program->slots) || (count && (!variables || !hessian)))
+    ERROR();
+
+  Tape<db::Dual> tape{};
+
+  if (!createTape(&tape, program))
+    ERROR();
+
+  db::Dual *gradient  = (db::Dual *)calloc(program->slots + 1, sizeof(db::Dual));
+  double   *direction = (double   *)calloc(program->slots + 1, sizeof(double));
+
+  if (!gradient || !direction)
+    {
+      free(gradient);
+      free(direction);
+
+      destroyTape(&tape);
+
+      ERROR();
+    }
+
+  for (size_t j = 0; j < count; ++j)
+    {
+      size_t slot = variables[j];
+
+      // Variables which program doesn`t read have zero rows and columns
+      if (slot < program->slots)
+        {
+          direction[slot] = 1;
+
+          hessianVector(&tape, program, slots, direction, gradient);
+
+          direction[slot] = 0;
+        }
+
+      for (size_t i = 0; i < count; ++i)
+        hessian[i * count + j] =
+          slot < program->slots && variables[i] < program->slots ?
+          gradient[variables[i]].derivative : 0;
+    }
+
+  free(gradient);
+  free(direction);
+
+  destroyTape(&tape);
+}
+
+void db::calculateHessianVector(
+                                const db::VarTable *table,
+                                const db::Tree *tree,
+                                const double *direction,
+                                double *product,
+                                int *error
+                               )
+{
+  if ((!direction || !product) && table && table->size)
+    ERROR();
+
+  db::Program program{};
+
+  double *slots = nullptr;
+
+  if (!compileWithSlots(table, tree, &program, &slots))
+    ERROR();
+
+  for (size_t i = 0; i < table->size; ++i)
+    product[i] = 0;
+
+  int errorCode = 0;
+
+  db::executeHessianVector(&program, slots, direction, product, &errorCode);
+
+  free(slots);
+
+  db::destroyProgram(&program);
+
+  if (errorCode)
+    ERROR();
+}
+
+void db::calculateHessian(
+                          const db::VarTable *table,
+                          const db::Tree *tree,
+                          const char *const *variables,
+                          size_t count,
+                          double *hessian,
+                          int *error
+                         )
+{
+  if (count && (!variables || !hessian))
+    ERROR();
+
+  db::Program program{};
+
+  double *slots = nullptr;
+
+  if (!compileWithSlots(table, tree, &program, &slots))
+    ERROR();
+
+  size_t *variableSlots = (size_t *)calloc(count + 1, sizeof(size_t));
+
+  if (!variableSlots)
+    {
+      free(slots);
+
+      db::destroyProgram(&program);
+
+      ERROR();
+    }
+
+  for (size_t i = 0; i < count; ++i)
+    variableSlots[i] = db::searchVariableSlot(table, variables[i]);
+
+  int errorCode = 0;
+
+  db::executeHessian(&program, slots, variableSlots, count, hessian, &errorCode);
+
+  free(variableSlots);
+  free(slots);
+
+  db::destroyProgram(&program);
+
+  if (errorCode)
+    ERROR();
+}
+
+/// Compile tree and load current values of variables
+static bool compileWithSlots(const db::VarTable *table, const db::Tree *tree, db::Program *program, double **slots)
+{
+  assert(program);
+  assert(slots);
+
+  if (!isVarTableValid(table))
+    return false;
+
+  if (!tree || !tree->root)
+    return false;
+
+  int errorCode = 0;
+
+  db::compileTree(program, tree, table, &errorCode);
+
+  if (errorCode)
+    return false;
+
+  *slots = (double *)calloc(table->size + 1, sizeof(double));
+
+  if (!*slots)
+    {
+      db::destroyProgram(program);
+
+      return false;
+    }
+
+  db::loadSlots(table, *slots);
+
+  return true;
+}
+
+/// Forward-over-reverse: sweeps over dual numbers with derivatives along
+/// direction, so derivatives of adjoints are Hessian-vector product
+static void hessianVector(
+                          Tape<db::Dual> *tape,
+                          const db::Program *program,
+                          const double *slots,
+                          const double *direction,
+                          db::Dual *gradient
+                         )
+{
+  assert(tape);
+  assert(program);
+
+  forwardSweep(tape, program, slots, direction);
+
+  backwardSweep(tape, program, gradient);
+}
+
+template <typename Value>
+static bool createTape(Tape<Value> *tape, const db::Program *program)
+{
+  assert(tape);
+  assert(program);
+
+  size_t size = program->size;
+
+  tape->values     = (Value  *)calloc(size, sizeof(Value));
+  tape->adjoints   = (Value  *)calloc(size, sizeof(Value));
+  tape->left       = (size_t *)calloc(size, sizeof(size_t));
+  tape->right      = (size_t *)calloc(size, sizeof(size_t));
+  tape->isConstant = (bool   *)calloc(size, sizeof(bool));
+  tape->stack      = (size_t *)calloc(program->depth + program->registers, sizeof(size_t));
+  tape->size       = size;
+
+  if (!tape->values || !tape->adjoints || !tape->left || !tape->right || !tape->isConstant || !tape->stack)
+    {
+      destroyTape(tape);
+
+      return false;
+    }
+
+  return true;
+}
+
+template <typename Value>
+static void destroyTape(Tape<Value> *tape)
+{
+  assert(tape);
+
+  free(tape->values);
+  free(tape->adjoints);
+  free(tape->left);
+  free(tape->right);
+  free(tape->isConstant);
+  free(tape->stack);
+}
+
+/// Stack keeps indices of instructions instead of values
+template <typename Value>
+static void forwardSweep(Tape<Value> *tape, const db::Program *program, const double *slots, const double *direction)
+{
+  assert(tape);
+  assert(program);
+
+  size_t *top       = tape->stack;
+  size_t *registers = tape->stack + program->depth;
+
+  Value missing{};
+  constant(&missing, NAN);
+
+  for (size_t i = 0; i < program->size; ++i)
+    {
+      const db::Instruction *ip = &program->code[i];
+
+      tape->left [i] = NO_OPERAND;
+      tape->right[i] = NO_OPERAND;
+
+      switch (ip->opcode)
+        {
+        case db::OPCODE_NUMBER:
+          constant(&tape->values[i], ip->argument.number);
+          tape->isConstant[i] = true;
+          *top++ = i;
+          break;
+        case db::OPCODE_SLOT:
+          seed(&tape->values[i], slots, direction, ip->argument.slot);
+          tape->isConstant[i] = false;
+          *top++ = i;
+          break;
+        case db::OPCODE_ADD:
+        case db::OPCODE_SUB:
+        case db::OPCODE_MUL:
+        case db::OPCODE_DIV:
+        case db::OPCODE_POW:
+        case db::OPCODE_LOG:
+          {
+            --top;
+
+            size_t left  = top[-1];
+            size_t right = top[0];
+
+            tape->left [i] = left;
+            tape->right[i] = right;
+
+            tape->values[i] =
+              apply(
+                    (db::operator_t)(ip->opcode - db::OPCODE_ADD),
+                    tape->values[left],
+                    tape->values[right]
+                   );
+
+            tape->isConstant[i] = tape->isConstant[left] && tape->isConstant[right];
+
+            top[-1] = i;
+            break;
+          }
+        case db::OPCODE_SQRT:
+        case db::OPCODE_SIN:
+        case db::OPCODE_COS:
+        case db::OPCODE_LN:
+          {
+            size_t right = top[-1];
+
+            tape->right[i] = right;
+
+            tape->values[i] =
+              apply(
+                    (db::operator_t)(ip->opcode - db::OPCODE_ADD),
+                    missing,
+                    tape->values[right]
+                   );
+
+            tape->isConstant[i] = tape->isConstant[right];
+
+            top[-1] = i;
+            break;
+          }
+        case db::OPCODE_STORE: registers[ip->argument.index] = top[-1]; break;
+        case db::OPCODE_LOAD : *top++ = registers[ip->argument.index];  break;
+        case db::OPCODES_COUNT:
+        default: assert(0 && "Invalid opcode");
+        }
+    }
+}
+
+/// Adjoints go from results to operands in reverse order of instructions.
+/// Operands which don`t depend on slots are skipped, so x^2 has
+/// derivative for negative x like in calculateDual()
+template <typename Value>
+static void backwardSweep(Tape<Value> *tape, const db::Program *program, Value *gradient)
+{
+  assert(tape);
+  assert(program);
+
+  Value zero{};
+  constant(&zero, 0);
+
+  for (size_t i = 0; i < program->slots; ++i)
+    gradient[i] = zero;
+
+  for (size_t i = 0; i < tape->size; ++i)
+    tape->adjoints[i] = zero;
+
+  constant(&tape->adjoints[tape->stack[0]], 1);
+
+  for (size_t i = tape->size; i-- > 0; )
+    {
+      const db::Instruction *ip = &program->code[i];
+
+      Value adjoint = tape->adjoints[i];
+
+      if (tape->isConstant[i] || isZero(adjoint))
+        continue;
+
+      if (ip->opcode == db::OPCODE_SLOT)
+        {
+          gradient[ip->argument.slot] = apply(db::OPERATOR_ADD, gradient[ip->argument.slot], adjoint);
+
+          continue;
+        }
+
+      if (ip->opcode < db::OPCODE_ADD || ip->opcode > db::OPCODE_LN)
+        continue;
+
+      size_t left  = tape->left [i];
+      size_t right = tape->right[i];
+
+      Value dLeft  = zero;
+      Value dRight = zero;
+
+      partials(
+               ip->opcode,
+               left != NO_OPERAND ? tape->values[left] : zero,
+               tape->values[right],
+               tape->values[i],
+               &dLeft,
+               &dRight
+              );
+
+      if (left != NO_OPERAND && !tape->isConstant[left])
+        tape->adjoints[left] =
+          apply(db::OPERATOR_ADD, tape->adjoints[left], apply(db::OPERATOR_MUL, adjoint, dLeft));
+
+      if (!tape->isConstant[right])
+        tape->adjoints[right] =
+          apply(db::OPERATOR_ADD, tape->adjoints[right], apply(db::OPERATOR_MUL, adjoint, dRight));
+    }
+}
+
+/// Partial derivatives of operator by operands, unary operators use only right
+template <typename Value>
+static void partials(db::opcode_t opcode, Value left, Value right, Value value, Value *dLeft, Value *dRight)
+{
+  assert(dLeft);
+  assert(dRight);
+
+  Value one{};
+  Value two{};
+  constant(&one, 1);
+  constant(&two, 2);
+
+  Value minusOne{};
+  constant(&minusOne, -1);
+
+  switch (opcode)
+    {
+    case db::OPCODE_ADD:
+      *dLeft  = one;
+      *dRight = one;
+      break;
+    case db::OPCODE_SUB:
+      *dLeft  = one;
+      *dRight = minusOne;
+      break;
+    case db::OPCODE_MUL:
+      *dLeft  = right;
+      *dRight = left;
+      break;
+    case db::OPCODE_DIV:
+      *dLeft  = apply(db::OPERATOR_DIV, one, right);
+      *dRight = apply(db::OPERATOR_DIV, apply(db::OPERATOR_MUL, minusOne, value), right);
+      break;
+    case db::OPCODE_POW:
+      *dLeft  = apply(
+                      db::OPERATOR_MUL,
+                      right,
+                      apply(db::OPERATOR_POW, left, apply(db::OPERATOR_SUB, right, one))
+                     );
+      *dRight = apply(db::OPERATOR_MUL, value, apply(db::OPERATOR_LN, left, left));
+      break;
+    case db::OPCODE_LOG:
+      {
+        Value lnLeft = apply(db::OPERATOR_LN, left, left);
+
+        *dLeft  = apply(
+                        db::OPERATOR_DIV,
+                        apply(db::OPERATOR_MUL, minusOne, value),
+                        apply(db::OPERATOR_MUL, left, lnLeft)
+                       );
+        *dRight = apply(db::OPERATOR_DIV, one, apply(db::OPERATOR_MUL, right, lnLeft));
+        break;
+      }
+    case db::OPCODE_SQRT:
+      *dRight = apply(db::OPERATOR_DIV, one, apply(db::OPERATOR_MUL, two, value));
+      break;
+    case db::OPCODE_SIN:
+      *dRight = apply(db::OPERATOR_COS, right, right);
+      break;
+    case db::OPCODE_COS:
+      *dRight = apply(db::OPERATOR_MUL, minusOne, apply(db::OPERATOR_SIN, right, right));
+      break;
+    case db::OPCODE_LN:
+      *dRight = apply(db::OPERATOR_DIV, one, right);
+      break;
+    case db::OPCODE_NUMBER:
+    case db::OPCODE_SLOT:
+    case db::OPCODE_STORE:
+    case db::OPCODE_LOAD:
+    case db::OPCODES_COUNT:
+    default: break;
+    }
+}
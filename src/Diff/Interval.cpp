@@ -0,0 +1,470 @@
+#include "Interval.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include "Stack.h"
+#include "Assert.h"
+#include "Error.h"
+
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+
+const size_t MAX_LOCAL_DEPTH = 64;
+
+/// Node which is calculated after its children
+struct IntervalFrame {
+  const db::TreeNode *node;
+  bool                isVisited;
+};
+
+/// Slack for search of extremums of sin and cos, it covers error of M_PI
+const double PERIOD_SLACK = 1e-9;
+
+/// Max integer which double keeps exactly
+const double MAX_EXACT_INTEGER = 9007199254740992.;
+
+static inline double down(double value) { return nextafter(value, -INFINITY); }
+static inline double up  (double value) { return nextafter(value,  INFINITY); }
+
+/// Bounds are rounded outward, NAN bound (like inf - inf) is replaced by infinity
+static inline db::Interval outward(double lo, double hi)
+{
+  return {isnan(lo) ? -INFINITY : down(lo), isnan(hi) ? INFINITY : up(hi)};
+}
+
+static inline db::Interval point(double value)
+{
+  if (isnan(value))
+    return db::EMPTY_INTERVAL;
+
+  return {value, value};
+}
+
+static inline bool isInteger(double value)
+{
+  return fabs(value) < MAX_EXACT_INTEGER && value == nearbyint(value);
+}
+
+static db::Interval add (db::Interval left, db::Interval right);
+static db::Interval sub (db::Interval left, db::Interval right);
+static db::Interval mul (db::Interval left, db::Interval right);
+static db::Interval div (db::Interval left, db::Interval right);
+static db::Interval pow (db::Interval left, db::Interval right);
+static db::Interval sqrt(db::Interval value);
+static db::Interval sin (db::Interval value);
+static db::Interval cos (db::Interval value);
+static db::Interval ln  (db::Interval value);
+
+static db::Interval powReal   (db::Interval left, db::Interval right);
+static db::Interval powInteger(db::Interval value, double power);
+
+static inline bool contains(db::Interval interval, double value)
+{
+  return interval.lo <= value && value <= interval.hi;
+}
+
+static bool containsPeriodic(db::Interval value, double offset, double period);
+
+db::Interval db::calculateInterval(db::operator_t operat, db::Interval left, db::Interval right)
+{
+  switch (operat)
+    {
+    case db::OPERATOR_ADD : return add(left, right);
+    case db::OPERATOR_SUB : return sub(left, right);
+    case db::OPERATOR_MUL : return mul(left, right);
+    case db::OPERATOR_DIV : return div(left, right);
+    case db::OPERATOR_POW : return pow(left, right);
+    case db::OPERATOR_LOG : return div(ln(right), ln(left));
+    case db::OPERATOR_SQRT: return sqrt(right);
+    case db::OPERATOR_SIN : return sin (right);
+    case db::OPERATOR_COS : return cos (right);
+    case db::OPERATOR_LN  : return ln  (right);
+    case db::OPERATORS_COUNT:
+    default: return db::EMPTY_INTERVAL;
+    }
+}
+
+db::Interval db::calculateInterval(const db::VarTable *table, const db::Interval *box, const db::TreeNode *node)
+{
+  assert(table);
+  assert(box || !table->size);
+  assert(node);
+
+  db::Stack frames{};
+  db::Stack values{};
+
+  db::createStack(&frames, sizeof(IntervalFrame));
+  db::createStack(&values, sizeof(db::Interval));
+
+  IntervalFrame frame = {node, false};
+
+  bool isPushed = db::push(&frames, &frame);
+
+  while (isPushed && db::pop(&frames, &frame))
+    {
+      const db::TreeNode *current = frame.node;
+
+      db::Interval value = db::EMPTY_INTERVAL;
+
+      switch (current->type)
+        {
+        case db::type_t::NUMBER:
+          value = point(current->value.number);
+          break;
+        case db::type_t::VARIABLE:
+          {
+            size_t slot = db::searchVariableSlot(table, current->value.variable);
+
+            if (slot != db::NO_SLOT)
+              value = box[slot];
+            break;
+          }
+        case db::type_t::OPERATOR:
+          {
+            if (!frame.isVisited)
+              {
+                IntervalFrame visited = {current       , true };
+                IntervalFrame left    = {current->left , false};
+                IntervalFrame right   = {current->right, false};
+
+                isPushed =
+                  db::push(&frames, &visited) &&
+                  (!right.node || db::push(&frames, &right)) &&
+                  (!left .node || db::push(&frames, &left ));
+
+                continue;
+              }
+
+            db::Interval left  = db::EMPTY_INTERVAL;
+            db::Interval right = db::EMPTY_INTERVAL;
+
+            if (current->right) db::pop(&values, &right);
+            if (current->left ) db::pop(&values, &left );
+
+            value = db::calculateInterval(current->value.operat, left, right);
+            break;
+          }
+        default:
+          break;
+        }
+
+      isPushed = db::push(&values, &value);
+    }
+
+  db::Interval result = db::EMPTY_INTERVAL;
+
+  if (isPushed)
+    db::pop(&values, &result);
+
+  db::destroyStack(&frames);
+  db::destroyStack(&values);
+
+  return result;
+}
+
+db::Interval db::executeInterval(const db::Program *program, const db::Interval *box, int *error)
+{
+  db::Interval result = db::EMPTY_INTERVAL;
+
+  if (program && program->outputs > 1)
+    {
+      db::Interval *results = (db::Interval *)calloc(program->outputs, sizeof(db::Interval));
+
+      if (!results)
+        ERROR(db::EMPTY_INTERVAL);
+
+      db::executeIntervals(program, box, results, error);
+
+      result = results[0];
+
+      free(results);
+
+      return result;
+    }
+
+  db::executeIntervals(program, box, &result, error);
+
+  return result;
+}
+
+void db::executeIntervals(const db::Program *program, const db::Interval *box, db::Interval *results, int *error)
+{
+  if (!program || !program->code)
+    ERROR();
+
+  if (!box && program->slots)
+    ERROR();
+
+  if (!results)
+    ERROR();
+
+  db::Interval  localMemory[MAX_LOCAL_DEPTH] = {};
+  db::Interval *memory = localMemory;
+
+  if (program->depth + program->registers > MAX_LOCAL_DEPTH)
+    {
+      memory = (db::Interval *)calloc(program->depth + program->registers, sizeof(db::Interval));
+
+      if (!memory)
+        ERROR();
+    }
+
+  db::Interval *top       = memory;
+  db::Interval *registers = memory + program->depth;
+
+  const db::Instruction *end = program->code + program->size;
+
+  for (const db::Instruction *ip = program->code; ip < end; ++ip)
+    switch (ip->opcode)
+      {
+      case db::OPCODE_NUMBER: *top++ = point(ip->argument.number); break;
+      case db::OPCODE_SLOT  : *top++ = box[ip->argument.slot];     break;
+      case db::OPCODE_ADD:
+      case db::OPCODE_SUB:
+      case db::OPCODE_MUL:
+      case db::OPCODE_DIV:
+      case db::OPCODE_POW:
+      case db::OPCODE_LOG:
+        --top;
+        top[-1] = db::calculateInterval((db::operator_t)(ip->opcode - db::OPCODE_ADD), top[-1], top[0]);
+        break;
+      case db::OPCODE_SQRT:
+      case db::OPCODE_SIN:
+      case db::OPCODE_COS:
+      case db::OPCODE_LN:
+        top[-1] = db::calculateInterval((db::operator_t)(ip->opcode - db::OPCODE_ADD), top[-1], top[-1]);
+        break;
+      case db::OPCODE_STORE: registers[ip->argument.index] = top[-1]; break;
+      case db::OPCODE_LOAD : *top++ = registers[ip->argument.index];  break;
+      case db::OPCODES_COUNT:
+      default: assert(0 && "Invalid opcode");
+      }
+
+  for (size_t i = 0; i < program->outputs; ++i)
+    results[i] = memory[i];
+
+  if (memory != localMemory)
+    free(memory);
+}
+
+static db::Interval add(db::Interval left, db::Interval right)
+{
+  if (db::isEmpty(left) || db::isEmpty(right))
+    return db::EMPTY_INTERVAL;
+
+  return outward(left.lo + right.lo, left.hi + right.hi);
+}
+
+static db::Interval sub(db::Interval left, db::Interval right)
+{
+  if (db::isEmpty(left) || db::isEmpty(right))
+    return db::EMPTY_INTERVAL;
+
+  return outward(left.lo - right.hi, left.hi - right.lo);
+}
+
+/// Product of bounds where zero times infinity is zero
+static inline double mulBound(double first, double second)
+{
+  if (first == 0 || second == 0)
+    return 0;
+
+  return first * second;
+}
+
+static db::Interval mul(db::Interval left, db::Interval right)
+{
+  if (db::isEmpty(left) || db::isEmpty(right))
+    return db::EMPTY_INTERVAL;
+
+  double products[] =
+    {
+      mulBound(left.lo, right.lo),
+      mulBound(left.lo, right.hi),
+      mulBound(left.hi, right.lo),
+      mulBound(left.hi, right.hi),
+    };
+
+  double lo = products[0];
+  double hi = products[0];
+
+  for (double product : products)
+    {
+      lo = fmin(lo, product);
+      hi = fmax(hi, product);
+    }
+
+  return outward(lo, hi);
+}
+
+/// If divisor contains zero, it can be zero of both signs, so quotient
+/// takes values up to both infinities. Only 0/0 is undefined
+static db::Interval div(db::Interval left, db::Interval right)
+{
+  if (db::isEmpty(left) || db::isEmpty(right))
+    return db::EMPTY_INTERVAL;
+
+  if (contains(right, 0))
+    {
+      if (left.lo == 0 && left.hi == 0)
+        return right.lo == 0 && right.hi == 0 ? db::EMPTY_INTERVAL : db::Interval{0, 0};
+
+      return db::ENTIRE_INTERVAL;
+    }
+
+  return mul(left, outward(1 / right.hi, 1 / right.lo));
+}
+
+static db::Interval sqrt(db::Interval value)
+{
+  if (db::isEmpty(value) || value.hi < 0)
+    return db::EMPTY_INTERVAL;
+
+  double lo = sqrt(fmax(value.lo, 0));
+
+  return {fmax(down(lo), 0), up(sqrt(value.hi))};
+}
+
+static db::Interval ln(db::Interval value)
+{
+  if (db::isEmpty(value) || value.hi < 0)
+    return db::EMPTY_INTERVAL;
+
+  if (value.hi == 0)
+    return {-INFINITY, -INFINITY};
+
+  double lo = value.lo > 0 ? down(log(value.lo)) : -INFINITY;
+
+  return {lo, up(log(value.hi))};
+}
+
+static db::Interval sin(db::Interval value)
+{
+  if (db::isEmpty(value))
+    return db::EMPTY_INTERVAL;
+
+  if (!isfinite(value.lo) || !isfinite(value.hi) || value.hi - value.lo >= 2*M_PI)
+    return {-1, 1};
+
+  double lo = fmin(sin(value.lo), sin(value.hi));
+  double hi = fmax(sin(value.lo), sin(value.hi));
+
+  lo = containsPeriodic(value, -M_PI/2, 2*M_PI) ? -1 : fmax(down(lo), -1);
+  hi = containsPeriodic(value,  M_PI/2, 2*M_PI) ?  1 : fmin(up  (hi),  1);
+
+  return {lo, hi};
+}
+
+static db::Interval cos(db::Interval value)
+{
+  if (db::isEmpty(value))
+    return db::EMPTY_INTERVAL;
+
+  if (!isfinite(value.lo) || !isfinite(value.hi) || value.hi - value.lo >= 2*M_PI)
+    return {-1, 1};
+
+  double lo = fmin(cos(value.lo), cos(value.hi));
+  double hi = fmax(cos(value.lo), cos(value.hi));
+
+  lo = containsPeriodic(value, M_PI, 2*M_PI) ? -1 : fmax(down(lo), -1);
+  hi = containsPeriodic(value, 0   , 2*M_PI) ?  1 : fmin(up  (hi),  1);
+
+  return {lo, hi};
+}
+
+/// Check that offset + k*period is in value for some integer k.
+/// Check is widened by slack, so it never misses point
+static bool containsPeriodic(db::Interval value, double offset, double period)
+{
+  double k = ceil((value.lo - offset) / period - PERIOD_SLACK);
+
+  return offset + k*period <= value.hi + PERIOD_SLACK*period;
+}
+
+static inline db::Interval include(db::Interval interval, double value)
+{
+  return {fmin(interval.lo, value), fmax(interval.hi, value)};
+}
+
+/// pow(x, 0) and pow(1, y) are 1 even if other argument is NAN,
+/// so 1 is added to result if one of arguments can give it.
+/// pow(-inf, y) is defined for every y: it is inf for y > 0 and 0 for y < 0
+static db::Interval pow(db::Interval left, db::Interval right)
+{
+  db::Interval result = powReal(left, right);
+
+  if (contains(right, 0) || contains(left, 1))
+    result = include(result, 1);
+
+  if (left.lo == -INFINITY && !db::isEmpty(right))
+    {
+      if (right.hi > 0)
+        result = include(result, INFINITY);
+
+      if (right.lo < 0)
+        result = include(result, 0);
+    }
+
+  return result;
+}
+
+/// pow() is defined for negative base only with integer power, so
+/// integer point power is handled separately. Otherwise for positive base
+/// pow() is monotonic by every argument and extremums are in corners
+static db::Interval powReal(db::Interval left, db::Interval right)
+{
+  if (db::isEmpty(left) || db::isEmpty(right))
+    return db::EMPTY_INTERVAL;
+
+  if (right.lo == right.hi && isInteger(right.lo))
+    return powInteger(left, right.lo);
+
+  if (left.lo < 0 && ceil(right.lo) <= floor(right.hi))
+    return db::ENTIRE_INTERVAL;
+
+  if (left.hi < 0)
+    return db::EMPTY_INTERVAL;
+
+  left.lo = fmax(left.lo, 0);
+
+  double corners[] =
+    {
+      pow(left.lo, right.lo),
+      pow(left.lo, right.hi),
+      pow(left.hi, right.lo),
+      pow(left.hi, right.hi),
+    };
+
+  double lo = corners[0];
+  double hi = corners[0];
+
+  for (double corner : corners)
+    {
+      lo = fmin(lo, corner);
+      hi = fmax(hi, corner);
+    }
+
+  return {fmax(down(lo), 0), up(hi)};
+}
+
+static db::Interval powInteger(db::Interval value, double power)
+{
+  if (power == 0)
+    return {1, 1};
+
+  if (power < 0)
+    return div({1, 1}, powInteger(value, -power));
+
+  double lo = pow(value.lo, power);
+  double hi = pow(value.hi, power);
+
+  if (fmod(power, 2) != 0)
+    return outward(lo, hi);
+
+  if (value.lo >= 0)
+    return {fmax(down(lo), 0), up(hi)};
+
+  if (value.hi <= 0)
+    return {fmax(down(hi), 0), up(lo)};
+
+  return {0, up(fmax(lo, hi))};
+}
@@ -0,0 +1,475 @@
+#include "Jit.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+#include "SystemLike.h"
+#include "Assert.h"
+#include "Error.h"
+
+const int DEFAULT_GROWTH_FACTOR = 2;
+
+typedef double (*unaryFunction_t) (double);
+typedef double (*binaryFunction_t)(double, double);
+
+/// Machine code under construction
+struct CodeBuffer {
+  unsigned char *data;
+  size_t capacity;
+  size_t size;
+  bool failed;
+};
+
+/// Registers which are used as base of memory operands
+enum base_t {
+  BASE_STACK = 3, ///< rbx - stack of values
+  BASE_SLOTS = 5, ///< rbp - values of variables
+};
+
+/// Second bytes of SSE2 scalar double instructions
+enum sse_t {
+  SSE_LOAD  = 0x10,
+  SSE_STORE = 0x11,
+  SSE_SQRT  = 0x51,
+  SSE_ADD   = 0x58,
+  SSE_MUL   = 0x59,
+  SSE_SUB   = 0x5C,
+  SSE_DIV   = 0x5E,
+};
+
+static void emitByte (CodeBuffer *buffer, unsigned char byte);
+static void emitInt32(CodeBuffer *buffer, int32_t value);
+static void emitInt64(CodeBuffer *buffer, uint64_t value);
+
+static void emitOffset(CodeBuffer *buffer, size_t index);
+
+static void emitSse (CodeBuffer *buffer, sse_t operation, int xmm, base_t base, size_t index);
+static void emitCall(CodeBuffer *buffer, uintptr_t function);
+
+static void emitNumber (CodeBuffer *buffer, double number, size_t position);
+static void emitBinary (CodeBuffer *buffer, sse_t operation, size_t position);
+static void emitUnaryCall (CodeBuffer *buffer, unaryFunction_t  function, size_t position);
+static void emitBinaryCall(CodeBuffer *buffer, binaryFunction_t function, size_t position);
+static void emitLog(CodeBuffer *buffer, size_t position);
+
+static void translate(CodeBuffer *buffer, const db::Program *program);
+
+static void *allocateExecutable(const CodeBuffer *buffer);
+
+bool db::isJitAvailable()
+{
+#if defined(__x86_64__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void db::compileJit(db::JitProgram *jit, const db::Program *program, int *error)
+{
+  if (!jit)
+    ERROR();
+
+  if (!program || !program->code)
+    ERROR();
+
+  jit->code     = nullptr;
+  jit->size     = 0;
+  jit->function = nullptr;
+  jit->program  = program;
+
+  if (!db::isJitAvailable())
+    return;
+
+  CodeBuffer buffer = {};
+
+  translate(&buffer, program);
+
+  if (!buffer.failed)
+    jit->code = allocateExecutable(&buffer);
+
+  free(buffer.data);
+
+  if (!jit->code)
+    return;
+
+  jit->size     = buffer.size;
+  jit->function = (db::jitFunction_t)(uintptr_t)jit->code;
+}
+
+void db::destroyJit(db::JitProgram *jit, int *error)
+{
+  if (!jit)
+    ERROR();
+
+  if (jit->code)
+    munmap(jit->code, jit->size);
+
+  jit->code     = nullptr;
+  jit->size     = 0;
+  jit->function = nullptr;
+  jit->program  = nullptr;
+}
+
+double db::executeJit(const db::JitProgram *jit, db::Context *context, int *error)
+{
+  if (!jit || !jit->program)
+    ERROR(NAN);
+
+  if (!context || context->slotsCount < jit->program->slots)
+    ERROR(NAN);
+
+  if (!jit->function)
+    return db::executeProgram(jit->program, context->slots, error);
+
+  int errorCode = 0;
+
+  db::reserveStack(context, jit->program->depth + jit->program->registers, &errorCode);
+
+  if (errorCode)
+    ERROR(NAN);
+
+  return jit->function(context->slots, context->stack);
+}
+
+void db::executeJit(
+                    const db::JitProgram *jit,
+                    db::Context *context,
+                    size_t slot,
+                    const double *values,
+                    double *results,
+                    size_t count,
+                    int *error
+                   )
+{
+  if (!jit || !jit->program)
+    ERROR();
+
+  if (!context || context->slotsCount < jit->program->slots)
+    ERROR();
+
+  if (!jit->function)
+    {
+      db::executeProgram(jit->program, context, slot, values, results, count, error);
+
+      return;
+    }
+
+  if (!count)
+    return;
+
+  if (!values || !results || slot >= context->slotsCount)
+    ERROR();
+
+  int errorCode = 0;
+
+  db::reserveStack(context, jit->program->depth + jit->program->registers, &errorCode);
+
+  if (errorCode)
+    ERROR();
+
+  double origin = context->slots[slot];
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      context->slots[slot] = values[i];
+
+      results[i] = jit->function(context->slots, context->stack);
+    }
+
+  context->slots[slot] = origin;
+}
+
+void db::executeJitOutputs(
+                           const db::JitProgram *jit,
+                           db::Context *context,
+                           size_t slot,
+                           const double *values,
+                           double *const *results,
+                           size_t count,
+                           int *error
+                          )
+{
+  if (!jit || !jit->program)
+    ERROR();
+
+  if (!context || context->slotsCount < jit->program->slots)
+    ERROR();
+
+  if (!jit->function)
+    {
+      db::executeOutputs(jit->program, context, slot, values, results, count, error);
+
+      return;
+    }
+
+  if (!count)
+    return;
+
+  if (!values || !results || slot >= context->slotsCount)
+    ERROR();
+
+  size_t outputs = jit->program->outputs;
+
+  for (size_t i = 0; i < outputs; ++i)
+    if (!results[i])
+      ERROR();
+
+  int errorCode = 0;
+
+  db::reserveStack(context, jit->program->depth + jit->program->registers, &errorCode);
+
+  if (errorCode)
+    ERROR();
+
+  double origin = context->slots[slot];
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      context->slots[slot] = values[i];
+
+      jit->function(context->slots, context->stack);
+
+      for (size_t j = 0; j < outputs; ++j)
+        results[j][i] = context->stack[j];
+    }
+
+  context->slots[slot] = origin;
+}
+
+/// Function gets slots in rdi and stack in rsi, they are saved in
+/// callee-saved rbp and rbx. Value on position p of stack is [rbx + 8*p],
+/// positions are known while translating, so stack pointer isn`t needed.
+/// Registers of program are kept after stack
+static void translate(CodeBuffer *buffer, const db::Program *program)
+{
+  assert(buffer);
+  assert(program);
+
+  static const unsigned char PROLOGUE[] =
+    {
+      0x55,                   // push rbp
+      0x53,                   // push rbx
+      0x48, 0x83, 0xEC, 0x08, // sub  rsp, 8
+      0x48, 0x89, 0xFD,       // mov  rbp, rdi
+      0x48, 0x89, 0xF3,       // mov  rbx, rsi
+    };
+
+  static const unsigned char EPILOGUE[] =
+    {
+      0x48, 0x83, 0xC4, 0x08, // add rsp, 8
+      0x5B,                   // pop rbx
+      0x5D,                   // pop rbp
+      0xC3,                   // ret
+    };
+
+  for (unsigned char byte : PROLOGUE)
+    emitByte(buffer, byte);
+
+  size_t position = 0;
+
+  const db::Instruction *end = program->code + program->size;
+
+  for (const db::Instruction *ip = program->code; ip < end; ++ip)
+    switch (ip->opcode)
+      {
+      case db::OPCODE_NUMBER:
+        emitNumber(buffer, ip->argument.number, position++);
+        break;
+      case db::OPCODE_SLOT:
+        emitSse(buffer, SSE_LOAD , 0, BASE_SLOTS, ip->argument.slot);
+        emitSse(buffer, SSE_STORE, 0, BASE_STACK, position++);
+        break;
+      case db::OPCODE_ADD : emitBinary(buffer, SSE_ADD, position--); break;
+      case db::OPCODE_SUB : emitBinary(buffer, SSE_SUB, position--); break;
+      case db::OPCODE_MUL : emitBinary(buffer, SSE_MUL, position--); break;
+      case db::OPCODE_DIV : emitBinary(buffer, SSE_DIV, position--); break;
+      case db::OPCODE_SQRT:
+        emitSse(buffer, SSE_SQRT , 0, BASE_STACK, position - 1);
+        emitSse(buffer, SSE_STORE, 0, BASE_STACK, position - 1);
+        break;
+      case db::OPCODE_SIN: emitUnaryCall(buffer, (unaryFunction_t)sin, position); break;
+      case db::OPCODE_COS: emitUnaryCall(buffer, (unaryFunction_t)cos, position); break;
+      case db::OPCODE_LN : emitUnaryCall(buffer, (unaryFunction_t)log, position); break;
+      case db::OPCODE_POW: emitBinaryCall(buffer, (binaryFunction_t)pow, position--); break;
+      case db::OPCODE_LOG: emitLog(buffer, position--); break;
+      case db::OPCODE_STORE:
+        emitSse(buffer, SSE_LOAD , 0, BASE_STACK, position - 1);
+        emitSse(buffer, SSE_STORE, 0, BASE_STACK, program->depth + ip->argument.index);
+        break;
+      case db::OPCODE_LOAD:
+        emitSse(buffer, SSE_LOAD , 0, BASE_STACK, program->depth + ip->argument.index);
+        emitSse(buffer, SSE_STORE, 0, BASE_STACK, position++);
+        break;
+      case db::OPCODES_COUNT:
+      default:
+        buffer->failed = true;
+        break;
+      }
+
+  emitSse(buffer, SSE_LOAD, 0, BASE_STACK, 0);
+
+  for (unsigned char byte : EPILOGUE)
+    emitByte(buffer, byte);
+}
+
+static void *allocateExecutable(const CodeBuffer *buffer)
+{
+  assert(buffer);
+
+  void *code = mmap(nullptr, buffer->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (code == MAP_FAILED)
+    return nullptr;
+
+  memcpy(code, buffer->data, buffer->size);
+
+  if (mprotect(code, buffer->size, PROT_READ | PROT_EXEC))
+    {
+      munmap(code, buffer->size);
+
+      return nullptr;
+    }
+
+  return code;
+}
+
+static void emitNumber(CodeBuffer *buffer, double number, size_t position)
+{
+  uint64_t bits = 0;
+  memcpy(&bits, &number, sizeof(bits));
+
+  emitByte (buffer, 0x48);                    // mov rax, imm64
+  emitByte (buffer, 0xB8);
+  emitInt64(buffer, bits);
+
+  emitByte (buffer, 0x48);                    // mov [rbx + disp32], rax
+  emitByte (buffer, 0x89);
+  emitByte (buffer, 0x83);
+  emitOffset(buffer, position);
+}
+
+/// stack[position - 2] = stack[position - 2] OPERATION stack[position - 1]
+static void emitBinary(CodeBuffer *buffer, sse_t operation, size_t position)
+{
+  assert(position >= 2);
+
+  emitSse(buffer, SSE_LOAD , 0, BASE_STACK, position - 2);
+  emitSse(buffer, operation, 0, BASE_STACK, position - 1);
+  emitSse(buffer, SSE_STORE, 0, BASE_STACK, position - 2);
+}
+
+static void emitUnaryCall(CodeBuffer *buffer, unaryFunction_t function, size_t position)
+{
+  assert(position >= 1);
+
+  emitSse (buffer, SSE_LOAD , 0, BASE_STACK, position - 1);
+  emitCall(buffer, (uintptr_t)function);
+  emitSse (buffer, SSE_STORE, 0, BASE_STACK, position - 1);
+}
+
+static void emitBinaryCall(CodeBuffer *buffer, binaryFunction_t function, size_t position)
+{
+  assert(position >= 2);
+
+  emitSse (buffer, SSE_LOAD , 0, BASE_STACK, position - 2);
+  emitSse (buffer, SSE_LOAD , 1, BASE_STACK, position - 1);
+  emitCall(buffer, (uintptr_t)function);
+  emitSse (buffer, SSE_STORE, 0, BASE_STACK, position - 2);
+}
+
+/// stack[position - 2] = ln(stack[position - 1]) / ln(stack[position - 2])
+static void emitLog(CodeBuffer *buffer, size_t position)
+{
+  assert(position >= 2);
+
+  emitUnaryCall(buffer, (unaryFunction_t)log, position    );
+  emitUnaryCall(buffer, (unaryFunction_t)log, position - 1);
+
+  emitSse(buffer, SSE_LOAD , 0, BASE_STACK, position - 1);
+  emitSse(buffer, SSE_DIV  , 0, BASE_STACK, position - 2);
+  emitSse(buffer, SSE_STORE, 0, BASE_STACK, position - 2);
+}
+
+/// OPERATION xmm, [base + 8*index]
+static void emitSse(CodeBuffer *buffer, sse_t operation, int xmm, base_t base, size_t index)
+{
+  assert(xmm == 0 || xmm == 1);
+
+  emitByte (buffer, 0xF2);
+  emitByte (buffer, 0x0F);
+  emitByte (buffer, (unsigned char)operation);
+  emitByte (buffer, (unsigned char)(0x80 | xmm << 3 | base));
+  emitOffset(buffer, index);
+}
+
+static void emitCall(CodeBuffer *buffer, uintptr_t function)
+{
+  emitByte (buffer, 0x48);                    // mov rax, imm64
+  emitByte (buffer, 0xB8);
+  emitInt64(buffer, function);
+
+  emitByte (buffer, 0xFF);                    // call rax
+  emitByte (buffer, 0xD0);
+}
+
+static void emitInt32(CodeBuffer *buffer, int32_t value)
+{
+  for (size_t i = 0; i < sizeof(value); ++i)
+    emitByte(buffer, (unsigned char)((uint32_t)value >> (8*i)));
+}
+
+/// Displacement of value index, code fails if it doesn`t fit in disp32,
+/// so program is interpreted
+static void emitOffset(CodeBuffer *buffer, size_t index)
+{
+  assert(buffer);
+
+  if (index > INT32_MAX / sizeof(double))
+    {
+      buffer->failed = true;
+
+      return;
+    }
+
+  emitInt32(buffer, (int32_t)(index * sizeof(double)));
+}
+
+static void emitInt64(CodeBuffer *buffer, uint64_t value)
+{
+  for (size_t i = 0; i < sizeof(value); ++i)
+    emitByte(buffer, (unsigned char)(value >> (8*i)));
+}
+
+static void emitByte(CodeBuffer *buffer, unsigned char byte)
+{
+  assert(buffer);
+
+  if (buffer->failed)
+    return;
+
+  if (buffer->size == buffer->capacity)
+    {
+      unsigned char *temp =
+        (unsigned char *)recalloc(
+                                  buffer->data,
+                                  (buffer->capacity + 1)*DEFAULT_GROWTH_FACTOR,
+                                  sizeof(unsigned char)
+                                 );
+      if (!temp)
+        {
+          buffer->failed = true;
+
+          return;
+        }
+
+      buffer->data = temp;
+
+      ++buffer->capacity;
+      buffer->capacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  buffer->data[buffer->size++] = byte;
+}
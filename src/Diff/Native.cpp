@@ -0,0 +1,415 @@
+#include "Native.h"
+#include "Program.h"
+#include "DiffUtils.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "SystemLike.h"
+#include "ErrorHandler.h"
+#include "Assert.h"
+#include "Error.h"
+
+const int MAX_PATH_SIZE    = 256;
+const int MAX_COMMAND_SIZE = 1024;
+const int MAX_SYMBOL_SIZE  = 64;
+
+const uint64_t FNV_OFFSET = 0xCBF29CE484222325;
+const uint64_t FNV_PRIME  = 0x100000001B3;
+
+static bool generateFunction(FILE *file, const db::Program *program, size_t index);
+
+static void printNumber(FILE *file, double number);
+
+static uint64_t hashString(const char *string, size_t size);
+
+static bool compileModule(const char *source, size_t sourceSize, const char *moduleName);
+
+static bool loadFunctions(db::NativeModule *module, const char *moduleName, size_t count);
+
+void db::generateSource(FILE *file, const db::Tree *const *trees, size_t count, const db::VarTable *table, int *error)
+{
+  if (!file)
+    ERROR();
+
+  if (!trees && count)
+    ERROR();
+
+  if (!isVarTableValid(table))
+    ERROR();
+
+  fprintf(file, "#include <math.h>\n\n");
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      db::Program program{};
+
+      int errorCode = 0;
+
+      db::compileTree(&program, trees[i], table, &errorCode);
+
+      if (errorCode)
+        ERROR();
+
+      bool isGenerated = generateFunction(file, &program, i);
+
+      db::destroyProgram(&program);
+
+      if (!isGenerated)
+        ERROR();
+    }
+}
+
+void db::loadNativeModule(db::NativeModule *module, const db::Tree *const *trees, size_t count, const db::VarTable *table, int *error)
+{
+  if (!module)
+    ERROR();
+
+  module->handle         = nullptr;
+  module->functions      = nullptr;
+  module->functionsCount = 0;
+
+  char  *source     = nullptr;
+  size_t sourceSize = 0;
+
+  FILE *stream = open_memstream(&source, &sourceSize);
+
+  if (!stream)
+    ERROR();
+
+  int errorCode = 0;
+
+  db::generateSource(stream, trees, count, table, &errorCode);
+
+  fclose(stream);
+
+  if (errorCode)
+    {
+      free(source);
+
+      ERROR();
+    }
+
+  char moduleName[MAX_PATH_SIZE] = "";
+
+  snprintf(moduleName, MAX_PATH_SIZE, "%s%016llx.so",
+           db::NATIVE_DIRECTORY, (unsigned long long)hashString(source, sourceSize));
+
+  bool isLoaded =
+    (isFileExists(moduleName) || compileModule(source, sourceSize, moduleName)) &&
+    loadFunctions(module, moduleName, count);
+
+  free(source);
+
+  if (!isLoaded)
+    {
+      db::destroyNativeModule(module);
+
+      ERROR();
+    }
+}
+
+void db::loadNativeDiff(db::NativeModule *module, const db::Tree *tree, const db::VarTable *table, int *error)
+{
+  if (!module)
+    ERROR();
+
+  if (!tree || !tree->root)
+    ERROR();
+
+  int errorCode = 0;
+
+  db::Tree diffTree = diffExpresion(tree, nullptr, &errorCode);
+
+  if (errorCode)
+    ERROR();
+
+  const db::Tree *trees[] = {tree, &diffTree};
+
+  db::loadNativeModule(module, trees, 2, table, &errorCode);
+
+  db::destroyTree(&diffTree);
+
+  if (errorCode)
+    ERROR();
+}
+
+void db::destroyNativeModule(db::NativeModule *module, int *error)
+{
+  if (!module)
+    ERROR();
+
+  if (module->handle)
+    dlclose(module->handle);
+
+  free(module->functions);
+
+  module->handle         = nullptr;
+  module->functions      = nullptr;
+  module->functionsCount = 0;
+}
+
+void db::executeNative(
+                       const db::NativeModule *module,
+                       db::Context *context,
+                       size_t slot,
+                       const double *values,
+                       double *const *results,
+                       size_t count,
+                       int *error
+                      )
+{
+  if (!module || (!module->functions && module->functionsCount))
+    ERROR();
+
+  if (!context || slot >= context->slotsCount)
+    ERROR();
+
+  if (!count)
+    return;
+
+  if (!values || !results)
+    ERROR();
+
+  for (size_t i = 0; i < module->functionsCount; ++i)
+    if (!results[i])
+      ERROR();
+
+  double origin = context->slots[slot];
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      context->slots[slot] = values[i];
+
+      for (size_t j = 0; j < module->functionsCount; ++j)
+        results[j][i] = module->functions[j](context->slots);
+    }
+
+  context->slots[slot] = origin;
+}
+
+/// Postfix program is written as one constant per instruction,
+/// so long trees don`t give deep nested expressions.
+/// Registers are names of constants, so STORE and LOAD give no code
+static bool generateFunction(FILE *file, const db::Program *program, size_t index)
+{
+  assert(file);
+  assert(program);
+
+  size_t *stack = (size_t *)calloc(program->depth + program->registers, sizeof(size_t));
+
+  if (!stack)
+    return false;
+
+  size_t *registers = stack + program->depth;
+
+  fprintf(file, "double %s%zu(const double *slots)\n{\n", db::NATIVE_FUNCTION_PREFIX, index);
+
+  size_t top = 0;
+
+  for (size_t i = 0; i < program->size; ++i)
+    {
+      const db::Instruction *instruction = &program->code[i];
+
+      if (instruction->opcode == db::OPCODE_STORE)
+        {
+          registers[instruction->argument.index] = stack[top - 1];
+
+          continue;
+        }
+
+      if (instruction->opcode == db::OPCODE_LOAD)
+        {
+          stack[top++] = registers[instruction->argument.index];
+
+          continue;
+        }
+
+      fprintf(file, "  const double t%zu = ", i);
+
+      size_t right = top > 0 ? stack[top - 1] : 0;
+      size_t left  = top > 1 ? stack[top - 2] : 0;
+
+      switch (instruction->opcode)
+        {
+        case db::OPCODE_NUMBER: printNumber(file, instruction->argument.number);         break;
+        case db::OPCODE_SLOT  : fprintf(file, "slots[%zu]", instruction->argument.slot); break;
+        case db::OPCODE_ADD : fprintf(file, "t%zu + t%zu"            , left , right); break;
+        case db::OPCODE_SUB : fprintf(file, "t%zu - t%zu"            , left , right); break;
+        case db::OPCODE_MUL : fprintf(file, "t%zu * t%zu"            , left , right); break;
+        case db::OPCODE_DIV : fprintf(file, "t%zu / t%zu"            , left , right); break;
+        case db::OPCODE_POW : fprintf(file, "pow(t%zu, t%zu)"        , left , right); break;
+        case db::OPCODE_LOG : fprintf(file, "log(t%zu) / log(t%zu)"  , right, left ); break;
+        case db::OPCODE_SQRT: fprintf(file, "sqrt(t%zu)"             , right);        break;
+        case db::OPCODE_SIN : fprintf(file, "sin(t%zu)"              , right);        break;
+        case db::OPCODE_COS : fprintf(file, "cos(t%zu)"              , right);        break;
+        case db::OPCODE_LN  : fprintf(file, "log(t%zu)"              , right);        break;
+        case db::OPCODE_STORE:
+        case db::OPCODE_LOAD:
+        case db::OPCODES_COUNT:
+        default:
+          free(stack);
+          return false;
+        }
+
+      fprintf(file, ";\n");
+
+      switch (instruction->opcode)
+        {
+        case db::OPCODE_NUMBER:
+        case db::OPCODE_SLOT:
+          stack[top++] = i; break;
+        case db::OPCODE_ADD:
+        case db::OPCODE_SUB:
+        case db::OPCODE_MUL:
+        case db::OPCODE_DIV:
+        case db::OPCODE_POW:
+        case db::OPCODE_LOG:
+          stack[--top - 1] = i; break;
+        case db::OPCODE_SQRT:
+        case db::OPCODE_SIN:
+        case db::OPCODE_COS:
+        case db::OPCODE_LN:
+        case db::OPCODE_STORE:
+        case db::OPCODE_LOAD:
+        case db::OPCODES_COUNT:
+        default:
+          stack[top - 1] = i; break;
+        }
+    }
+
+  fprintf(file, "  return t%zu;\n}\n\n", stack[0]);
+
+  free(stack);
+
+  return true;
+}
+
+static void printNumber(FILE *file, double number)
+{
+  assert(file);
+
+  if (isnan(number))
+    fprintf(file, "NAN");
+  else if (isinf(number))
+    fprintf(file, number > 0 ? "INFINITY" : "-INFINITY");
+  else
+    fprintf(file, "%a", number);
+}
+
+/// FNV-1a
+static uint64_t hashString(const char *string, size_t size)
+{
+  assert(string);
+
+  uint64_t hash = FNV_OFFSET;
+
+  for (size_t i = 0; i < size; ++i)
+    {
+      hash ^= (unsigned char)string[i];
+      hash *= FNV_PRIME;
+    }
+
+  for (const char *ptr = db::NATIVE_COMPILE_COMMAND; *ptr; ++ptr)
+    {
+      hash ^= (unsigned char)*ptr;
+      hash *= FNV_PRIME;
+    }
+
+  return hash;
+}
+
+/// Module is compiled to temporary file and renamed,
+/// so other process never loads half-written module
+static bool compileModule(const char *source, size_t sourceSize, const char *moduleName)
+{
+  assert(source);
+  assert(moduleName);
+
+  mkdir(".temp", 0755);
+  mkdir(db::NATIVE_DIRECTORY, 0755);
+
+  char sourceName[MAX_PATH_SIZE] = "";
+  char   tempName[MAX_PATH_SIZE] = "";
+
+  snprintf(sourceName, MAX_PATH_SIZE, "%.*s.c"  , (int)(strlen(moduleName) - 3), moduleName);
+  snprintf(  tempName, MAX_PATH_SIZE, "%s.%ld.tmp", moduleName, (long)getpid());
+
+  FILE *file = fopen(sourceName, "w");
+
+  if (!file)
+    {
+      handleError("Fail to open [%s]!!", sourceName);
+
+      return false;
+    }
+
+  fwrite(source, sizeof(char), sourceSize, file);
+
+  fclose(file);
+
+  char command[MAX_COMMAND_SIZE] = "";
+
+  snprintf(command, MAX_COMMAND_SIZE, db::NATIVE_COMPILE_COMMAND, tempName, sourceName);
+
+  if (system(command))
+    {
+      handleError("Fail to compile [%s]!!", sourceName);
+
+      remove(sourceName);
+      remove(tempName);
+
+      return false;
+    }
+
+  remove(sourceName);
+
+  return !rename(tempName, moduleName);
+}
+
+static bool loadFunctions(db::NativeModule *module, const char *moduleName, size_t count)
+{
+  assert(module);
+  assert(moduleName);
+
+  char *fullName = realpath(moduleName, nullptr);
+
+  if (!fullName)
+    return false;
+
+  module->handle = dlopen(fullName, RTLD_NOW | RTLD_LOCAL);
+
+  free(fullName);
+
+  if (!module->handle)
+    {
+      handleError("Fail to load [%s]: %s", moduleName, dlerror());
+
+      return false;
+    }
+
+  module->functions = (db::nativeFunction_t *)calloc(count, sizeof(db::nativeFunction_t));
+
+  if (!module->functions && count)
+    return false;
+
+  module->functionsCount = count;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      char symbol[MAX_SYMBOL_SIZE] = "";
+
+      snprintf(symbol, MAX_SYMBOL_SIZE, "%s%zu", db::NATIVE_FUNCTION_PREFIX, i);
+
+      module->functions[i] = (db::nativeFunction_t)(uintptr_t)dlsym(module->handle, symbol);
+
+      if (!module->functions[i])
+        return false;
+    }
+
+  return true;
+}
@@ -0,0 +1,746 @@
+#include "ParallelDiff.h"
+#include "DiffRules.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include "Stack.h"
+#include "Assert.h"
+#include "Error.h"
+
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+#pragma GCC diagnostic ignored "-Wcast-qual"
+
+const size_t NO_INDEX = (size_t)-1;
+
+/// Subtrees smaller than threshold / INLINE_PART are differentiated and copied
+/// without tasks, because task costs more than such work
+const size_t INLINE_PART = 16;
+
+/// Nodes of tree in postorder, so children are before parents. Subtree of node i
+/// is [i + 1 - sizes[i], i], its right child is i - 1, its left child is before
+/// subtree of right child. Operands are the same as DAG has
+struct FlatTree {
+  const db::TreeNode **nodes;
+  size_t              *sizes;
+  size_t               size;
+};
+
+enum class TaskType {
+  DIFF,
+  COPY,
+  REMOVE,
+};
+
+struct DiffTask {
+  TaskType            type;
+  const db::TreeNode *node;
+  const char         *variable;
+  size_t              index;  ///< Index of node in flat tree
+  size_t              user;   ///< Index of node which uses result
+  size_t              size;   ///< Size of node, larger tasks are run first
+  db::TreeNode       *result; ///< Derivative or copy of node, node for remove
+};
+
+/// Tasks of one thread, thread takes them from front, others steal them from back
+struct TaskQueue {
+  size_t    *tasks = nullptr;
+  size_t     front = 0;
+  size_t     back  = 0;
+  std::mutex mutex{};
+};
+
+/// Builder of trees for DiffRules.h, shared operands are copied.
+/// Copies which were made by tasks are taken first
+struct TreeDiffer {
+  typedef db::TreeNode *Node;
+
+  static constexpr db::TreeNode *NONE = nullptr;
+
+  const char *variable;
+  DiffTask   *copies;
+  size_t      copiesCount;
+};
+
+/// Node of tree which is differentiated after its children
+struct DiffFrame {
+  const db::TreeNode *node;
+  bool                isVisited;
+};
+
+static bool hasLeft (const db::TreeNode *node);
+static bool hasRight(const db::TreeNode *node);
+
+static bool flattenTree(FlatTree *flat, const db::TreeNode *node);
+
+static void destroyFlatTree(FlatTree *flat);
+
+static db::TreeNode *diffSubtree(TreeDiffer *differ, const db::TreeNode *node);
+
+static db::TreeNode *diffFlatNode(TreeDiffer *differ, const db::TreeNode *node, db::Stack *derivatives);
+
+static size_t addTasks(
+                       const FlatTree *flat,
+                       size_t index,
+                       const char *variable,
+                       size_t threshold,
+                       DiffTask *tasks,
+                       size_t count
+                      );
+
+static void countCopies(db::operator_t operat, size_t *leftCount, size_t *rightCount, size_t *selfCount);
+
+static bool runTasks(DiffTask *tasks, size_t count, unsigned threads);
+
+static void runQueues(std::vector<TaskQueue> *queues, unsigned self, DiffTask *tasks);
+
+static void runTask(DiffTask *task);
+
+static db::TreeNode *number  (TreeDiffer *differ, double value);
+static db::TreeNode *makeNode(TreeDiffer *differ, db::operator_t operat, db::TreeNode *left, db::TreeNode *right);
+
+static bool isNumber(const TreeDiffer *differ, const db::TreeNode *node, double value);
+
+static db::TreeNode *share(TreeDiffer *differ, db::TreeNode *node);
+static void          drop (TreeDiffer *differ, db::TreeNode *node);
+
+db::TreeNode *db::diffParallel(
+                               const db::TreeNode *node,
+                               const char *variable,
+                               unsigned threads,
+                               size_t threshold,
+                               int *error
+                              )
+{
+  if (!node || !variable)
+    ERROR(nullptr);
+
+  if (!threads)
+    threads = std::thread::hardware_concurrency();
+  if (!threads)
+    threads = 1;
+
+  // Node over threshold is operator then
+  if (!threshold)
+    threshold = 1;
+
+  FlatTree flat{};
+
+  if (!flattenTree(&flat, node))
+    ERROR(nullptr);
+
+  TreeDiffer differ = {variable, nullptr, 0};
+
+  if (threads == 1 || flat.size <= threshold)
+    {
+      destroyFlatTree(&flat);
+
+      db::TreeNode *derivative = diffSubtree(&differ, node);
+
+      if (!derivative)
+        ERROR(nullptr);
+
+      return derivative;
+    }
+
+  // Tasks are counted first, so array has size of used tasks only
+  size_t tasksCount = 0;
+
+  for (size_t i = 0; i < flat.size; ++i)
+    if (flat.sizes[i] > threshold)
+      tasksCount = addTasks(&flat, i, variable, threshold, nullptr, tasksCount);
+
+  DiffTask      *tasks       = (DiffTask *)     calloc(tasksCount, sizeof(DiffTask));
+  db::TreeNode **derivatives = (db::TreeNode **)calloc(flat.size,  sizeof(db::TreeNode *));
+
+  bool isFailed = (tasksCount && !tasks) || !derivatives;
+
+  tasksCount = 0;
+
+  for (size_t i = 0; i < flat.size && !isFailed; ++i)
+    if (flat.sizes[i] > threshold)
+      tasksCount = addTasks(&flat, i, variable, threshold, tasks, tasksCount);
+
+  isFailed = isFailed || !runTasks(tasks, tasksCount, threads);
+
+  for (size_t i = 0; i < tasksCount && !isFailed; ++i)
+    if (tasks[i].type == TaskType::DIFF)
+      {
+        derivatives[tasks[i].index] = tasks[i].result;
+        tasks[i].result             = nullptr;
+      }
+
+  // Nodes over threshold are built in postorder, tasks of node are together
+  size_t current = 0;
+
+  for (size_t i = 0; i < flat.size && !isFailed; ++i)
+    {
+      if (flat.sizes[i] <= threshold)
+        continue;
+
+      const db::TreeNode *self = flat.nodes[i];
+
+      size_t rightIndex = hasRight(self) ? i - 1 : NO_INDEX;
+      size_t leftIndex  = hasLeft (self) ? i - 1 - (rightIndex == NO_INDEX ? 0 : flat.sizes[rightIndex]) : NO_INDEX;
+
+      db::TreeNode *childDiffs[2] = {};
+      size_t        children  [2] = {leftIndex, rightIndex};
+
+      for (size_t j = 0; j < 2; ++j)
+        {
+          if (children[j] == NO_INDEX)
+            continue;
+
+          childDiffs[j] = derivatives[children[j]];
+
+          derivatives[children[j]] = nullptr;
+
+          if (!childDiffs[j] && flat.sizes[children[j]] <= threshold)
+            childDiffs[j] = diffSubtree(&differ, flat.nodes[children[j]]);
+
+          isFailed = isFailed || !childDiffs[j];
+        }
+
+      size_t begin = current;
+
+      while (current < tasksCount && tasks[current].user == i)
+        ++current;
+
+      TreeDiffer nodeDiffer = {variable, tasks + begin, current - begin};
+
+      if (!isFailed)
+        derivatives[i] = db::diffOperator(
+                                          &nodeDiffer,
+                                          self->value.operat,
+                                          (db::TreeNode *)self,
+                                          leftIndex  == NO_INDEX ? nullptr : (db::TreeNode *)self->left,
+                                          rightIndex == NO_INDEX ? nullptr : (db::TreeNode *)self->right,
+                                          childDiffs[0],
+                                          childDiffs[1]
+                                         );
+      else
+        {
+          drop(&differ, childDiffs[0]);
+          drop(&differ, childDiffs[1]);
+        }
+
+      isFailed = isFailed || !derivatives[i];
+    }
+
+  db::TreeNode *derivative = isFailed ? nullptr : derivatives[flat.size - 1];
+
+  if (derivatives)
+    derivatives[flat.size - 1] = nullptr;
+
+  // Unused copies and (after failure) derivatives are removed by tasks too
+  size_t removesCount = 0;
+
+  for (size_t i = 0; i < tasksCount; ++i)
+    if (tasks[i].result)
+      tasks[removesCount++] = {TaskType::REMOVE, nullptr, nullptr, 0, 0, 0, tasks[i].result};
+
+  for (size_t i = 0; derivatives && i < flat.size; ++i)
+    if (derivatives[i])
+      drop(&differ, derivatives[i]);
+
+  runTasks(tasks, removesCount, threads);
+
+  for (size_t i = 0; i < removesCount; ++i)
+    drop(&differ, tasks[i].result);
+
+  free(tasks);
+  free(derivatives);
+
+  destroyFlatTree(&flat);
+
+  if (!derivative)
+    ERROR(nullptr);
+
+  return derivative;
+}
+
+static bool hasLeft(const db::TreeNode *node)
+{
+  assert(node);
+
+  return node->type == db::type_t::OPERATOR && node->left && !db::isUnary(node->value.operat);
+}
+
+static bool hasRight(const db::TreeNode *node)
+{
+  assert(node);
+
+  return node->type == db::type_t::OPERATOR && node->right;
+}
+
+static bool flattenTree(FlatTree *flat, const db::TreeNode *node)
+{
+  assert(flat);
+  assert(node);
+
+  db::Stack stack{};
+
+  db::createStack(&stack, sizeof(DiffFrame));
+
+  size_t capacity = 0;
+
+  DiffFrame frame = {node, false};
+
+  bool isFlattened = db::push(&stack, &frame);
+
+  while (isFlattened && db::pop(&stack, &frame))
+    {
+      if (!frame.isVisited && (hasLeft(frame.node) || hasRight(frame.node)))
+        {
+          DiffFrame visited = {frame.node,        true };
+          DiffFrame left    = {frame.node->left , false};
+          DiffFrame right   = {frame.node->right, false};
+
+          isFlattened =
+            db::push(&stack, &visited) &&
+            (!hasRight(frame.node) || db::push(&stack, &right)) &&
+            (!hasLeft (frame.node) || db::push(&stack, &left ));
+
+          continue;
+        }
+
+      if (flat->size == capacity)
+        {
+          capacity = capacity ? 2 * capacity : 1024;
+
+          const db::TreeNode **nodes = (const db::TreeNode **)realloc(flat->nodes, capacity * sizeof(db::TreeNode *));
+          size_t              *sizes = (size_t *)             realloc(flat->sizes, capacity * sizeof(size_t));
+
+          if (nodes) flat->nodes = nodes;
+          if (sizes) flat->sizes = sizes;
+
+          if (!nodes || !sizes)
+            {
+              isFlattened = false;
+
+              break;
+            }
+        }
+
+      size_t index = flat->size++;
+      size_t size  = 1;
+
+      if (hasRight(frame.node))
+        size += flat->sizes[index - 1];
+      if (hasLeft(frame.node))
+        size += flat->sizes[index - size];
+
+      flat->nodes[index] = frame.node;
+      flat->sizes[index] = size;
+    }
+
+  db::destroyStack(&stack);
+
+  if (!isFlattened)
+    destroyFlatTree(flat);
+
+  return isFlattened;
+}
+
+static void destroyFlatTree(FlatTree *flat)
+{
+  assert(flat);
+
+  free(flat->nodes);
+  free(flat->sizes);
+
+  flat->nodes = nullptr;
+  flat->sizes = nullptr;
+  flat->size  = 0;
+}
+
+/// Derivative of subtree by one thread
+static db::TreeNode *diffSubtree(TreeDiffer *differ, const db::TreeNode *node)
+{
+  assert(differ);
+  assert(node);
+
+  db::Stack frames{};
+  db::Stack derivatives{};
+
+  db::createStack(&frames,      sizeof(DiffFrame));
+  db::createStack(&derivatives, sizeof(db::TreeNode *));
+
+  DiffFrame frame = {node, false};
+
+  bool isBuilt = db::push(&frames, &frame);
+
+  while (isBuilt && db::pop(&frames, &frame))
+    {
+      if (!frame.isVisited && (hasLeft(frame.node) || hasRight(frame.node)))
+        {
+          DiffFrame visited = {frame.node,        true };
+          DiffFrame left    = {frame.node->left , false};
+          DiffFrame right   = {frame.node->right, false};
+
+          isBuilt =
+            db::push(&frames, &visited) &&
+            (!hasRight(frame.node) || db::push(&frames, &right)) &&
+            (!hasLeft (frame.node) || db::push(&frames, &left ));
+
+          continue;
+        }
+
+      db::TreeNode *derivative = diffFlatNode(differ, frame.node, &derivatives);
+
+      isBuilt = derivative && db::push(&derivatives, &derivative);
+
+      if (!isBuilt)
+        drop(differ, derivative);
+    }
+
+  db::TreeNode *derivative = nullptr;
+
+  if (isBuilt)
+    db::pop(&derivatives, &derivative);
+
+  db::TreeNode *rest = nullptr;
+
+  while (db::pop(&derivatives, &rest))
+    drop(differ, rest);
+
+  db::destroyStack(&frames);
+  db::destroyStack(&derivatives);
+
+  return derivative;
+}
+
+/// Derivatives of operands of node are on top of derivatives, they are taken
+static db::TreeNode *diffFlatNode(TreeDiffer *differ, const db::TreeNode *node, db::Stack *derivatives)
+{
+  assert(differ);
+  assert(node);
+  assert(derivatives);
+
+  switch (node->type)
+    {
+    case db::type_t::NUMBER:
+      return number(differ, 0);
+    case db::type_t::VARIABLE:
+      return number(differ, strcmp(node->value.variable, differ->variable) ? 0 : 1);
+    case db::type_t::OPERATOR:
+      {
+        db::TreeNode *leftDiff  = nullptr;
+        db::TreeNode *rightDiff = nullptr;
+
+        if (hasRight(node)) db::pop(derivatives, &rightDiff);
+        if (hasLeft (node)) db::pop(derivatives, &leftDiff );
+
+        return db::diffOperator(
+                                differ,
+                                node->value.operat,
+                                (db::TreeNode *)node,
+                                hasLeft (node) ? (db::TreeNode *)node->left  : nullptr,
+                                hasRight(node) ? (db::TreeNode *)node->right : nullptr,
+                                leftDiff,
+                                rightDiff
+                               );
+      }
+    default:
+      return nullptr;
+    }
+}
+
+/// Tasks of node over threshold: derivatives of its children which aren`t
+/// over threshold and copies of operands which its derivative uses.
+/// Tasks are only counted if tasks is nullptr
+/// @return New count of tasks
+static size_t addTasks(
+                       const FlatTree *flat,
+                       size_t index,
+                       const char *variable,
+                       size_t threshold,
+                       DiffTask *tasks,
+                       size_t count
+                      )
+{
+  assert(flat);
+
+  const db::TreeNode *node = flat->nodes[index];
+
+  size_t minSize = threshold / INLINE_PART;
+
+  size_t rightIndex = hasRight(node) ? index - 1 : NO_INDEX;
+  size_t leftIndex  = hasLeft (node) ? index - 1 - (rightIndex == NO_INDEX ? 0 : flat->sizes[rightIndex]) : NO_INDEX;
+
+  size_t children[2] = {leftIndex, rightIndex};
+
+  for (size_t j = 0; j < 2; ++j)
+    if (
+        children[j] != NO_INDEX &&
+        flat->sizes[children[j]] <= threshold &&
+        flat->sizes[children[j]] >= minSize
+       )
+      {
+        if (tasks)
+          tasks[count] = {
+                          TaskType::DIFF,
+                          flat->nodes[children[j]],
+                          variable,
+                          children[j],
+                          index,
+                          flat->sizes[children[j]],
+                          nullptr
+                         };
+
+        ++count;
+      }
+
+  size_t copiesCounts[3] = {};
+
+  countCopies(node->value.operat, &copiesCounts[0], &copiesCounts[1], &copiesCounts[2]);
+
+  size_t origins[3] = {leftIndex, rightIndex, index};
+
+  for (size_t j = 0; j < 3; ++j)
+    if (origins[j] != NO_INDEX && flat->sizes[origins[j]] >= minSize)
+      for (size_t k = 0; k < copiesCounts[j]; ++k)
+        {
+          if (tasks)
+            tasks[count] = {
+                            TaskType::COPY,
+                            flat->nodes[origins[j]],
+                            nullptr,
+                            origins[j],
+                            index,
+                            flat->sizes[origins[j]],
+                            nullptr
+                           };
+
+          ++count;
+        }
+
+  return count;
+}
+
+/// Max count of copies of operands which derivative of operator uses
+static void countCopies(db::operator_t operat, size_t *leftCount, size_t *rightCount, size_t *selfCount)
+{
+  assert(leftCount);
+  assert(rightCount);
+  assert(selfCount);
+
+  *leftCount = *rightCount = *selfCount = 0;
+
+  switch (operat)
+    {
+    case db::OPERATOR_MUL:
+      *leftCount = *rightCount = 1;
+      break;
+    case db::OPERATOR_DIV:
+      *leftCount  = 1;
+      *rightCount = 3;
+      break;
+    case db::OPERATOR_SIN:
+    case db::OPERATOR_COS:
+    case db::OPERATOR_LN:
+      *rightCount = 1;
+      break;
+    case db::OPERATOR_SQRT:
+      *selfCount = 1;
+      break;
+    case db::OPERATOR_POW:
+      *leftCount = *rightCount = 2;
+      *selfCount = 1;
+      break;
+    case db::OPERATOR_LOG:
+      *leftCount = *rightCount = 2;
+      break;
+    case db::OPERATOR_ADD:
+    case db::OPERATOR_SUB:
+    case db::OPERATORS_COUNT:
+    default:
+      break;
+    }
+}
+
+/// Run tasks by threads with work stealing. Larger tasks are dealt first,
+/// every thread runs own queue from the largest task and steals the smallest
+/// tasks of others when its queue is empty. Failed task has nullptr result
+/// @return Were queues allocated
+static bool runTasks(DiffTask *tasks, size_t count, unsigned threads)
+{
+  assert(tasks || !count);
+  assert(threads);
+
+  if (!count)
+    return true;
+
+  if (threads > count)
+    threads = (unsigned)count;
+
+  size_t *order = (size_t *)calloc(count, sizeof(size_t));
+
+  std::vector<TaskQueue> queues(threads);
+
+  bool isAllocated = order;
+
+  for (unsigned i = 0; i < threads; ++i)
+    {
+      queues[i].tasks = (size_t *)calloc(count / threads + 1, sizeof(size_t));
+
+      isAllocated = isAllocated && queues[i].tasks;
+    }
+
+  if (isAllocated)
+    {
+      for (size_t i = 0; i < count; ++i)
+        order[i] = i;
+
+      std::sort(
+                order,
+                order + count,
+                [tasks](size_t first, size_t second)
+                {
+                  if (tasks[first].size != tasks[second].size)
+                    return tasks[first].size > tasks[second].size;
+
+                  return first < second;
+                }
+               );
+
+      for (size_t i = 0; i < count; ++i)
+        queues[i % threads].tasks[queues[i % threads].back++] = order[i];
+
+      std::vector<std::thread> workers{};
+
+      for (unsigned i = 1; i < threads; ++i)
+        workers.emplace_back(runQueues, &queues, i, tasks);
+
+      runQueues(&queues, 0, tasks);
+
+      for (std::thread &thread : workers)
+        thread.join();
+    }
+
+  for (unsigned i = 0; i < threads; ++i)
+    free(queues[i].tasks);
+
+  free(order);
+
+  return isAllocated;
+}
+
+static void runQueues(std::vector<TaskQueue> *queues, unsigned self, DiffTask *tasks)
+{
+  assert(queues);
+  assert(tasks);
+
+  unsigned threads = (unsigned)queues->size();
+
+  while (true)
+    {
+      size_t task = NO_INDEX;
+
+      for (unsigned i = 0; i < threads && task == NO_INDEX; ++i)
+        {
+          TaskQueue *queue = &(*queues)[(self + i) % threads];
+
+          std::lock_guard<std::mutex> lock(queue->mutex);
+
+          if (queue->front < queue->back)
+            task = i ? queue->tasks[--queue->back] : queue->tasks[queue->front++];
+        }
+
+      // Tasks don`t add tasks, so empty queues stay empty
+      if (task == NO_INDEX)
+        return;
+
+      runTask(&tasks[task]);
+    }
+}
+
+static void runTask(DiffTask *task)
+{
+  assert(task);
+
+  switch (task->type)
+    {
+    case TaskType::DIFF:
+      {
+        TreeDiffer differ = {task->variable, nullptr, 0};
+
+        task->result = diffSubtree(&differ, task->node);
+        break;
+      }
+    case TaskType::COPY:
+      task->result = db::createNode(task->node);
+      break;
+    case TaskType::REMOVE:
+      db::removeNode(task->result);
+      task->result = nullptr;
+      break;
+    default:
+      break;
+    }
+}
+
+static db::TreeNode *number(TreeDiffer *differ, double value)
+{
+  assert(differ);
+
+  return db::createNode({.number = value}, db::type_t::NUMBER);
+}
+
+static db::TreeNode *makeNode(TreeDiffer *differ, db::operator_t operat, db::TreeNode *left, db::TreeNode *right)
+{
+  assert(differ);
+
+  db::TreeNode *node = db::createNode({.operat = operat}, db::type_t::OPERATOR, left, right);
+
+  if (!node)
+    {
+      drop(differ, left);
+      drop(differ, right);
+    }
+
+  return node;
+}
+
+static bool isNumber(const TreeDiffer *differ, const db::TreeNode *node, double value)
+{
+  assert(differ);
+
+  return node && node->type == db::type_t::NUMBER && node->value.number == value;
+}
+
+/// Copy which task made or new copy
+static db::TreeNode *share(TreeDiffer *differ, db::TreeNode *node)
+{
+  assert(differ);
+
+  if (!node)
+    return nullptr;
+
+  for (size_t i = 0; i < differ->copiesCount; ++i)
+    if (
+        differ->copies[i].type == TaskType::COPY &&
+        differ->copies[i].node == node &&
+        differ->copies[i].result
+       )
+      {
+        db::TreeNode *copy = differ->copies[i].result;
+
+        differ->copies[i].result = nullptr;
+
+        return copy;
+      }
+
+  return db::createNode((const db::TreeNode *)node);
+}
+
+static void drop(TreeDiffer *differ, db::TreeNode *node)
+{
+  assert(differ);
+
+  if (node)
+    db::removeNode(node);
+}
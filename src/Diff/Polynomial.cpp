@@ -0,0 +1,1052 @@
+#include "Polynomial.h"
+#include "Dag.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "Stack.h"
+#include "SystemLike.h"
+#include "Assert.h"
+#include "Error.h"
+
+const int DEFAULT_GROWTH_FACTOR = 2;
+
+const size_t DEFAULT_BUCKETS_COUNT = 4;
+
+/// Sum of like terms which is small relative to them is a residue of rounding
+const double CANCELLATION_ERROR = 1e-12;
+
+/// Node of tree which is collected after its children
+struct CollectFrame {
+  const db::TreeNode *node;
+  bool                isVisited;
+};
+
+/// Collected subtree, node is its form in Dag before expansion.
+/// Atom isn`t polynomial, its polynomial is atom itself
+struct CollectItem {
+  db::Polynomial polynomial;
+  size_t         node;
+  bool           isAtom;
+};
+
+/// Dag of atoms and built sums, sizes are counts of nodes of Dag nodes as trees
+struct Collector {
+  db::Dag dag;
+  size_t *sizes;
+  size_t  sizesCapacity;
+};
+
+static bool isZero(db::number_t number);
+
+static db::number_t addCoefficients(db::number_t first, db::number_t second);
+
+static uint64_t hashFactors(const db::Factor *factors, size_t count);
+
+static size_t findTerm(const db::Polynomial *polynomial, const db::Factor *factors, size_t count, uint64_t hash);
+
+static bool growTerms(db::Polynomial *polynomial);
+
+static bool growFactors(db::Polynomial *polynomial, size_t count);
+
+static bool rehash(db::Polynomial *polynomial, size_t bucketsCount);
+
+static void movePolynomial(db::Polynomial *target, db::Polynomial *source);
+
+static size_t addNode(Collector *collector, db::type_t type, db::treeValue_t value, size_t left, size_t right);
+
+static bool collectNode(Collector *collector, const db::TreeNode *node, CollectItem *left, CollectItem *right, CollectItem *item);
+
+static bool makeAtom(CollectItem *item);
+
+static bool combine(db::operator_t operat, CollectItem *left, CollectItem *right, db::Polynomial *result);
+
+static bool isCancelling(const db::Polynomial *first, const db::Polynomial *second);
+
+static bool getConstant(const db::Polynomial *polynomial, db::number_t *value);
+
+static bool invertMonomial(const db::Polynomial *polynomial, db::Polynomial *inverse);
+
+static bool raisePolynomial(const db::Polynomial *base, long power, db::Polynomial *result);
+
+static size_t materialize(Collector *collector, const CollectItem *item);
+
+static size_t buildPolynomial(Collector *collector, const db::Polynomial *polynomial);
+
+static size_t buildMonomial(Collector *collector, const db::Polynomial *polynomial, const db::Monomial *term, db::number_t coefficient);
+
+static bool buildProduct(Collector *collector, const db::Factor *factors, size_t count, long sign, size_t *product);
+
+void db::createPolynomial(db::Polynomial *polynomial, int *error)
+{
+  if (!polynomial)
+    ERROR();
+
+  polynomial->terms           = nullptr;
+  polynomial->termsCapacity   = 0;
+  polynomial->termsCount      = 0;
+  polynomial->factors         = nullptr;
+  polynomial->factorsCapacity = 0;
+  polynomial->factorsCount    = 0;
+  polynomial->buckets         = nullptr;
+  polynomial->bucketsCount    = 0;
+
+  if (!rehash(polynomial, DEFAULT_BUCKETS_COUNT))
+    ERROR();
+}
+
+void db::destroyPolynomial(db::Polynomial *polynomial, int *error)
+{
+  if (!polynomial)
+    ERROR();
+
+  free(polynomial->terms);
+  free(polynomial->factors);
+  free(polynomial->buckets);
+
+  polynomial->terms           = nullptr;
+  polynomial->termsCapacity   = 0;
+  polynomial->termsCount      = 0;
+  polynomial->factors         = nullptr;
+  polynomial->factorsCapacity = 0;
+  polynomial->factorsCount    = 0;
+  polynomial->buckets         = nullptr;
+  polynomial->bucketsCount    = 0;
+}
+
+void db::addMonomial(
+                     db::Polynomial *polynomial,
+                     db::number_t coefficient,
+                     const db::Factor *factors,
+                     size_t count,
+                     int *error
+                    )
+{
+  if (!polynomial || !polynomial->buckets || (count && !factors))
+    ERROR();
+
+  uint64_t hash = hashFactors(factors, count);
+  size_t   term = findTerm(polynomial, factors, count, hash);
+
+  if (term != db::NO_TERM)
+    {
+      polynomial->terms[term].coefficient = addCoefficients(polynomial->terms[term].coefficient, coefficient);
+
+      return;
+    }
+
+  if (isZero(coefficient))
+    return;
+
+  if (polynomial->termsCount >= polynomial->bucketsCount &&
+      !rehash(polynomial, polynomial->bucketsCount * DEFAULT_GROWTH_FACTOR))
+    ERROR();
+
+  if (polynomial->termsCount == polynomial->termsCapacity && !growTerms(polynomial))
+    ERROR();
+
+  if (!growFactors(polynomial, count))
+    ERROR();
+
+  if (count)
+    memcpy(&polynomial->factors[polynomial->factorsCount], factors, count * sizeof(db::Factor));
+
+  size_t bucket = hash % polynomial->bucketsCount;
+
+  polynomial->terms[polynomial->termsCount] =
+    {coefficient, polynomial->factorsCount, count, polynomial->buckets[bucket]};
+
+  polynomial->buckets[bucket] = polynomial->termsCount++;
+  polynomial->factorsCount   += count;
+}
+
+void db::addPolynomial(db::Polynomial *polynomial, const db::Polynomial *addend, db::number_t scale, int *error)
+{
+  if (!polynomial || !addend || polynomial == addend)
+    ERROR();
+
+  int errorCode = 0;
+
+  for (size_t i = 0; i < addend->termsCount && !errorCode; ++i)
+    {
+      const db::Monomial *term = &addend->terms[i];
+
+      db::addMonomial(
+                      polynomial,
+                      scale * term->coefficient,
+                      &addend->factors[term->factors],
+                      term->factorsCount,
+                      &errorCode
+                     );
+    }
+
+  if (errorCode)
+    ERROR();
+}
+
+bool db::multiplyPolynomials(
+                             db::Polynomial *polynomial,
+                             const db::Polynomial *first,
+                             const db::Polynomial *second,
+                             int *error
+                            )
+{
+  if (!polynomial || !first || !second || polynomial == first || polynomial == second)
+    ERROR(false);
+
+  size_t firstMax  = 0;
+  size_t secondMax = 0;
+
+  for (size_t i = 0; i < first ->termsCount; ++i)
+    if (first ->terms[i].factorsCount > firstMax ) firstMax  = first ->terms[i].factorsCount;
+
+  for (size_t i = 0; i < second->termsCount; ++i)
+    if (second->terms[i].factorsCount > secondMax) secondMax = second->terms[i].factorsCount;
+
+  db::Factor *product = (db::Factor *)calloc(firstMax + secondMax + 1, sizeof(db::Factor));
+
+  if (!product)
+    ERROR(false);
+
+  bool isFit     = true;
+  int  errorCode = 0;
+
+  for (size_t i = 0; i < first->termsCount && !errorCode; ++i)
+    for (size_t j = 0; j < second->termsCount && !errorCode; ++j)
+      {
+        const db::Monomial *left  = &first ->terms[i];
+        const db::Monomial *right = &second->terms[j];
+
+        if (isZero(left->coefficient) || isZero(right->coefficient))
+          continue;
+
+        const db::Factor *leftFactors  = &first ->factors[left ->factors];
+        const db::Factor *rightFactors = &second->factors[right->factors];
+
+        size_t count = 0;
+        size_t l     = 0;
+        size_t r     = 0;
+
+        // Factors are sorted by atom, so they are merged
+        while (l < left->factorsCount || r < right->factorsCount)
+          {
+            db::Factor factor{};
+
+            if (r == right->factorsCount || (l < left->factorsCount && leftFactors[l].atom < rightFactors[r].atom))
+              factor = leftFactors[l++];
+            else if (l == left->factorsCount || rightFactors[r].atom < leftFactors[l].atom)
+              factor = rightFactors[r++];
+            else
+              {
+                factor        = leftFactors[l++];
+                factor.power += rightFactors[r++].power;
+              }
+
+            if (factor.power)
+              product[count++] = factor;
+
+            isFit = isFit && labs(factor.power) <= db::MAX_FACTOR_POWER;
+          }
+
+        if (isFit)
+          db::addMonomial(polynomial, left->coefficient * right->coefficient, product, count, &errorCode);
+      }
+
+  free(product);
+
+  if (errorCode)
+    ERROR(false);
+
+  return isFit;
+}
+
+size_t db::countTerms(const db::Polynomial *polynomial, int *error)
+{
+  if (!polynomial)
+    ERROR(0);
+
+  size_t count = 0;
+
+  for (size_t i = 0; i < polynomial->termsCount; ++i)
+    count += !isZero(polynomial->terms[i].coefficient);
+
+  return count;
+}
+
+db::TreeNode *db::collectTerms(const db::TreeNode *node, int *error)
+{
+  if (!node)
+    ERROR(nullptr);
+
+  Collector collector{};
+
+  int errorCode = 0;
+
+  db::createDag(&collector.dag, &errorCode);
+
+  if (errorCode)
+    ERROR(nullptr);
+
+  db::Stack frames{};
+  db::Stack items {};
+
+  db::createStack(&frames, sizeof(CollectFrame));
+  db::createStack(&items , sizeof(CollectItem ));
+
+  CollectFrame frame = {node, false};
+
+  bool isCollected = db::push(&frames, &frame);
+
+  while (isCollected && db::pop(&frames, &frame))
+    {
+      const db::TreeNode *current = frame.node;
+
+      bool isOperator = current->type == db::type_t::OPERATOR;
+      bool hasLeft    = isOperator && current->left && !db::isUnary(current->value.operat);
+      bool hasRight   = isOperator && current->right;
+
+      if (!frame.isVisited && (hasLeft || hasRight))
+        {
+          CollectFrame visited = {current       , true };
+          CollectFrame right   = {current->right, false};
+          CollectFrame left    = {current->left , false};
+
+          isCollected =
+            db::push(&frames, &visited) &&
+            (!hasRight || db::push(&frames, &right)) &&
+            (!hasLeft  || db::push(&frames, &left ));
+
+          continue;
+        }
+
+      CollectItem left {};
+      CollectItem right{};
+      CollectItem item {};
+
+      if (hasRight) db::pop(&items, &right);
+      if (hasLeft ) db::pop(&items, &left );
+
+      isCollected = collectNode(&collector, current, hasLeft ? &left : nullptr, hasRight ? &right : nullptr, &item);
+
+      db::destroyPolynomial(&left .polynomial);
+      db::destroyPolynomial(&right.polynomial);
+
+      if (isCollected && !db::push(&items, &item))
+        {
+          db::destroyPolynomial(&item.polynomial);
+
+          isCollected = false;
+        }
+    }
+
+  db::TreeNode *root = nullptr;
+
+  CollectItem item{};
+
+  if (isCollected && db::pop(&items, &item))
+    {
+      size_t collected = materialize(&collector, &item);
+
+      if (collected != db::NO_NODE)
+        root = db::expandDag(&collector.dag, collected);
+
+      db::destroyPolynomial(&item.polynomial);
+    }
+
+  while (db::pop(&items, &item))
+    db::destroyPolynomial(&item.polynomial);
+
+  db::destroyStack(&frames);
+  db::destroyStack(&items );
+
+  db::destroyDag(&collector.dag);
+
+  free(collector.sizes);
+
+  if (!root)
+    ERROR(nullptr);
+
+  return root;
+}
+
+/// Only cancelled terms are zero, small coefficients (like of series) stay
+static bool isZero(db::number_t number)
+{
+  return fpclassify(number) == FP_ZERO;
+}
+
+/// Residue of cancellation of like terms is zero, so it doesn`t become term
+static db::number_t addCoefficients(db::number_t first, db::number_t second)
+{
+  db::number_t sum = first + second;
+
+  if (fabs(sum) <= CANCELLATION_ERROR * fmax(fabs(first), fabs(second)))
+    return 0;
+
+  return sum;
+}
+
+static inline uint64_t mix(uint64_t hash, uint64_t value)
+{
+  hash ^= value + 0x9E3779B97F4A7C15 + (hash << 6) + (hash >> 2);
+
+  return hash;
+}
+
+static uint64_t hashFactors(const db::Factor *factors, size_t count)
+{
+  uint64_t hash = count;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      hash = mix(hash, factors[i].atom);
+      hash = mix(hash, (uint64_t)factors[i].power);
+    }
+
+  return hash;
+}
+
+/// @return Index of term with the same factors or NO_TERM
+static size_t findTerm(const db::Polynomial *polynomial, const db::Factor *factors, size_t count, uint64_t hash)
+{
+  assert(polynomial);
+
+  for (
+       size_t index = polynomial->buckets[hash % polynomial->bucketsCount];
+       index != db::NO_TERM;
+       index = polynomial->terms[index].next
+      )
+    {
+      const db::Monomial *term = &polynomial->terms[index];
+
+      if (term->factorsCount != count)
+        continue;
+
+      const db::Factor *termFactors = &polynomial->factors[term->factors];
+
+      bool isEqual = true;
+
+      for (size_t i = 0; i < count && isEqual; ++i)
+        isEqual = termFactors[i].atom == factors[i].atom && termFactors[i].power == factors[i].power;
+
+      if (isEqual)
+        return index;
+    }
+
+  return db::NO_TERM;
+}
+
+static bool growTerms(db::Polynomial *polynomial)
+{
+  assert(polynomial);
+
+  db::Monomial *temp =
+    (db::Monomial *)recalloc(
+                             polynomial->terms,
+                             (polynomial->termsCapacity + 1)*DEFAULT_GROWTH_FACTOR,
+                             sizeof(db::Monomial)
+                            );
+  if (!temp)
+    return false;
+
+  polynomial->terms = temp;
+
+  ++polynomial->termsCapacity;
+  polynomial->termsCapacity *= DEFAULT_GROWTH_FACTOR;
+
+  return true;
+}
+
+/// Capacity of factors is grown until count more factors fit
+static bool growFactors(db::Polynomial *polynomial, size_t count)
+{
+  assert(polynomial);
+
+  while (polynomial->factorsCount + count > polynomial->factorsCapacity)
+    {
+      db::Factor *temp =
+        (db::Factor *)recalloc(
+                               polynomial->factors,
+                               (polynomial->factorsCapacity + 1)*DEFAULT_GROWTH_FACTOR,
+                               sizeof(db::Factor)
+                              );
+      if (!temp)
+        return false;
+
+      polynomial->factors = temp;
+
+      ++polynomial->factorsCapacity;
+      polynomial->factorsCapacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  return true;
+}
+
+static bool rehash(db::Polynomial *polynomial, size_t bucketsCount)
+{
+  assert(polynomial);
+  assert(bucketsCount);
+
+  size_t *buckets = (size_t *)calloc(bucketsCount, sizeof(size_t));
+
+  if (!buckets)
+    return false;
+
+  for (size_t i = 0; i < bucketsCount; ++i)
+    buckets[i] = db::NO_TERM;
+
+  for (size_t i = 0; i < polynomial->termsCount; ++i)
+    {
+      db::Monomial *term = &polynomial->terms[i];
+
+      size_t bucket = hashFactors(&polynomial->factors[term->factors], term->factorsCount) % bucketsCount;
+
+      term->next = buckets[bucket];
+      buckets[bucket] = i;
+    }
+
+  free(polynomial->buckets);
+
+  polynomial->buckets      = buckets;
+  polynomial->bucketsCount = bucketsCount;
+
+  return true;
+}
+
+/// Polynomial is moved without copying its arrays, source becomes empty
+static void movePolynomial(db::Polynomial *target, db::Polynomial *source)
+{
+  assert(target);
+  assert(source);
+
+  target->terms           = source->terms;
+  target->termsCapacity   = source->termsCapacity;
+  target->termsCount      = source->termsCount;
+  target->factors         = source->factors;
+  target->factorsCapacity = source->factorsCapacity;
+  target->factorsCount    = source->factorsCount;
+  target->buckets         = source->buckets;
+  target->bucketsCount    = source->bucketsCount;
+
+  source->terms           = nullptr;
+  source->termsCapacity   = 0;
+  source->termsCount      = 0;
+  source->factors         = nullptr;
+  source->factorsCapacity = 0;
+  source->factorsCount    = 0;
+  source->buckets         = nullptr;
+  source->bucketsCount    = 0;
+}
+
+/// Add node to Dag and remember its size as tree
+/// @return Index of node or NO_NODE
+static size_t addNode(Collector *collector, db::type_t type, db::treeValue_t value, size_t left, size_t right)
+{
+  assert(collector);
+
+  size_t count = collector->dag.size;
+  size_t index = db::addDagNode(&collector->dag, type, value, left, right);
+
+  if (index == db::NO_NODE || index < count)
+    return index;
+
+  if (index >= collector->sizesCapacity)
+    {
+      size_t *temp =
+        (size_t *)recalloc(
+                           collector->sizes,
+                           (collector->sizesCapacity + 1)*DEFAULT_GROWTH_FACTOR,
+                           sizeof(size_t)
+                          );
+      if (!temp)
+        return db::NO_NODE;
+
+      collector->sizes = temp;
+
+      ++collector->sizesCapacity;
+      collector->sizesCapacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  const db::DagNode *node = &collector->dag.nodes[index];
+
+  collector->sizes[index] =
+    1 +
+    (node->left  == db::NO_NODE ? 0 : collector->sizes[node->left ]) +
+    (node->right == db::NO_NODE ? 0 : collector->sizes[node->right]);
+
+  return index;
+}
+
+/// Polynomial of node by polynomials of children. Node which isn`t
+/// polynomial is atom, its children are replaced by their sums if
+/// sums are smaller, so they are collected inside of atom
+static bool collectNode(Collector *collector, const db::TreeNode *node, CollectItem *left, CollectItem *right, CollectItem *item)
+{
+  assert(collector);
+  assert(node);
+  assert(item);
+
+  size_t leftNode  = left  ? left ->node : db::NO_NODE;
+  size_t rightNode = right ? right->node : db::NO_NODE;
+
+  item->node = addNode(collector, node->type, node->value, leftNode, rightNode);
+
+  if (item->node == db::NO_NODE)
+    return false;
+
+  switch (node->type)
+    {
+    case db::type_t::NUMBER:
+      {
+        if (!isfinite(node->value.number))
+          return makeAtom(item);
+
+        int errorCode = 0;
+
+        db::createPolynomial(&item->polynomial, &errorCode);
+        db::addMonomial(&item->polynomial, node->value.number, nullptr, 0, &errorCode);
+
+        return !errorCode;
+      }
+    case db::type_t::VARIABLE:
+      return makeAtom(item);
+    case db::type_t::OPERATOR:
+      {
+        if (combine(node->value.operat, left, right, &item->polynomial))
+          return true;
+
+        if (left  && (leftNode  = materialize(collector, left )) == db::NO_NODE)
+          return false;
+
+        if (right && (rightNode = materialize(collector, right)) == db::NO_NODE)
+          return false;
+
+        item->node = addNode(collector, node->type, node->value, leftNode, rightNode);
+
+        return item->node != db::NO_NODE && makeAtom(item);
+      }
+    default:
+      return false;
+    }
+}
+
+/// Polynomial of item is item itself
+static bool makeAtom(CollectItem *item)
+{
+  assert(item);
+
+  db::Factor factor = {item->node, 1};
+
+  int errorCode = 0;
+
+  db::createPolynomial(&item->polynomial, &errorCode);
+  db::addMonomial(&item->polynomial, 1, &factor, 1, &errorCode);
+
+  item->isAtom = true;
+
+  return !errorCode;
+}
+
+/// Polynomial of operator over polynomials of operands. Polynomial of
+/// left operand of sum may be moved to result, so it isn`t copied
+/// @return Is operator polynomial, result must be destroyed only if it is
+static bool combine(db::operator_t operat, CollectItem *left, CollectItem *right, db::Polynomial *result)
+{
+  assert(result);
+
+  if (!right || (!left && !db::isUnary(operat)))
+    return false;
+
+  db::Polynomial *first  = left ? &left->polynomial : nullptr;
+  db::Polynomial *second = &right->polynomial;
+
+  int  errorCode = 0;
+  bool isFit     = true;
+
+  switch (operat)
+    {
+    case db::OPERATOR_ADD:
+    case db::OPERATOR_SUB:
+      {
+        db::number_t scale = operat == db::OPERATOR_ADD ? 1 : -1;
+
+        if (first->termsCount + second->termsCount <= db::MAX_POLYNOMIAL_TERMS)
+          movePolynomial(result, first);
+        else
+          {
+            db::createPolynomial(result, &errorCode);
+            db::addPolynomial(result, first, 1, &errorCode);
+          }
+
+        db::addPolynomial(result, second, scale, &errorCode);
+
+        break;
+      }
+    case db::OPERATOR_MUL:
+      {
+        if (isCancelling(first, second))
+          return false;
+
+        db::createPolynomial(result, &errorCode);
+
+        isFit = db::multiplyPolynomials(result, first, second, &errorCode);
+
+        break;
+      }
+    case db::OPERATOR_DIV:
+      {
+        db::Polynomial inverse{};
+
+        if (!invertMonomial(second, &inverse))
+          return false;
+
+        if (isCancelling(first, &inverse))
+          {
+            db::destroyPolynomial(&inverse);
+
+            return false;
+          }
+
+        db::createPolynomial(result, &errorCode);
+
+        isFit = db::multiplyPolynomials(result, first, &inverse, &errorCode);
+
+        db::destroyPolynomial(&inverse);
+
+        break;
+      }
+    case db::OPERATOR_POW:
+      {
+        db::number_t power = 0;
+
+        if (
+            !getConstant(second, &power) ||
+            !db::compareNumber(power, round(power)) ||
+            fabs(power) > db::MAX_EXPANDED_POWER
+           )
+          return false;
+
+        return raisePolynomial(first, lround(power), result);
+      }
+    case db::OPERATOR_SQRT:
+    case db::OPERATOR_SIN:
+    case db::OPERATOR_COS:
+    case db::OPERATOR_LOG:
+    case db::OPERATOR_LN:
+    case db::OPERATORS_COUNT:
+    default:
+      return false;
+    }
+
+  if (!errorCode && isFit && result->termsCount <= db::MAX_POLYNOMIAL_TERMS)
+    return true;
+
+  db::destroyPolynomial(result);
+
+  return false;
+}
+
+/// Some atom has positive power in one term and negative in other, so
+/// product cancels it. x / x isn`t 1 where x is zero or undefined, so such
+/// product stays division
+static bool isCancelling(const db::Polynomial *first, const db::Polynomial *second)
+{
+  assert(first);
+  assert(second);
+
+  for (size_t i = 0; i < first->termsCount; ++i)
+    for (size_t j = 0; j < second->termsCount; ++j)
+      {
+        const db::Monomial *left  = &first ->terms[i];
+        const db::Monomial *right = &second->terms[j];
+
+        if (isZero(left->coefficient) || isZero(right->coefficient))
+          continue;
+
+        const db::Factor *leftFactors  = &first ->factors[left ->factors];
+        const db::Factor *rightFactors = &second->factors[right->factors];
+
+        size_t l = 0;
+        size_t r = 0;
+
+        // Factors are sorted by atom, so they are merged
+        while (l < left->factorsCount && r < right->factorsCount)
+          if (leftFactors[l].atom < rightFactors[r].atom)
+            ++l;
+          else if (rightFactors[r].atom < leftFactors[l].atom)
+            ++r;
+          else if ((leftFactors[l++].power < 0) != (rightFactors[r++].power < 0))
+            return true;
+      }
+
+  return false;
+}
+
+/// Value of polynomial without atoms
+static bool getConstant(const db::Polynomial *polynomial, db::number_t *value)
+{
+  assert(polynomial);
+  assert(value);
+
+  *value = 0;
+
+  for (size_t i = 0; i < polynomial->termsCount; ++i)
+    {
+      const db::Monomial *term = &polynomial->terms[i];
+
+      if (isZero(term->coefficient))
+        continue;
+
+      if (term->factorsCount)
+        return false;
+
+      *value = term->coefficient;
+    }
+
+  return true;
+}
+
+/// Inverse of polynomial which is one monomial, powers are negated
+/// @return Is polynomial monomial, inverse must be destroyed only if it is
+static bool invertMonomial(const db::Polynomial *polynomial, db::Polynomial *inverse)
+{
+  assert(polynomial);
+  assert(inverse);
+
+  if (db::countTerms(polynomial) != 1)
+    return false;
+
+  const db::Monomial *term = polynomial->terms;
+
+  while (isZero(term->coefficient))
+    ++term;
+
+  db::Factor *factors = (db::Factor *)calloc(term->factorsCount + 1, sizeof(db::Factor));
+
+  if (!factors)
+    return false;
+
+  for (size_t i = 0; i < term->factorsCount; ++i)
+    factors[i] = {polynomial->factors[term->factors + i].atom, -polynomial->factors[term->factors + i].power};
+
+  int errorCode = 0;
+
+  db::createPolynomial(inverse, &errorCode);
+  db::addMonomial(inverse, 1 / term->coefficient, factors, term->factorsCount, &errorCode);
+
+  free(factors);
+
+  if (errorCode)
+    {
+      db::destroyPolynomial(inverse);
+
+      return false;
+    }
+
+  return true;
+}
+
+/// Integer power of polynomial, negative power only of monomial
+/// @return Was power expanded, result must be destroyed only if it was
+static bool raisePolynomial(const db::Polynomial *base, long power, db::Polynomial *result)
+{
+  assert(base);
+  assert(result);
+
+  // (x + 1 / x) ^ 2 cancels x like product does
+  if (power > 1 && isCancelling(base, base))
+    return false;
+
+  db::Polynomial factor{};
+
+  int errorCode = 0;
+
+  if (power < 0)
+    {
+      if (!invertMonomial(base, &factor))
+        return false;
+
+      power = -power;
+    }
+  else
+    {
+      db::createPolynomial(&factor, &errorCode);
+      db::addPolynomial(&factor, base, 1, &errorCode);
+    }
+
+  db::createPolynomial(result, &errorCode);
+  db::addMonomial(result, 1, nullptr, 0, &errorCode);
+
+  bool isFit = true;
+
+  for (long i = 0; i < power && !errorCode && isFit; ++i)
+    {
+      db::Polynomial product{};
+
+      db::createPolynomial(&product, &errorCode);
+
+      isFit = db::multiplyPolynomials(&product, result, &factor, &errorCode) &&
+        product.termsCount <= db::MAX_POLYNOMIAL_TERMS;
+
+      db::destroyPolynomial(result);
+
+      movePolynomial(result, &product);
+    }
+
+  db::destroyPolynomial(&factor);
+
+  if (!errorCode && isFit)
+    return true;
+
+  db::destroyPolynomial(result);
+
+  return false;
+}
+
+/// Node of item as region of polynomial: sum of monomials if it
+/// is smaller than item before expansion, else item itself
+/// @return Index of node or NO_NODE
+static size_t materialize(Collector *collector, const CollectItem *item)
+{
+  assert(collector);
+  assert(item);
+
+  if (item->isAtom)
+    return item->node;
+
+  size_t sum = buildPolynomial(collector, &item->polynomial);
+
+  if (sum == db::NO_NODE)
+    return db::NO_NODE;
+
+  return collector->sizes[sum] < collector->sizes[item->node] ? sum : item->node;
+}
+
+/// Sum of monomials in order of their addition, but the first
+/// positive one goes first, so others are added or subtracted
+/// @return Index of node or NO_NODE
+static size_t buildPolynomial(Collector *collector, const db::Polynomial *polynomial)
+{
+  assert(collector);
+  assert(polynomial);
+
+  size_t first = db::NO_TERM;
+
+  for (size_t i = 0; i < polynomial->termsCount && first == db::NO_TERM; ++i)
+    if (!isZero(polynomial->terms[i].coefficient) && polynomial->terms[i].coefficient > 0)
+      first = i;
+
+  for (size_t i = 0; i < polynomial->termsCount && first == db::NO_TERM; ++i)
+    if (!isZero(polynomial->terms[i].coefficient))
+      first = i;
+
+  if (first == db::NO_TERM)
+    return addNode(collector, db::type_t::NUMBER, {.number = 0}, db::NO_NODE, db::NO_NODE);
+
+  const db::Monomial *firstTerm = &polynomial->terms[first];
+
+  size_t sum = buildMonomial(collector, polynomial, firstTerm, firstTerm->coefficient);
+
+  for (size_t i = 0; i < polynomial->termsCount && sum != db::NO_NODE; ++i)
+    {
+      const db::Monomial *term = &polynomial->terms[i];
+
+      if (i == first || isZero(term->coefficient))
+        continue;
+
+      size_t monomial = buildMonomial(collector, polynomial, term, fabs(term->coefficient));
+
+      db::operator_t operat = term->coefficient > 0 ? db::OPERATOR_ADD : db::OPERATOR_SUB;
+
+      sum = monomial == db::NO_NODE ?
+        db::NO_NODE :
+        addNode(collector, db::type_t::OPERATOR, {.operat = operat}, sum, monomial);
+    }
+
+  return sum;
+}
+
+/// coefficient * numerator / denominator, where numerator has positive
+/// powers and denominator has negative ones, coefficient 1 is omitted
+/// @return Index of node or NO_NODE
+static size_t buildMonomial(
+                            Collector *collector,
+                            const db::Polynomial *polynomial,
+                            const db::Monomial *term,
+                            db::number_t coefficient
+                           )
+{
+  assert(collector);
+  assert(polynomial);
+  assert(term);
+
+  const db::Factor *factors = &polynomial->factors[term->factors];
+
+  size_t numerator   = db::NO_NODE;
+  size_t denominator = db::NO_NODE;
+
+  if (
+      !buildProduct(collector, factors, term->factorsCount,  1, &numerator  ) ||
+      !buildProduct(collector, factors, term->factorsCount, -1, &denominator)
+     )
+    return db::NO_NODE;
+
+  if (numerator == db::NO_NODE || !db::compareNumber(coefficient, 1))
+    {
+      size_t number = addNode(collector, db::type_t::NUMBER, {.number = coefficient}, db::NO_NODE, db::NO_NODE);
+
+      if (number == db::NO_NODE)
+        return db::NO_NODE;
+
+      numerator = numerator == db::NO_NODE ?
+        number :
+        addNode(collector, db::type_t::OPERATOR, {.operat = db::OPERATOR_MUL}, number, numerator);
+    }
+
+  if (denominator == db::NO_NODE || numerator == db::NO_NODE)
+    return numerator;
+
+  return addNode(collector, db::type_t::OPERATOR, {.operat = db::OPERATOR_DIV}, numerator, denominator);
+}
+
+/// Product of factors whose powers have sign, powers are taken by absolute values
+/// @param [out] product Index of node or NO_NODE if there are no such factors
+/// @return Was product built
+static bool buildProduct(Collector *collector, const db::Factor *factors, size_t count, long sign, size_t *product)
+{
+  assert(collector);
+  assert(product);
+
+  *product = db::NO_NODE;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      if ((factors[i].power > 0) != (sign > 0))
+        continue;
+
+      size_t factor = factors[i].atom;
+      long   power  = labs(factors[i].power);
+
+      if (power != 1)
+        {
+          size_t exponent = addNode(collector, db::type_t::NUMBER, {.number = (db::number_t)power}, db::NO_NODE, db::NO_NODE);
+
+          factor = exponent == db::NO_NODE ?
+            db::NO_NODE :
+            addNode(collector, db::type_t::OPERATOR, {.operat = db::OPERATOR_POW}, factor, exponent);
+        }
+
+      if (factor == db::NO_NODE)
+        return false;
+
+      *product = *product == db::NO_NODE ?
+        factor :
+        addNode(collector, db::type_t::OPERATOR, {.operat = db::OPERATOR_MUL}, *product, factor);
+
+      if (*product == db::NO_NODE)
+        return false;
+    }
+
+  return true;
+}
@@ -0,0 +1,597 @@
+#include "Program.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include "SystemLike.h"
+#include "Stack.h"
+#include "Assert.h"
+#include "Error.h"
+
+const int DEFAULT_GROWTH_FACTOR = 2;
+
+const size_t MAX_LOCAL_DEPTH = 128;
+
+const size_t MAX_LOCAL_SLOTS = 64;
+
+static bool emitInstruction(db::Program *program, db::Instruction instruction);
+
+static bool emitNumber(db::Program *program, db::number_t number, size_t position);
+
+static bool emitVariable(db::Program *program, const db::VarTable *table, const char *variable, size_t position);
+
+/// Node whose value is left on stack[position], operator is
+/// emitted when frame is visited after its operands
+struct CompileFrame {
+  const db::TreeNode *node;
+  size_t position;
+  bool   isVisited;
+};
+
+static bool compileNode(db::Program *program, const db::VarTable *table, const db::TreeNode *node, size_t position);
+
+/// State of compilation of DAG
+struct DagCompiler {
+  const db::Dag *dag;
+  const db::VarTable *table;
+  size_t *uses;
+  size_t *registers;
+};
+
+/// The same as CompileFrame for nodes of DAG
+struct DagCompileFrame {
+  size_t node;
+  size_t position;
+  bool   isVisited;
+};
+
+static bool countUses(const db::Dag *dag, size_t *uses, size_t node);
+
+static bool compileDagNode(db::Program *program, const DagCompiler *compiler, size_t node, size_t position);
+
+static void initProgram(db::Program *program);
+
+static void runProgram(const db::Program *program, const double *slots, double *memory);
+
+void db::compileTree(db::Program *program, const db::Tree *tree, const db::VarTable *table, int *error)
+{
+  if (!program)
+    ERROR();
+
+  if (!tree || !tree->root)
+    ERROR();
+
+  if (!isVarTableValid(table))
+    ERROR();
+
+  initProgram(program);
+
+  program->outputs = 1;
+
+  if (!compileNode(program, table, tree->root, 0))
+    {
+      db::destroyProgram(program);
+
+      ERROR();
+    }
+}
+
+void db::destroyProgram(db::Program *program, int *error)
+{
+  if (!program)
+    ERROR();
+
+  free(program->code);
+
+  initProgram(program);
+}
+
+void db::compileFused(db::Program *program, const db::Tree *const *trees, size_t count, const db::VarTable *table, int *error)
+{
+  if (!program)
+    ERROR();
+
+  if (!trees || !count)
+    ERROR();
+
+  db::Dag dag{};
+
+  int errorCode = 0;
+
+  db::createDag(&dag, &errorCode);
+
+  if (errorCode)
+    ERROR();
+
+  size_t *roots = (size_t *)calloc(count, sizeof(size_t));
+
+  if (!roots)
+    errorCode = -1;
+
+  for (size_t i = 0; i < count && !errorCode; ++i)
+    {
+      if (!trees[i] || !trees[i]->root)
+        {
+          errorCode = -1;
+
+          break;
+        }
+
+      roots[i] = db::addDagTree(&dag, trees[i]->root, &errorCode);
+    }
+
+  if (!errorCode)
+    db::compileDag(program, &dag, roots, count, table, &errorCode);
+
+  free(roots);
+
+  db::destroyDag(&dag);
+
+  if (errorCode)
+    ERROR();
+}
+
+void db::compileDag(
+                    db::Program *program,
+                    const db::Dag *dag,
+                    const size_t *roots,
+                    size_t count,
+                    const db::VarTable *table,
+                    int *error
+                   )
+{
+  if (!program)
+    ERROR();
+
+  if (!dag || !roots || !count)
+    ERROR();
+
+  if (!isVarTableValid(table))
+    ERROR();
+
+  for (size_t i = 0; i < count; ++i)
+    if (roots[i] >= dag->size)
+      ERROR();
+
+  initProgram(program);
+
+  size_t *uses      = (size_t *)calloc(dag->size, sizeof(size_t));
+  size_t *registers = (size_t *)calloc(dag->size, sizeof(size_t));
+
+  bool isCompiled = uses && registers;
+
+  if (isCompiled)
+    {
+      for (size_t i = 0; i < dag->size; ++i)
+        registers[i] = db::NO_SLOT;
+
+      for (size_t i = 0; i < count && isCompiled; ++i)
+        isCompiled = countUses(dag, uses, roots[i]);
+
+      DagCompiler compiler = {dag, table, uses, registers};
+
+      for (size_t i = 0; i < count && isCompiled; ++i)
+        isCompiled = compileDagNode(program, &compiler, roots[i], i);
+    }
+
+  free(uses);
+  free(registers);
+
+  if (!isCompiled)
+    {
+      db::destroyProgram(program);
+
+      ERROR();
+    }
+
+  program->outputs = count;
+}
+
+double db::executeProgram(const db::Program *program, const db::VarTable *table, int *error)
+{
+  if (!program || !program->code)
+    ERROR(NAN);
+
+  if (!isVarTableValid(table) || table->size < program->slots)
+    ERROR(NAN);
+
+  double  localSlots[MAX_LOCAL_SLOTS] = {};
+  double *slots = localSlots;
+
+  if (table->size > MAX_LOCAL_SLOTS)
+    {
+      slots = (double *)calloc(table->size, sizeof(double));
+
+      if (!slots)
+        ERROR(NAN);
+    }
+
+  db::loadSlots(table, slots);
+
+  double result = db::executeProgram(program, slots, error);
+
+  if (slots != localSlots)
+    free(slots);
+
+  return result;
+}
+
+double db::executeProgram(const db::Program *program, const double *slots, int *error)
+{
+  if (!program || !program->code)
+    ERROR(NAN);
+
+  if (!slots && program->slots)
+    ERROR(NAN);
+
+  double  localMemory[MAX_LOCAL_DEPTH] = {};
+  double *memory = localMemory;
+
+  if (program->depth + program->registers > MAX_LOCAL_DEPTH)
+    {
+      memory = (double *)calloc(program->depth + program->registers, sizeof(double));
+
+      if (!memory)
+        ERROR(NAN);
+    }
+
+  runProgram(program, slots, memory);
+
+  double result = memory[0];
+
+  if (memory != localMemory)
+    free(memory);
+
+  return result;
+}
+
+void db::executeOutputs(const db::Program *program, const double *slots, double *results, int *error)
+{
+  if (!program || !program->code)
+    ERROR();
+
+  if (!slots && program->slots)
+    ERROR();
+
+  if (!results)
+    ERROR();
+
+  double  localMemory[MAX_LOCAL_DEPTH] = {};
+  double *memory = localMemory;
+
+  if (program->depth + program->registers > MAX_LOCAL_DEPTH)
+    {
+      memory = (double *)calloc(program->depth + program->registers, sizeof(double));
+
+      if (!memory)
+        ERROR();
+    }
+
+  runProgram(program, slots, memory);
+
+  for (size_t i = 0; i < program->outputs; ++i)
+    results[i] = memory[i];
+
+  if (memory != localMemory)
+    free(memory);
+}
+
+/// Memory is stack of depth values and registers after it
+static void runProgram(const db::Program *program, const double *slots, double *memory)
+{
+  assert(program);
+  assert(memory);
+
+  double *top       = memory;
+  double *registers = memory + program->depth;
+
+  const db::Instruction *end = program->code + program->size;
+
+  for (const db::Instruction *ip = program->code; ip < end; ++ip)
+    switch (ip->opcode)
+      {
+      case db::OPCODE_NUMBER: *top++ = ip->argument.number;      break;
+      case db::OPCODE_SLOT  : *top++ = slots[ip->argument.slot]; break;
+      case db::OPCODE_ADD : --top; top[-1] = top[-1] + top[0];             break;
+      case db::OPCODE_SUB : --top; top[-1] = top[-1] - top[0];             break;
+      case db::OPCODE_MUL : --top; top[-1] = top[-1] * top[0];             break;
+      case db::OPCODE_DIV : --top; top[-1] = top[-1] / top[0];             break;
+      case db::OPCODE_POW : --top; top[-1] = pow(top[-1], top[0]);         break;
+      case db::OPCODE_LOG : --top; top[-1] = log(top[0]) / log(top[-1]);   break;
+      case db::OPCODE_SQRT: top[-1] = sqrt(top[-1]);                       break;
+      case db::OPCODE_SIN : top[-1] = sin (top[-1]);                       break;
+      case db::OPCODE_COS : top[-1] = cos (top[-1]);                       break;
+      case db::OPCODE_LN  : top[-1] = log (top[-1]);                       break;
+      case db::OPCODE_STORE: registers[ip->argument.index] = top[-1];      break;
+      case db::OPCODE_LOAD : *top++ = registers[ip->argument.index];       break;
+      case db::OPCODES_COUNT:
+      default: assert(0 && "Invalid opcode");
+      }
+}
+
+static void initProgram(db::Program *program)
+{
+  assert(program);
+
+  program->code      = nullptr;
+  program->capacity  = 0;
+  program->size      = 0;
+  program->depth     = 0;
+  program->slots     = 0;
+  program->registers = 0;
+  program->outputs   = 0;
+}
+
+static bool emitInstruction(db::Program *program, db::Instruction instruction)
+{
+  assert(program);
+
+  if (program->size == program->capacity)
+    {
+      db::Instruction *temp =
+        (db::Instruction *)recalloc(
+                                    program->code,
+                                    (program->capacity + 1)*DEFAULT_GROWTH_FACTOR,
+                                    sizeof(db::Instruction)
+                                   );
+      if (!temp)
+        return false;
+
+      program->code = temp;
+
+      ++program->capacity;
+      program->capacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  program->code[program->size++] = instruction;
+
+  return true;
+}
+
+static bool emitNumber(db::Program *program, db::number_t number, size_t position)
+{
+  assert(program);
+
+  if (program->depth < position + 1)
+    program->depth = position + 1;
+
+  return emitInstruction(program, {db::OPCODE_NUMBER, {.number = number}});
+}
+
+static bool emitVariable(db::Program *program, const db::VarTable *table, const char *variable, size_t position)
+{
+  assert(program);
+  assert(table);
+
+  size_t slot = db::searchVariableSlot(table, variable);
+
+  if (slot == db::NO_SLOT)
+    return emitNumber(program, NAN, position);
+
+  if (program->depth < position + 1)
+    program->depth = position + 1;
+
+  if (program->slots < slot + 1)
+    program->slots = slot + 1;
+
+  return emitInstruction(program, {db::OPCODE_SLOT, {.slot = slot}});
+}
+
+/// Emit code which leaves value of node on stack[position].
+/// Missing operands are replaced by NAN like in calculateNode()
+static bool compileNode(db::Program *program, const db::VarTable *table, const db::TreeNode *node, size_t position)
+{
+  assert(program);
+  assert(table);
+  assert(node);
+
+  db::Stack frames{};
+
+  int errorCode = 0;
+
+  db::createStack(&frames, sizeof(CompileFrame), &errorCode);
+
+  if (errorCode)
+    return false;
+
+  CompileFrame frame = {node, position, false};
+
+  bool isCompiled = db::push(&frames, &frame);
+
+  while (isCompiled && db::pop(&frames, &frame))
+    {
+      const db::TreeNode *current = frame.node;
+
+      if (!current)
+        {
+          isCompiled = emitNumber(program, NAN, frame.position);
+
+          continue;
+        }
+
+      switch (current->type)
+        {
+        case db::type_t::NUMBER:
+          isCompiled = emitNumber(program, current->value.number, frame.position);
+          break;
+        case db::type_t::VARIABLE:
+          isCompiled = emitVariable(program, table, current->value.variable, frame.position);
+          break;
+        case db::type_t::OPERATOR:
+          {
+            db::operator_t operat = current->value.operat;
+
+            if (operat < 0 || operat >= db::OPERATORS_COUNT)
+              {
+                isCompiled = emitNumber(program, NAN, frame.position);
+
+                break;
+              }
+
+            if (frame.isVisited)
+              {
+                db::opcode_t opcode = (db::opcode_t)((int)db::OPCODE_ADD + (int)operat);
+
+                isCompiled = emitInstruction(program, {opcode, {}});
+
+                break;
+              }
+
+            bool isUnary = db::isUnary(operat);
+
+            CompileFrame visited = {current       , frame.position           , true };
+            CompileFrame left    = {current->left , frame.position           , false};
+            CompileFrame right   = {current->right, frame.position + !isUnary, false};
+
+            isCompiled =
+              db::push(&frames, &visited) &&
+              db::push(&frames, &right  ) &&
+              (isUnary || db::push(&frames, &left));
+
+            break;
+          }
+        default:
+          isCompiled = false;
+          break;
+        }
+    }
+
+  db::destroyStack(&frames);
+
+  return isCompiled;
+}
+
+/// Count uses of nodes reachable from node, children are counted once
+/// @return Was stack allocated
+static bool countUses(const db::Dag *dag, size_t *uses, size_t node)
+{
+  assert(dag);
+  assert(uses);
+
+  db::Stack nodes{};
+
+  int errorCode = 0;
+
+  db::createStack(&nodes, sizeof(size_t), &errorCode);
+
+  if (errorCode)
+    return false;
+
+  bool isCounted = db::push(&nodes, &node);
+
+  while (isCounted && db::pop(&nodes, &node))
+    {
+      if (node == db::NO_NODE || uses[node]++)
+        continue;
+
+      isCounted =
+        db::push(&nodes, &dag->nodes[node].left ) &&
+        db::push(&nodes, &dag->nodes[node].right);
+    }
+
+  db::destroyStack(&nodes);
+
+  return isCounted;
+}
+
+/// Emit code which leaves value of DAG node on stack[position].
+/// Operator node with several uses is calculated once and saved to register,
+/// operands are emitted from left to right, so register is saved before loads
+static bool compileDagNode(db::Program *program, const DagCompiler *compiler, size_t node, size_t position)
+{
+  assert(program);
+  assert(compiler);
+
+  db::Stack frames{};
+
+  int errorCode = 0;
+
+  db::createStack(&frames, sizeof(DagCompileFrame), &errorCode);
+
+  if (errorCode)
+    return false;
+
+  DagCompileFrame frame = {node, position, false};
+
+  bool isCompiled = db::push(&frames, &frame);
+
+  while (isCompiled && db::pop(&frames, &frame))
+    {
+      size_t current = frame.node;
+
+      if (current == db::NO_NODE)
+        {
+          isCompiled = emitNumber(program, NAN, frame.position);
+
+          continue;
+        }
+
+      const db::DagNode *dagNode = &compiler->dag->nodes[current];
+
+      if (!frame.isVisited && compiler->registers[current] != db::NO_SLOT)
+        {
+          if (program->depth < frame.position + 1)
+            program->depth = frame.position + 1;
+
+          isCompiled = emitInstruction(program, {db::OPCODE_LOAD, {.index = compiler->registers[current]}});
+
+          continue;
+        }
+
+      switch (dagNode->type)
+        {
+        case db::type_t::NUMBER:
+          isCompiled = emitNumber(program, dagNode->value.number, frame.position);
+          break;
+        case db::type_t::VARIABLE:
+          isCompiled = emitVariable(program, compiler->table, dagNode->value.variable, frame.position);
+          break;
+        case db::type_t::OPERATOR:
+          {
+            db::operator_t operat = dagNode->value.operat;
+
+            if (operat < 0 || operat >= db::OPERATORS_COUNT)
+              {
+                isCompiled = emitNumber(program, NAN, frame.position);
+
+                break;
+              }
+
+            if (frame.isVisited)
+              {
+                db::opcode_t opcode = (db::opcode_t)((int)db::OPCODE_ADD + (int)operat);
+
+                isCompiled = emitInstruction(program, {opcode, {}});
+
+                if (!isCompiled || compiler->uses[current] < 2)
+                  break;
+
+                compiler->registers[current] = program->registers++;
+
+                isCompiled = emitInstruction(program, {db::OPCODE_STORE, {.index = compiler->registers[current]}});
+
+                break;
+              }
+
+            bool isUnary = db::isUnary(operat);
+
+            DagCompileFrame visited = {current       , frame.position           , true };
+            DagCompileFrame left    = {dagNode->left , frame.position           , false};
+            DagCompileFrame right   = {dagNode->right, frame.position + !isUnary, false};
+
+            isCompiled =
+              db::push(&frames, &visited) &&
+              db::push(&frames, &right  ) &&
+              (isUnary || db::push(&frames, &left));
+
+            break;
+          }
+        default:
+          isCompiled = false;
+          break;
+        }
+    }
+
+  db::destroyStack(&frames);
+
+  return isCompiled;
+}
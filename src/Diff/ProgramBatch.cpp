@@ -0,0 +1,405 @@
+#include "Program.h"
+
+#include <stdlib.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "SystemLike.h"
+#include "Assert.h"
+#include "Error.h"
+
+const size_t BATCH_SIZE = 256;
+
+typedef void (*binaryKernel_t)(double *target, const double *source, size_t count);
+typedef void (*unaryKernel_t) (double *target, size_t count);
+
+struct Kernels {
+  binaryKernel_t add;
+  binaryKernel_t sub;
+  binaryKernel_t mul;
+  binaryKernel_t div;
+  unaryKernel_t  sqrt;
+};
+
+static const Kernels *getKernels();
+
+static const Kernels *selectKernels();
+
+static void addScalar (double *target, const double *source, size_t count);
+static void subScalar (double *target, const double *source, size_t count);
+static void mulScalar (double *target, const double *source, size_t count);
+static void divScalar (double *target, const double *source, size_t count);
+static void sqrtScalar(double *target, size_t count);
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) static void addAvx2 (double *target, const double *source, size_t count);
+__attribute__((target("avx2"))) static void subAvx2 (double *target, const double *source, size_t count);
+__attribute__((target("avx2"))) static void mulAvx2 (double *target, const double *source, size_t count);
+__attribute__((target("avx2"))) static void divAvx2 (double *target, const double *source, size_t count);
+__attribute__((target("avx2"))) static void sqrtAvx2(double *target, size_t count);
+
+__attribute__((target("avx512f"))) static void addAvx512 (double *target, const double *source, size_t count);
+__attribute__((target("avx512f"))) static void subAvx512 (double *target, const double *source, size_t count);
+__attribute__((target("avx512f"))) static void mulAvx512 (double *target, const double *source, size_t count);
+__attribute__((target("avx512f"))) static void divAvx512 (double *target, const double *source, size_t count);
+__attribute__((target("avx512f"))) static void sqrtAvx512(double *target, size_t count);
+
+static const Kernels AVX2_KERNELS   = {addAvx2  , subAvx2  , mulAvx2  , divAvx2  , sqrtAvx2  };
+static const Kernels AVX512_KERNELS = {addAvx512, subAvx512, mulAvx512, divAvx512, sqrtAvx512};
+#endif
+
+static const Kernels SCALAR_KERNELS = {addScalar, subScalar, mulScalar, divScalar, sqrtScalar};
+
+static void fill(double *target, double value, size_t count);
+
+static void copy(double *target, const double *source, size_t count);
+
+static bool executeBlocks(
+                          const db::Program *program,
+                          db::Context *context,
+                          size_t slot,
+                          const double *values,
+                          double *const *results,
+                          size_t outputs,
+                          size_t count
+                         );
+
+static void executeBlock(
+                         const db::Program *program,
+                         const Kernels *kernels,
+                         const double *slots,
+                         size_t slot,
+                         const double *values,
+                         double *stack,
+                         size_t count
+                        );
+
+void db::createContext(db::Context *context, const db::VarTable *table, int *error)
+{
+  if (!context)
+    ERROR();
+
+  if (!isVarTableValid(table))
+    ERROR();
+
+  context->slots      = nullptr;
+  context->slotsCount = table->size;
+  context->stack      = nullptr;
+  context->stackSize  = 0;
+
+  if (!table->size)
+    return;
+
+  context->slots = (double *)calloc(table->size, sizeof(double));
+
+  if (!context->slots)
+    ERROR();
+
+  db::loadSlots(table, context->slots);
+}
+
+void db::destroyContext(db::Context *context, int *error)
+{
+  if (!context)
+    ERROR();
+
+  free(context->slots);
+  free(context->stack);
+
+  context->slots      = nullptr;
+  context->slotsCount = 0;
+  context->stack      = nullptr;
+  context->stackSize  = 0;
+}
+
+void db::reserveStack(db::Context *context, size_t size, int *error)
+{
+  if (!context)
+    ERROR();
+
+  if (context->stackSize >= size)
+    return;
+
+  double *temp = (double *)recalloc(context->stack, size, sizeof(double));
+
+  if (!temp)
+    ERROR();
+
+  context->stack     = temp;
+  context->stackSize = size;
+}
+
+void db::executeProgram(
+                        const db::Program *program,
+                        db::Context *context,
+                        size_t slot,
+                        const double *values,
+                        double *results,
+                        size_t count,
+                        int *error
+                       )
+{
+  if (!program || !program->code)
+    ERROR();
+
+  if (!context || context->slotsCount < program->slots)
+    ERROR();
+
+  if (!count)
+    return;
+
+  if (!values || !results)
+    ERROR();
+
+  if (!executeBlocks(program, context, slot, values, &results, 1, count))
+    ERROR();
+}
+
+void db::executeOutputs(
+                        const db::Program *program,
+                        db::Context *context,
+                        size_t slot,
+                        const double *values,
+                        double *const *results,
+                        size_t count,
+                        int *error
+                       )
+{
+  if (!program || !program->code)
+    ERROR();
+
+  if (!context || context->slotsCount < program->slots)
+    ERROR();
+
+  if (!count)
+    return;
+
+  if (!values || !results)
+    ERROR();
+
+  for (size_t i = 0; i < program->outputs; ++i)
+    if (!results[i])
+      ERROR();
+
+  if (!executeBlocks(program, context, slot, values, results, program->outputs, count))
+    ERROR();
+}
+
+/// Execute program by blocks and copy first outputs rows of stack to results
+static bool executeBlocks(
+                          const db::Program *program,
+                          db::Context *context,
+                          size_t slot,
+                          const double *values,
+                          double *const *results,
+                          size_t outputs,
+                          size_t count
+                         )
+{
+  assert(program);
+  assert(context);
+  assert(values);
+  assert(results);
+
+  int errorCode = 0;
+
+  db::reserveStack(context, (program->depth + program->registers) * BATCH_SIZE, &errorCode);
+
+  if (errorCode)
+    return false;
+
+  const Kernels *kernels = getKernels();
+
+  for (size_t begin = 0; begin < count; begin += BATCH_SIZE)
+    {
+      size_t blockSize = count - begin < BATCH_SIZE ? count - begin : BATCH_SIZE;
+
+      executeBlock(program, kernels, context->slots, slot, values + begin, context->stack, blockSize);
+
+      for (size_t output = 0; output < outputs; ++output)
+        copy(results[output] + begin, context->stack + output * BATCH_SIZE, blockSize);
+    }
+
+  return true;
+}
+
+/// Stack of block is array of depth rows, each row has BATCH_SIZE values,
+/// rows of registers go after stack
+static void executeBlock(
+                         const db::Program *program,
+                         const Kernels *kernels,
+                         const double *slots,
+                         size_t slot,
+                         const double *values,
+                         double *stack,
+                         size_t count
+                        )
+{
+  assert(program);
+  assert(kernels);
+  assert(values);
+  assert(stack);
+
+  double *top       = stack;
+  double *registers = stack + program->depth * BATCH_SIZE;
+
+  const db::Instruction *end = program->code + program->size;
+
+  for (const db::Instruction *ip = program->code; ip < end; ++ip)
+    {
+      double *last     = top  - BATCH_SIZE;
+      double *previous = last - BATCH_SIZE;
+
+      switch (ip->opcode)
+        {
+        case db::OPCODE_NUMBER:
+          fill(top, ip->argument.number, count);
+          top += BATCH_SIZE;
+          break;
+        case db::OPCODE_SLOT:
+          if (ip->argument.slot == slot)
+            copy(top, values, count);
+          else
+            fill(top, slots[ip->argument.slot], count);
+          top += BATCH_SIZE;
+          break;
+        case db::OPCODE_ADD: top = last; kernels->add(previous, last, count); break;
+        case db::OPCODE_SUB: top = last; kernels->sub(previous, last, count); break;
+        case db::OPCODE_MUL: top = last; kernels->mul(previous, last, count); break;
+        case db::OPCODE_DIV: top = last; kernels->div(previous, last, count); break;
+        case db::OPCODE_POW:
+          top = last;
+          for (size_t i = 0; i < count; ++i)
+            previous[i] = pow(previous[i], last[i]);
+          break;
+        case db::OPCODE_LOG:
+          top = last;
+          for (size_t i = 0; i < count; ++i)
+            previous[i] = log(last[i]) / log(previous[i]);
+          break;
+        case db::OPCODE_SQRT: kernels->sqrt(last, count); break;
+        case db::OPCODE_SIN : for (size_t i = 0; i < count; ++i) last[i] = sin(last[i]); break;
+        case db::OPCODE_COS : for (size_t i = 0; i < count; ++i) last[i] = cos(last[i]); break;
+        case db::OPCODE_LN  : for (size_t i = 0; i < count; ++i) last[i] = log(last[i]); break;
+        case db::OPCODE_STORE:
+          copy(registers + ip->argument.index * BATCH_SIZE, last, count);
+          break;
+        case db::OPCODE_LOAD:
+          copy(top, registers + ip->argument.index * BATCH_SIZE, count);
+          top += BATCH_SIZE;
+          break;
+        case db::OPCODES_COUNT:
+        default: assert(0 && "Invalid opcode");
+        }
+    }
+}
+
+static const Kernels *getKernels()
+{
+  static const Kernels *kernels = selectKernels();
+
+  return kernels;
+}
+
+/// Vector kernels are only on x86, other processors use scalar ones
+static const Kernels *selectKernels()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512f"))
+    return &AVX512_KERNELS;
+
+  if (__builtin_cpu_supports("avx2"))
+    return &AVX2_KERNELS;
+#endif
+
+  return &SCALAR_KERNELS;
+}
+
+static void fill(double *target, double value, size_t count)
+{
+  assert(target);
+
+  for (size_t i = 0; i < count; ++i)
+    target[i] = value;
+}
+
+static void copy(double *target, const double *source, size_t count)
+{
+  assert(target);
+  assert(source);
+
+  for (size_t i = 0; i < count; ++i)
+    target[i] = source[i];
+}
+
+#define SCALAR_BINARY_KERNEL(NAME, OPERATOR)                                \
+  static void NAME(double *target, const double *source, size_t count)      \
+  {                                                                         \
+    for (size_t i = 0; i < count; ++i)                                      \
+      target[i] = target[i] OPERATOR source[i];                             \
+  }
+
+SCALAR_BINARY_KERNEL(addScalar, +)
+SCALAR_BINARY_KERNEL(subScalar, -)
+SCALAR_BINARY_KERNEL(mulScalar, *)
+SCALAR_BINARY_KERNEL(divScalar, /)
+
+static void sqrtScalar(double *target, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+    target[i] = sqrt(target[i]);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define SIMD_BINARY_KERNEL(NAME, ISA, WIDTH, TYPE, PREFIX, OPERATION, OPERATOR)    \
+  __attribute__((target(ISA)))                                                     \
+  static void NAME(double *target, const double *source, size_t count)             \
+  {                                                                                \
+    size_t i = 0;                                                                  \
+                                                                                   \
+    for ( ; i + WIDTH <= count; i += WIDTH)                                        \
+      {                                                                            \
+        TYPE first  = PREFIX ## _loadu_pd(target + i);                             \
+        TYPE second = PREFIX ## _loadu_pd(source + i);                             \
+                                                                                   \
+        PREFIX ## _storeu_pd(target + i, PREFIX ## _ ## OPERATION ## _pd(first, second)); \
+      }                                                                            \
+                                                                                   \
+    for ( ; i < count; ++i)                                                        \
+      target[i] = target[i] OPERATOR source[i];                                    \
+  }
+
+#define SIMD_SQRT_KERNEL(NAME, ISA, WIDTH, TYPE, PREFIX)                           \
+  __attribute__((target(ISA)))                                                     \
+  static void NAME(double *target, size_t count)                                   \
+  {                                                                                \
+    size_t i = 0;                                                                  \
+                                                                                   \
+    for ( ; i + WIDTH <= count; i += WIDTH)                                        \
+      {                                                                            \
+        TYPE value = PREFIX ## _loadu_pd(target + i);                              \
+                                                                                   \
+        PREFIX ## _storeu_pd(target + i, PREFIX ## _sqrt_pd(value));               \
+      }                                                                            \
+                                                                                   \
+    for ( ; i < count; ++i)                                                        \
+      target[i] = sqrt(target[i]);                                                 \
+  }
+
+SIMD_BINARY_KERNEL(addAvx2, "avx2", 4, __m256d, _mm256, add, +)
+SIMD_BINARY_KERNEL(subAvx2, "avx2", 4, __m256d, _mm256, sub, -)
+SIMD_BINARY_KERNEL(mulAvx2, "avx2", 4, __m256d, _mm256, mul, *)
+SIMD_BINARY_KERNEL(divAvx2, "avx2", 4, __m256d, _mm256, div, /)
+SIMD_SQRT_KERNEL (sqrtAvx2, "avx2", 4, __m256d, _mm256)
+
+SIMD_BINARY_KERNEL(addAvx512, "avx512f", 8, __m512d, _mm512, add, +)
+SIMD_BINARY_KERNEL(subAvx512, "avx512f", 8, __m512d, _mm512, sub, -)
+SIMD_BINARY_KERNEL(mulAvx512, "avx512f", 8, __m512d, _mm512, mul, *)
+SIMD_BINARY_KERNEL(divAvx512, "avx512f", 8, __m512d, _mm512, div, /)
+SIMD_SQRT_KERNEL (sqrtAvx512, "avx512f", 8, __m512d, _mm512)
+
+#endif
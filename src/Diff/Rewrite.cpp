@@ -0,0 +1,765 @@
+#include "Rewrite.h"
+#include "Dag.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include "SystemLike.h"
+#include "Assert.h"
+#include "Error.h"
+
+const int DEFAULT_GROWTH_FACTOR = 2;
+
+/// Numbers of patterns are compared like simplite compares them
+const double ACCURACY = 1. / 10000.;
+
+const char *const ARROW = "->";
+
+/// Kinds of subtrees are operators, numbers and anything
+const unsigned NUMBER_KIND = 1u << db::OPERATORS_COUNT;
+const unsigned ANY_KIND    = 1u << (db::OPERATORS_COUNT + 1);
+
+/// Matching state, links of subtrees which names of pattern matched are bound.
+/// Pending are links of subtrees which aren`t matched yet, the last is the next,
+/// their count grows by one with every operator of path at most
+struct Match {
+  const db::RuleSet *rules;
+  db::TreeNode     **bindings[db::MAX_PATTERN_SIZE];
+  db::TreeNode     **found   [db::MAX_PATTERN_SIZE];     ///< Bindings of found rule
+  db::TreeNode     **pending [db::MAX_PATTERN_SIZE + 1];
+  size_t             pendingCount;
+  size_t             rule;                               ///< Found rule or NO_RULE
+};
+
+/// Place of name in result where matched subtree is moved
+struct Hole {
+  db::TreeNode **link;
+  db::TreeNode  *parent;
+  size_t         variable;
+};
+
+/// Node of right side of rule which is copied to link
+struct ResultFrame {
+  const db::TreeNode  *node;
+  db::TreeNode        *parent;
+  db::TreeNode       **link;
+};
+
+static inline bool isEqual(double first, double second)
+{
+  return fabs(first - second) < ACCURACY;
+}
+
+static size_t addState(db::RuleSet *rules);
+
+static size_t addNumberEdge(db::RuleSet *rules, size_t state, db::number_t number);
+
+static db::RewriteRule *addEmptyRule(db::RuleSet *rules);
+
+static bool parseRule(db::RewriteRule *rule, const char *source);
+
+static bool compileRule(db::RuleSet *rules, size_t index);
+
+static bool checkResult(const db::RewriteRule *rule);
+
+static void destroyRule(db::RewriteRule *rule);
+
+static size_t findVariable(const db::RewriteRule *rule, const char *name);
+
+static bool hasOperands(const db::TreeNode *node);
+
+static unsigned getKind(const db::TreeNode *node);
+
+static bool canMatch(const Match *match, size_t state);
+
+static void matchState(Match *match, size_t state, size_t bound);
+
+static bool isConsistent(const db::RewriteRule *rule, db::TreeNode **const *bindings);
+
+static bool isEqualNode(const db::TreeNode *first, const db::TreeNode *second);
+
+static bool isEqualTree(const db::TreeNode *first, const db::TreeNode *second);
+
+static db::TreeNode *buildResult(
+                                 const db::RewriteRule *rule,
+                                 db::TreeNode **const *bindings,
+                                 db::TreeNode ***links,
+                                 size_t *linksCount
+                                );
+
+void db::createRuleSet(db::RuleSet *rules, int *error)
+{
+  if (!rules)
+    ERROR();
+
+  rules->rules           = nullptr;
+  rules->rulesCapacity   = 0;
+  rules->rulesCount      = 0;
+  rules->states          = nullptr;
+  rules->statesCapacity  = 0;
+  rules->statesCount     = 0;
+  rules->numbers         = nullptr;
+  rules->numbersCapacity = 0;
+  rules->numbersCount    = 0;
+
+  // First state is start of every pattern
+  if (addState(rules) == db::NO_RULE)
+    ERROR();
+}
+
+void db::destroyRuleSet(db::RuleSet *rules, int *error)
+{
+  if (!rules)
+    ERROR();
+
+  for (size_t i = 0; i < rules->rulesCount; ++i)
+    destroyRule(&rules->rules[i]);
+
+  free(rules->rules);
+  free(rules->states);
+  free(rules->numbers);
+
+  rules->rules           = nullptr;
+  rules->rulesCapacity   = 0;
+  rules->rulesCount      = 0;
+  rules->states          = nullptr;
+  rules->statesCapacity  = 0;
+  rules->statesCount     = 0;
+  rules->numbers         = nullptr;
+  rules->numbersCapacity = 0;
+  rules->numbersCount    = 0;
+}
+
+void db::addRule(db::RuleSet *rules, const char *rule, int *error)
+{
+  if (!rules || !rules->states || !rule)
+    ERROR();
+
+  db::RewriteRule *added = addEmptyRule(rules);
+
+  if (!added)
+    ERROR();
+
+  if (!parseRule(added, rule) || !compileRule(rules, rules->rulesCount - 1))
+    {
+      destroyRule(added);
+
+      --rules->rulesCount;
+
+      ERROR();
+    }
+}
+
+bool db::isPositiveName(const char *name)
+{
+  assert(name);
+
+  return isupper((unsigned char)*name);
+}
+
+bool db::rewriteNode(const db::RuleSet *rules, db::TreeNode **link, db::Stack *fresh, int *error)
+{
+  if (!rules || !rules->states || !link || !*link)
+    ERROR(false);
+
+  // Bindings are written before they are read, so they aren`t cleared
+  Match match;
+
+  match.rules        = rules;
+  match.pending[0]   = link;
+  match.pendingCount = 1;
+  match.rule         = db::NO_RULE;
+
+  if (canMatch(&match, 0))
+    matchState(&match, 0, 0);
+
+  if (match.rule == db::NO_RULE)
+    return false;
+
+  db::TreeNode **links[db::MAX_PATTERN_SIZE] = {};
+  size_t         linksCount                  = 0;
+
+  db::TreeNode *node   = *link;
+  db::TreeNode *result = buildResult(&rules->rules[match.rule], match.found, links, &linksCount);
+
+  if (!result)
+    ERROR(false);
+
+  result->parent = node->parent;
+
+  db::removeNode(node);
+
+  *link = result;
+
+  bool isPushed = true;
+
+  // Operators of result are in preorder, root is the first
+  for (size_t i = linksCount; fresh && isPushed && i-- > 0; )
+    {
+      db::TreeNode **freshLink = i ? links[i] : link;
+
+      isPushed = db::push(fresh, &freshLink);
+    }
+
+  if (!isPushed)
+    ERROR(true);
+
+  return true;
+}
+
+static size_t addState(db::RuleSet *rules)
+{
+  assert(rules);
+
+  if (rules->statesCount == rules->statesCapacity)
+    {
+      db::MatchState *temp =
+        (db::MatchState *)recalloc(
+                                   rules->states,
+                                   (rules->statesCapacity + 1)*DEFAULT_GROWTH_FACTOR,
+                                   sizeof(db::MatchState)
+                                  );
+      if (!temp)
+        return db::NO_RULE;
+
+      rules->states = temp;
+
+      ++rules->statesCapacity;
+      rules->statesCapacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  db::MatchState *state = &rules->states[rules->statesCount];
+
+  for (int i = 0; i < db::OPERATORS_COUNT; ++i)
+    state->operators[i] = db::NO_RULE;
+
+  state->any     = db::NO_RULE;
+  state->numbers = db::NO_RULE;
+  state->rules   = db::NO_RULE;
+  state->kinds   = 0;
+
+  return rules->statesCount++;
+}
+
+/// Find state after number or add new one
+static size_t addNumberEdge(db::RuleSet *rules, size_t state, db::number_t number)
+{
+  assert(rules);
+  assert(state < rules->statesCount);
+
+  for (size_t edge = rules->states[state].numbers; edge != db::NO_RULE; edge = rules->numbers[edge].next)
+    if (!memcmp(&rules->numbers[edge].number, &number, sizeof(number)))
+      return rules->numbers[edge].state;
+
+  if (rules->numbersCount == rules->numbersCapacity)
+    {
+      db::NumberEdge *temp =
+        (db::NumberEdge *)recalloc(
+                                   rules->numbers,
+                                   (rules->numbersCapacity + 1)*DEFAULT_GROWTH_FACTOR,
+                                   sizeof(db::NumberEdge)
+                                  );
+      if (!temp)
+        return db::NO_RULE;
+
+      rules->numbers = temp;
+
+      ++rules->numbersCapacity;
+      rules->numbersCapacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  size_t next = addState(rules);
+
+  if (next == db::NO_RULE)
+    return db::NO_RULE;
+
+  rules->numbers[rules->numbersCount] = {number, next, rules->states[state].numbers};
+
+  rules->states[state].numbers = rules->numbersCount++;
+
+  return next;
+}
+
+static db::RewriteRule *addEmptyRule(db::RuleSet *rules)
+{
+  assert(rules);
+
+  if (rules->rulesCount == rules->rulesCapacity)
+    {
+      db::RewriteRule *temp =
+        (db::RewriteRule *)recalloc(
+                                    rules->rules,
+                                    (rules->rulesCapacity + 1)*DEFAULT_GROWTH_FACTOR,
+                                    sizeof(db::RewriteRule)
+                                   );
+      if (!temp)
+        return nullptr;
+
+      rules->rules = temp;
+
+      ++rules->rulesCapacity;
+      rules->rulesCapacity *= DEFAULT_GROWTH_FACTOR;
+    }
+
+  db::RewriteRule *rule = &rules->rules[rules->rulesCount++];
+
+  *rule = {{}, {}, nullptr, 0, nullptr, 0, db::NO_RULE};
+
+  return rule;
+}
+
+static bool parseRule(db::RewriteRule *rule, const char *source)
+{
+  assert(rule);
+  assert(source);
+
+  const char *arrow = strstr(source, ARROW);
+
+  if (!arrow)
+    return false;
+
+  char *pattern = strndup(source, (size_t)(arrow - source));
+
+  rule->variables = (const char **)calloc(db::MAX_PATTERN_SIZE, sizeof(const char *));
+  rule->slots     = (size_t      *)calloc(db::MAX_PATTERN_SIZE, sizeof(size_t      ));
+
+  if (!pattern || !rule->variables || !rule->slots)
+    {
+      free(pattern);
+
+      return false;
+    }
+
+  int errorCode = 0;
+
+  db::parseTree(&rule->pattern, pattern, &errorCode);
+
+  if (!errorCode)
+    db::parseTree(&rule->result, arrow + strlen(ARROW), &errorCode);
+
+  free(pattern);
+
+  return !errorCode && rule->pattern.root && rule->result.root;
+}
+
+/// Add path of symbols of pattern to discrimination tree, names get their variables
+static bool compileRule(db::RuleSet *rules, size_t index)
+{
+  assert(rules);
+  assert(index < rules->rulesCount);
+
+  db::Stack stack{};
+
+  db::createStack(&stack, sizeof(const db::TreeNode *));
+
+  const db::TreeNode *node = rules->rules[index].pattern.root;
+
+  size_t state = 0;
+  size_t size  = 0;
+
+  bool isCompiled = db::push(&stack, &node);
+
+  while (isCompiled && db::pop(&stack, &node))
+    {
+      db::RewriteRule *rule = &rules->rules[index];
+
+      size_t next = db::NO_RULE;
+
+      if (++size > db::MAX_PATTERN_SIZE)
+        isCompiled = false;
+      else if (node->type == db::type_t::VARIABLE)
+        {
+          size_t variable = findVariable(rule, node->value.variable);
+
+          if (variable == rule->variablesCount)
+            rule->variables[rule->variablesCount++] = node->value.variable;
+
+          rule->slots[rule->slotsCount++] = variable;
+
+          next = rules->states[state].any;
+
+          if (next == db::NO_RULE && (next = addState(rules)) != db::NO_RULE)
+            rules->states[state].any = next;
+        }
+      else if (node->type == db::type_t::NUMBER)
+        next = addNumberEdge(rules, state, node->value.number);
+      else if (hasOperands(node))
+        {
+          db::operator_t operat = node->value.operat;
+
+          next = rules->states[state].operators[operat];
+
+          if (next == db::NO_RULE && (next = addState(rules)) != db::NO_RULE)
+            rules->states[state].operators[operat] = next;
+
+          isCompiled =
+            db::push(&stack, &node->right) &&
+            (db::isUnary(operat) || db::push(&stack, &node->left));
+        }
+
+      if (next != db::NO_RULE)
+        rules->states[state].kinds |= node->type == db::type_t::VARIABLE ? ANY_KIND : getKind(node);
+
+      state      = next;
+      isCompiled = isCompiled && state != db::NO_RULE;
+    }
+
+  db::destroyStack(&stack);
+
+  db::RewriteRule *rule = &rules->rules[index];
+
+  if (!isCompiled || !checkResult(rule))
+    return false;
+
+  // Rules with the same path are kept in order of adding
+  size_t *last = &rules->states[state].rules;
+
+  while (*last != db::NO_RULE)
+    last = &rules->rules[*last].next;
+
+  *last = index;
+
+  return true;
+}
+
+/// Names of result must be bound by pattern, result must be small like pattern
+static bool checkResult(const db::RewriteRule *rule)
+{
+  assert(rule);
+
+  db::Stack stack{};
+
+  db::createStack(&stack, sizeof(const db::TreeNode *));
+
+  const db::TreeNode *node = rule->result.root;
+
+  size_t size = 0;
+
+  bool isChecked = db::push(&stack, &node);
+
+  while (isChecked && db::pop(&stack, &node))
+    {
+      if (++size > db::MAX_PATTERN_SIZE)
+        isChecked = false;
+      else if (node->type == db::type_t::VARIABLE)
+        isChecked = findVariable(rule, node->value.variable) < rule->variablesCount;
+      else if (node->type == db::type_t::OPERATOR)
+        isChecked =
+          hasOperands(node) &&
+          db::push(&stack, &node->right) &&
+          (db::isUnary(node->value.operat) || db::push(&stack, &node->left));
+    }
+
+  db::destroyStack(&stack);
+
+  return isChecked;
+}
+
+static void destroyRule(db::RewriteRule *rule)
+{
+  assert(rule);
+
+  db::destroyTree(&rule->pattern);
+  db::destroyTree(&rule->result);
+
+  free(rule->variables);
+  free(rule->slots);
+
+  rule->variables = nullptr;
+  rule->slots     = nullptr;
+}
+
+/// @return Index of variable or count of variables
+static size_t findVariable(const db::RewriteRule *rule, const char *name)
+{
+  assert(rule);
+  assert(name);
+
+  size_t variable = 0;
+
+  while (variable < rule->variablesCount && strcmp(rule->variables[variable], name))
+    ++variable;
+
+  return variable;
+}
+
+/// Operator has all operands which it uses
+static bool hasOperands(const db::TreeNode *node)
+{
+  assert(node);
+
+  return
+    node->type == db::type_t::OPERATOR &&
+    node->value.operat < db::OPERATORS_COUNT &&
+    node->right &&
+    (node->left || db::isUnary(node->value.operat));
+}
+
+/// Follow every edge of state which matches the last pending subtree, pending
+/// subtrees are restored after that. Depth of recursion is bounded by length
+/// of path, which isn`t over MAX_PATTERN_SIZE
+/// @param [in] bound Count of bound names
+static void matchState(Match *match, size_t state, size_t bound)
+{
+  assert(match);
+
+  const db::RuleSet    *rules   = match->rules;
+  const db::MatchState *current = &rules->states[state];
+
+  if (!match->pendingCount)
+    {
+      for (size_t rule = current->rules; rule != db::NO_RULE && rule < match->rule; rule = rules->rules[rule].next)
+        if (isConsistent(&rules->rules[rule], match->bindings))
+          {
+            match->rule = rule;
+
+            memcpy(match->found, match->bindings, bound * sizeof(db::TreeNode **));
+
+            break;
+          }
+
+      return;
+    }
+
+  size_t count = --match->pendingCount;
+
+  db::TreeNode **link = match->pending[count];
+  db::TreeNode  *node = *link;
+
+  if (current->any != db::NO_RULE && bound < db::MAX_PATTERN_SIZE)
+    {
+      match->bindings[bound] = link;
+
+      if (canMatch(match, current->any))
+        matchState(match, current->any, bound + 1);
+    }
+
+  if (node->type == db::type_t::NUMBER)
+    for (size_t edge = current->numbers; edge != db::NO_RULE; edge = rules->numbers[edge].next)
+      if (isEqual(rules->numbers[edge].number, node->value.number) && canMatch(match, rules->numbers[edge].state))
+        matchState(match, rules->numbers[edge].state, bound);
+
+  if (
+      hasOperands(node) &&
+      current->operators[node->value.operat] != db::NO_RULE &&
+      count + 2 <= db::MAX_PATTERN_SIZE + 1
+     )
+    {
+      match->pending[match->pendingCount++] = &node->right;
+
+      if (!db::isUnary(node->value.operat))
+        match->pending[match->pendingCount++] = &node->left;
+
+      if (canMatch(match, current->operators[node->value.operat]))
+        matchState(match, current->operators[node->value.operat], bound);
+    }
+
+  match->pending[count] = link;
+  match->pendingCount   = count + 1;
+}
+
+/// Bit of kind of node, names match only by ANY_KIND
+static unsigned getKind(const db::TreeNode *node)
+{
+  assert(node);
+
+  if (node->type == db::type_t::NUMBER)
+    return NUMBER_KIND;
+
+  if (hasOperands(node))
+    return 1u << node->value.operat;
+
+  return 0;
+}
+
+/// State has edge for the next pending subtree or rule if nothing is pending,
+/// so calls which fail at once are skipped
+static bool canMatch(const Match *match, size_t state)
+{
+  assert(match);
+
+  const db::MatchState *next = &match->rules->states[state];
+
+  if (!match->pendingCount)
+    return next->rules != db::NO_RULE;
+
+  return next->kinds & (ANY_KIND | getKind(*match->pending[match->pendingCount - 1]));
+}
+
+/// Repeated names bound equal subtrees, positive names bound positive numbers
+static bool isConsistent(const db::RewriteRule *rule, db::TreeNode **const *bindings)
+{
+  assert(rule);
+  assert(bindings);
+
+  for (size_t i = 0; i < rule->slotsCount; ++i)
+    {
+      const db::TreeNode *bound = *bindings[i];
+
+      if (
+          db::isPositiveName(rule->variables[rule->slots[i]]) &&
+          (bound->type != db::type_t::NUMBER || !(bound->value.number > 0))
+         )
+        return false;
+
+      size_t first = 0;
+
+      while (rule->slots[first] != rule->slots[i])
+        ++first;
+
+      if (first != i && !isEqualTree(*bindings[first], *bindings[i]))
+        return false;
+    }
+
+  return true;
+}
+
+/// Nodes are equal up to children
+static bool isEqualNode(const db::TreeNode *first, const db::TreeNode *second)
+{
+  if (!first || !second)
+    return first == second;
+
+  if (first->type != second->type)
+    return false;
+
+  if (first->type == db::type_t::NUMBER)
+    return isEqual(first->value.number, second->value.number);
+
+  if (first->type == db::type_t::VARIABLE)
+    return !strcmp(first->value.variable, second->value.variable);
+
+  return first->value.operat == second->value.operat;
+}
+
+/// Most of subtrees differ by roots, so stack is made only for equal roots
+static bool isEqualTree(const db::TreeNode *first, const db::TreeNode *second)
+{
+  if (!isEqualNode(first, second))
+    return false;
+
+  if (!first || first->type != db::type_t::OPERATOR)
+    return true;
+
+  db::Stack stack{};
+
+  db::createStack(&stack, sizeof(const db::TreeNode *));
+
+  bool isEqualNodes = db::push(&stack, &first) && db::push(&stack, &second);
+
+  while (isEqualNodes && db::pop(&stack, &second) && db::pop(&stack, &first))
+    isEqualNodes =
+      isEqualNode(first, second) &&
+      (
+       !first || first->type != db::type_t::OPERATOR ||
+       (
+        db::push(&stack, &first->left ) && db::push(&stack, &second->left ) &&
+        db::push(&stack, &first->right) && db::push(&stack, &second->right)
+       )
+      );
+
+  db::destroyStack(&stack);
+
+  return isEqualNodes;
+}
+
+/// Right side of rule where names are replaced by bound subtrees. The first
+/// use of name takes subtree from matched node, other uses copy it. Subtrees
+/// are taken after all copies, so matched node is intact on failure
+/// @param [out] links Links to operators of result in preorder, the first is
+/// root, it is nullptr, because root link is outside of result
+static db::TreeNode *buildResult(
+                                 const db::RewriteRule *rule,
+                                 db::TreeNode **const *bindings,
+                                 db::TreeNode ***links,
+                                 size_t *linksCount
+                                )
+{
+  assert(rule);
+  assert(bindings);
+  assert(links);
+  assert(linksCount);
+
+  db::TreeNode **origins[db::MAX_PATTERN_SIZE];
+
+  for (size_t i = rule->slotsCount; i-- > 0; )
+    origins[rule->slots[i]] = bindings[i];
+
+  Hole   holes  [db::MAX_PATTERN_SIZE] = {};
+  bool   isTaken[db::MAX_PATTERN_SIZE] = {};
+  size_t holesCount                    = 0;
+
+  db::TreeNode *root = nullptr;
+
+  // Result has at most MAX_PATTERN_SIZE nodes, so arrays are enough
+  ResultFrame stack[db::MAX_PATTERN_SIZE] = {{rule->result.root, nullptr, &root}};
+  size_t      stackCount                  = 1;
+
+  bool isBuilt = true;
+
+  while (isBuilt && stackCount)
+    {
+      ResultFrame frame = stack[--stackCount];
+
+      const db::TreeNode *node  = frame.node;
+      db::TreeNode       *built = nullptr;
+
+      if (node->type == db::type_t::VARIABLE)
+        {
+          size_t variable = findVariable(rule, node->value.variable);
+
+          if (!isTaken[variable])
+            {
+              isTaken[variable] = true;
+
+              holes[holesCount++] = {frame.link, frame.parent, variable};
+
+              continue;
+            }
+
+          built = db::createNode(*origins[variable]);
+        }
+      else
+        built = db::createNode(node->value, node->type);
+
+      isBuilt = built;
+
+      if (!built)
+        continue;
+
+      built->parent = frame.parent;
+      *frame.link   = built;
+
+      if (node->type == db::type_t::OPERATOR)
+        {
+          links[(*linksCount)++] = frame.link == &root ? nullptr : frame.link;
+
+          stack[stackCount++] = {node->right, built, &built->right};
+
+          if (node->left)
+            stack[stackCount++] = {node->left, built, &built->left};
+        }
+    }
+
+  if (!isBuilt)
+    {
+      if (root)
+        db::removeNode(root);
+
+      *linksCount = 0;
+
+      return nullptr;
+    }
+
+  for (size_t i = 0; i < holesCount; ++i)
+    {
+      db::TreeNode **origin = origins[holes[i].variable];
+
+      (*origin)->parent = holes[i].parent;
+      *holes[i].link    = *origin;
+      *origin           = nullptr;
+    }
+
+  return root;
+}
@@ -0,0 +1,788 @@
+#include "Sampler.h"
+#include "Program.h"
+#include "Interval.h"
+#include "Jit.h"
+#include "Native.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "ErrorHandler.h"
+#include "Assert.h"
+#include "Error.h"
+
+const size_t CHUNK_SIZE = 1024;
+
+/// Count of segments of grid before refinement
+const size_t INITIAL_SEGMENTS = 64;
+
+/// Max deviation of curve from chord in parts of height of yRange
+const double CURVE_TOLERANCE = 1e-3;
+
+/// Min width of refined segment in parts of width of xRange,
+/// it stops refinement near poles and jumps
+const double MIN_SEGMENT_WIDTH = 1e-12;
+
+/// Program of plot translated for backend. If backend is unavailable
+/// backend is interpreter, so program is interpreted
+struct Translation {
+  db::Backend      backend;
+  db::JitProgram   jit;
+  db::NativeModule native;
+};
+
+/// All expressions of plot are calculated by one fused program,
+/// so common subexpressions are calculated once per point
+struct SampleJob {
+  const db::Program *program;
+  const Translation *translation;
+  size_t mainSlot;
+  const double *x;
+  double *const *y;
+  size_t count;
+  size_t chunksCount;
+  std::atomic<size_t> nextTask;
+  std::atomic<bool> isFailed;
+};
+
+/// Grid of adaptive sampler, all expressions are sampled in the same points.
+/// Values are kept by outputs rows of capacity values
+struct Grid {
+  double *x;
+  double *y;
+  size_t size;
+  size_t capacity;
+  size_t outputs;
+};
+
+template <class Job>
+static bool runWorkers(
+                       void (*worker)(Job *job, db::Context *context),
+                       Job *job,
+                       size_t tasksCount,
+                       db::Context *contexts,
+                       unsigned threads
+                      );
+
+static unsigned countThreads(unsigned threads, size_t tasksCount);
+
+static db::Context *createContexts(const db::VarTable *table, unsigned threads);
+
+static void destroyContexts(db::Context *contexts, unsigned threads);
+
+static bool compilePlot(db::Program *program, const db::Plot *plot, const db::VarTable *table);
+
+static void translatePlot(
+                         Translation *translation,
+                         const db::Program *program,
+                         const db::Plot *plot,
+                         const db::VarTable *table,
+                         db::Backend backend
+                        );
+
+static void destroyTranslation(Translation *translation);
+
+static db::Interval *createBox(const db::Context *context);
+
+static void sampleChunks(SampleJob *job, db::Context *context);
+
+static void executePoints(
+                          const SampleJob *job,
+                          db::Context *context,
+                          double **rows,
+                          size_t begin,
+                          size_t count
+                         );
+
+static bool executeGrid(
+                        const db::Program *program,
+                        const Translation *translation,
+                        size_t mainSlot,
+                        Grid *grid,
+                        double **rows,
+                        db::Context *contexts,
+                        unsigned threads
+                       );
+
+static bool createGrid(Grid *grid, size_t capacity, size_t outputs);
+
+static void destroyGrid(Grid *grid);
+
+static void mergeGrid(Grid *target, const Grid *grid, const Grid *middle, const size_t *segments);
+
+static size_t selectSegments(
+                             const db::Plot *plot,
+                             const db::Program *program,
+                             const Grid *grid,
+                             db::Interval *box,
+                             size_t mainSlot,
+                             double *scores,
+                             double *temp,
+                             size_t *segments,
+                             size_t limit
+                            );
+
+static double segmentScore(const Grid *grid, size_t output, size_t segment, double low, double high);
+
+static double deviation(const Grid *grid, size_t output, size_t index, double low, double high);
+
+void db::sampleCurves(
+                      const db::Plot *plot,
+                      const db::VarTable *table,
+                      db::Curve *curves,
+                      unsigned threads,
+                      db::Backend backend,
+                      int *error
+                     )
+{
+  if (!db::isValidPlot(plot))
+    ERROR();
+
+  if (!isVarTableValid(table))
+    ERROR();
+
+  if (!curves && plot->expressionsCount)
+    ERROR();
+
+  for (size_t i = 0; i < plot->expressionsCount; ++i)
+    {
+      curves[i].x    = nullptr;
+      curves[i].y    = nullptr;
+      curves[i].size = 0;
+    }
+
+  size_t mainSlot = db::searchVariableSlot(table, db::DEFAULT_MAIN_NAME);
+
+  if (mainSlot == db::NO_SLOT)
+    {
+      handleError("No main variable!!");
+
+      ERROR();
+    }
+
+  if (!plot->expressionsCount)
+    return;
+
+  size_t budget  = plot->density;
+  size_t outputs = plot->expressionsCount;
+
+  db::Program program{};
+
+  if (!compilePlot(&program, plot, table))
+    ERROR();
+
+  Translation translation{};
+
+  translatePlot(&translation, &program, plot, table, backend);
+
+  threads = countThreads(threads, (budget + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+  db::Context *contexts = createContexts(table, threads);
+
+  Grid grid{};
+  Grid next{};
+  Grid middle{};
+
+  bool isAllocated =
+    createGrid(&grid  , budget, outputs) &&
+    createGrid(&next  , budget, outputs) &&
+    createGrid(&middle, budget, outputs);
+
+  db::Interval *box      = contexts ? createBox(&contexts[0]) : nullptr;
+  double       *scores   = (double *)calloc(budget , sizeof(double));
+  size_t       *segments = (size_t *)calloc(budget , sizeof(size_t));
+  double      **rows     = (double **)calloc(outputs, sizeof(double *));
+
+  bool isSampled = isAllocated && contexts && box && scores && segments && rows;
+
+  if (isSampled)
+    {
+      grid.size = budget < INITIAL_SEGMENTS + 1 ? budget : INITIAL_SEGMENTS + 1;
+
+      double range = plot->xRange.max - plot->xRange.min;
+      for (size_t i = 0; i < grid.size; ++i)
+        grid.x[i] = grid.size > 1 ?
+          plot->xRange.min + range * (double)i/(double)(grid.size - 1) : plot->xRange.min;
+
+      isSampled = executeGrid(&program, &translation, mainSlot, &grid, rows, contexts, threads);
+    }
+
+  while (isSampled && grid.size < budget)
+    {
+      middle.size =
+        selectSegments(plot, &program, &grid, box, mainSlot, scores, middle.x, segments, budget - grid.size);
+
+      if (!middle.size)
+        break;
+
+      for (size_t i = 0; i < middle.size; ++i)
+        middle.x[i] = (grid.x[segments[i]] + grid.x[segments[i] + 1]) / 2;
+
+      isSampled = executeGrid(&program, &translation, mainSlot, &middle, rows, contexts, threads);
+
+      mergeGrid(&next, &grid, &middle, segments);
+
+      std::swap(grid, next);
+    }
+
+  for (size_t i = 0; i < outputs && isSampled; ++i)
+    {
+      curves[i].x = (double *)calloc(grid.size, sizeof(double));
+      curves[i].y = (double *)calloc(grid.size, sizeof(double));
+
+      if (!curves[i].x || !curves[i].y)
+        {
+          isSampled = false;
+
+          break;
+        }
+
+      curves[i].size = grid.size;
+
+      for (size_t j = 0; j < grid.size; ++j)
+        {
+          curves[i].x[j] = grid.x[j];
+          curves[i].y[j] = grid.y[i * grid.capacity + j];
+        }
+    }
+
+  free(box);
+  free(scores);
+  free(segments);
+  free(rows);
+
+  destroyGrid(&grid);
+  destroyGrid(&next);
+  destroyGrid(&middle);
+
+  destroyContexts(contexts, threads);
+
+  destroyTranslation(&translation);
+  db::destroyProgram(&program);
+
+  if (!isSampled)
+    {
+      for (size_t i = 0; i < plot->expressionsCount; ++i)
+        db::destroyCurve(&curves[i]);
+
+      ERROR();
+    }
+}
+
+void db::destroyCurve(db::Curve *curve, int *error)
+{
+  if (!curve)
+    ERROR();
+
+  free(curve->x);
+  free(curve->y);
+
+  curve->x    = nullptr;
+  curve->y    = nullptr;
+  curve->size = 0;
+}
+
+/// Run worker in threads with own contexts, worker takes tasks from job
+template <class Job>
+static bool runWorkers(
+                       void (*worker)(Job *job, db::Context *context),
+                       Job *job,
+                       size_t tasksCount,
+                       db::Context *contexts,
+                       unsigned threads
+                      )
+{
+  assert(worker);
+  assert(job);
+  assert(contexts);
+  assert(threads);
+
+  if (!tasksCount)
+    return true;
+
+  std::vector<std::thread> workers{};
+
+  for (unsigned i = 1; i < threads; ++i)
+    workers.emplace_back(worker, job, &contexts[i]);
+
+  worker(job, &contexts[0]);
+
+  for (std::thread &thread : workers)
+    thread.join();
+
+  return !job->isFailed;
+}
+
+/// Zero threads means count of processors, there is no more threads than tasks
+static unsigned countThreads(unsigned threads, size_t tasksCount)
+{
+  if (!threads)
+    threads = std::thread::hardware_concurrency();
+  if (!threads)
+    threads = 1;
+  if (threads > tasksCount && tasksCount)
+    threads = (unsigned)tasksCount;
+
+  return threads;
+}
+
+static db::Context *createContexts(const db::VarTable *table, unsigned threads)
+{
+  assert(table);
+  assert(threads);
+
+  db::Context *contexts = (db::Context *)calloc(threads, sizeof(db::Context));
+
+  if (!contexts)
+    return nullptr;
+
+  int errorCode = 0;
+
+  for (unsigned i = 0; i < threads && !errorCode; ++i)
+    db::createContext(&contexts[i], table, &errorCode);
+
+  if (errorCode)
+    {
+      destroyContexts(contexts, threads);
+
+      return nullptr;
+    }
+
+  return contexts;
+}
+
+static void destroyContexts(db::Context *contexts, unsigned threads)
+{
+  if (!contexts)
+    return;
+
+  for (unsigned i = 0; i < threads; ++i)
+    db::destroyContext(&contexts[i]);
+
+  free(contexts);
+}
+
+/// Compile expressions of plot to one program with output per expression
+static bool compilePlot(db::Program *program, const db::Plot *plot, const db::VarTable *table)
+{
+  assert(program);
+  assert(plot);
+  assert(table);
+
+  const db::Tree **trees = (const db::Tree **)calloc(plot->expressionsCount, sizeof(db::Tree *));
+
+  if (!trees)
+    return false;
+
+  for (size_t i = 0; i < plot->expressionsCount; ++i)
+    trees[i] = plot->expressions[i].expression;
+
+  int errorCode = 0;
+
+  db::compileFused(program, trees, plot->expressionsCount, table, &errorCode);
+
+  free(trees);
+
+  return !errorCode;
+}
+
+/// Translate program of plot for backend, the native backend
+/// compiles expressions of plot by system compiler
+static void translatePlot(
+                         Translation *translation,
+                         const db::Program *program,
+                         const db::Plot *plot,
+                         const db::VarTable *table,
+                         db::Backend backend
+                        )
+{
+  assert(translation);
+  assert(program);
+  assert(plot);
+  assert(table);
+
+  translation->backend = db::Backend::INTERPRETER;
+
+  int errorCode = 0;
+
+  switch (backend)
+    {
+    case db::Backend::JIT:
+      db::compileJit(&translation->jit, program, &errorCode);
+
+      if (!errorCode && translation->jit.function)
+        translation->backend = db::Backend::JIT;
+      break;
+    case db::Backend::NATIVE:
+      {
+        const db::Tree **trees = (const db::Tree **)calloc(plot->expressionsCount, sizeof(db::Tree *));
+
+        if (!trees)
+          break;
+
+        for (size_t i = 0; i < plot->expressionsCount; ++i)
+          trees[i] = plot->expressions[i].expression;
+
+        db::loadNativeModule(&translation->native, trees, plot->expressionsCount, table, &errorCode);
+
+        free(trees);
+
+        if (!errorCode)
+          translation->backend = db::Backend::NATIVE;
+        break;
+      }
+    case db::Backend::INTERPRETER:
+    default:
+      break;
+    }
+}
+
+static void destroyTranslation(Translation *translation)
+{
+  assert(translation);
+
+  if (translation->jit.program)
+    db::destroyJit(&translation->jit);
+
+  if (translation->native.handle)
+    db::destroyNativeModule(&translation->native);
+}
+
+/// Box of point intervals for values of variables in context
+static db::Interval *createBox(const db::Context *context)
+{
+  assert(context);
+
+  size_t size = context->slotsCount ? context->slotsCount : 1;
+
+  db::Interval *box = (db::Interval *)calloc(size, sizeof(db::Interval));
+
+  if (!box)
+    return nullptr;
+
+  for (size_t i = 0; i < context->slotsCount; ++i)
+    box[i] = isnan(context->slots[i]) ?
+      db::EMPTY_INTERVAL : db::Interval{context->slots[i], context->slots[i]};
+
+  return box;
+}
+
+/// Take chunks of points while they are.
+/// Every value is calculated independently, so result doesn`t
+/// depend on order of tasks and count of threads
+static void sampleChunks(SampleJob *job, db::Context *context)
+{
+  assert(job);
+  assert(context);
+
+  double **rows = (double **)calloc(job->program->outputs, sizeof(double *));
+
+  if (!rows)
+    {
+      job->isFailed = true;
+
+      return;
+    }
+
+  for (size_t task = job->nextTask++; task < job->chunksCount; task = job->nextTask++)
+    {
+      size_t begin = task * CHUNK_SIZE;
+      size_t count = job->count - begin < CHUNK_SIZE ? job->count - begin : CHUNK_SIZE;
+
+      executePoints(job, context, rows, begin, count);
+    }
+
+  free(rows);
+}
+
+static void executePoints(
+                          const SampleJob *job,
+                          db::Context *context,
+                          double **rows,
+                          size_t begin,
+                          size_t count
+                         )
+{
+  assert(job);
+  assert(context);
+  assert(rows);
+
+  for (size_t i = 0; i < job->program->outputs; ++i)
+    rows[i] = job->y[i] + begin;
+
+  const Translation *translation = job->translation;
+
+  switch (translation->backend)
+    {
+    case db::Backend::JIT:
+      db::executeJitOutputs(&translation->jit, context, job->mainSlot, job->x + begin, rows, count);
+      break;
+    case db::Backend::NATIVE:
+      db::executeNative(&translation->native, context, job->mainSlot, job->x + begin, rows, count);
+      break;
+    case db::Backend::INTERPRETER:
+    default:
+      db::executeOutputs(job->program, context, job->mainSlot, job->x + begin, rows, count);
+      break;
+    }
+}
+
+/// Calculate all outputs in points of grid. Points aren`t skipped by
+/// intervals, segments are chosen by intervals in selectSegments()
+static bool executeGrid(
+                        const db::Program *program,
+                        const Translation *translation,
+                        size_t mainSlot,
+                        Grid *grid,
+                        double **rows,
+                        db::Context *contexts,
+                        unsigned threads
+                       )
+{
+  assert(program);
+  assert(grid);
+  assert(rows);
+  assert(contexts);
+
+  for (size_t i = 0; i < grid->outputs; ++i)
+    rows[i] = grid->y + i * grid->capacity;
+
+  size_t chunksCount = (grid->size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+  SampleJob job = {
+    program,
+    translation,
+    mainSlot,
+    grid->x,
+    rows,
+    grid->size,
+    chunksCount,
+    {0},
+    {false},
+  };
+
+  return runWorkers(sampleChunks, &job, chunksCount, contexts, countThreads(threads, chunksCount));
+}
+
+static bool createGrid(Grid *grid, size_t capacity, size_t outputs)
+{
+  assert(grid);
+
+  grid->x        = (double *)calloc(capacity, sizeof(double));
+  grid->y        = (double *)calloc(capacity * outputs, sizeof(double));
+  grid->size     = 0;
+  grid->capacity = capacity;
+  grid->outputs  = outputs;
+
+  return grid->x && grid->y;
+}
+
+static void destroyGrid(Grid *grid)
+{
+  assert(grid);
+
+  free(grid->x);
+  free(grid->y);
+
+  grid->x        = nullptr;
+  grid->y        = nullptr;
+  grid->size     = 0;
+  grid->capacity = 0;
+}
+
+/// Put points of middle after chosen segments of grid
+static void mergeGrid(Grid *target, const Grid *grid, const Grid *middle, const size_t *segments)
+{
+  assert(target);
+  assert(grid);
+  assert(middle);
+  assert(segments);
+
+  size_t size     = 0;
+  size_t inserted = 0;
+
+  for (size_t i = 0; i < grid->size; ++i)
+    {
+      target->x[size] = grid->x[i];
+      for (size_t j = 0; j < grid->outputs; ++j)
+        target->y[j * target->capacity + size] = grid->y[j * grid->capacity + i];
+      ++size;
+
+      if (inserted >= middle->size || segments[inserted] != i)
+        continue;
+
+      target->x[size] = middle->x[inserted];
+      for (size_t j = 0; j < grid->outputs; ++j)
+        target->y[j * target->capacity + size] = middle->y[j * middle->capacity + inserted];
+      ++size;
+
+      ++inserted;
+    }
+
+  target->size = size;
+}
+
+/// Choose at most limit segments with scores above tolerance, the worst first.
+/// Score of segment is the worst score of expressions which aren`t bounded
+/// outside of yRange on it, so hidden or undefined segments aren`t refined
+/// @param [out] scores Buffer for scores of segments
+/// @param [out] temp Buffer for search of the limit-th score
+/// @param [out] segments Chosen segments in increasing order
+/// @return Count of chosen segments
+static size_t selectSegments(
+                             const db::Plot *plot,
+                             const db::Program *program,
+                             const Grid *grid,
+                             db::Interval *box,
+                             size_t mainSlot,
+                             double *scores,
+                             double *temp,
+                             size_t *segments,
+                             size_t limit
+                            )
+{
+  assert(plot);
+  assert(program);
+  assert(grid);
+  assert(box);
+  assert(scores);
+  assert(temp);
+  assert(segments);
+
+  db::Range yRange = plot->yRange;
+
+  double height = yRange.max - yRange.min;
+  if (!(height > 0))
+    height = 1;
+
+  double low  = yRange.min - height;
+  double high = yRange.max + height;
+
+  double minWidth = (plot->xRange.max - plot->xRange.min) * MIN_SEGMENT_WIDTH;
+
+  db::Interval *bounds = (db::Interval *)calloc(grid->outputs, sizeof(db::Interval));
+
+  if (!bounds)
+    return 0;
+
+  size_t candidates = 0;
+
+  for (size_t i = 0; i + 1 < grid->size; ++i)
+    {
+      double middle = (grid->x[i] + grid->x[i + 1]) / 2;
+
+      scores[i] = 0;
+
+      if (!(grid->x[i] < middle && middle < grid->x[i + 1]))
+        continue;
+
+      if (grid->x[i + 1] - grid->x[i] < minWidth)
+        continue;
+
+      double worst = 0;
+      for (size_t j = 0; j < grid->outputs; ++j)
+        worst = fmax(worst, segmentScore(grid, j, i, low, high) / height);
+
+      if (!(worst > CURVE_TOLERANCE))
+        continue;
+
+      box[mainSlot] = {grid->x[i], grid->x[i + 1]};
+
+      db::executeIntervals(program, box, bounds);
+
+      double score = 0;
+      for (size_t j = 0; j < grid->outputs; ++j)
+        if (!db::isEmpty(bounds[j]) && bounds[j].hi >= yRange.min && bounds[j].lo <= yRange.max)
+          score = fmax(score, segmentScore(grid, j, i, low, high) / height);
+
+      if (!(score > CURVE_TOLERANCE))
+        continue;
+
+      scores[i] = score;
+      temp[candidates++] = score;
+    }
+
+  free(bounds);
+
+  if (!candidates || !limit)
+    return 0;
+
+  double threshold = 0;
+
+  if (candidates > limit)
+    {
+      std::nth_element(temp, temp + limit - 1, temp + candidates, std::greater<double>());
+
+      threshold = temp[limit - 1];
+    }
+
+  size_t ties = limit;
+
+  for (size_t i = 0; i + 1 < grid->size; ++i)
+    if (scores[i] > threshold)
+      --ties;
+
+  size_t count = 0;
+
+  for (size_t i = 0; i + 1 < grid->size; ++i)
+    if (scores[i] > threshold)
+      segments[count++] = i;
+    else if (scores[i] > 0 && !(scores[i] < threshold) && ties)
+      {
+        segments[count++] = i;
+        --ties;
+      }
+
+  return count;
+}
+
+static inline double clamp(double value, double low, double high)
+{
+  return fmin(fmax(value, low), high);
+}
+
+/// Deviation of point from chord of its neighbours. Clamping maps NAN to low,
+/// so undefined neighbours are checked before it
+static double deviation(const Grid *grid, size_t output, size_t index, double low, double high)
+{
+  assert(grid);
+
+  if (!index || index + 1 >= grid->size)
+    return 0;
+
+  const double *x = grid->x;
+  const double *y = grid->y + output * grid->capacity;
+
+  if (isnan(y[index - 1]) || isnan(y[index]) || isnan(y[index + 1]))
+    return 0;
+
+  double left   = clamp(y[index - 1], low, high);
+  double middle = clamp(y[index    ], low, high);
+  double right  = clamp(y[index + 1], low, high);
+
+  double part = (x[index] - x[index - 1]) / (x[index + 1] - x[index - 1]);
+
+  return fabs(middle - (left + part * (right - left)));
+}
+
+/// Score of segment is the worst deviation of its ends. Values are clamped
+/// by [low, high], so curve far outside of plot doesn`t take budget.
+/// Segment between defined and undefined values is the worst
+static double segmentScore(const Grid *grid, size_t output, size_t segment, double low, double high)
+{
+  assert(grid);
+
+  const double *y = grid->y + output * grid->capacity;
+
+  if (isnan(y[segment]) != isnan(y[segment + 1]))
+    return INFINITY;
+
+  if (isnan(y[segment]))
+    return 0;
+
+  return fmax(deviation(grid, output, segment, low, high), deviation(grid, output, segment + 1, low, high));
+}
@@ -0,0 +1,413 @@
+#include "Taylor.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Assert.h"
+#include "Error.h"
+
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+
+/// Integer powers up to it are calculated by multiplications of series,
+/// so they are defined for zero base
+const double MAX_INTEGER_POWER = 64;
+
+/// Buffers for one series operation, every buffer has order + 1 values
+struct Scratch {
+  double *result;
+  double *first;
+  double *second;
+};
+
+static void mul (const double *left, const double *right, double *result, size_t order);
+static void div (const double *left, const double *right, double *result, size_t order);
+static void sqrt(const double *value, double *result, size_t order);
+static void ln  (const double *value, double *result, size_t order);
+static void exp (const double *value, double *result, size_t order);
+static void sinCos(const double *value, double *sin, double *cos, size_t order);
+
+static void pow       (const double *left, const double *right, const Scratch *scratch, size_t order);
+static void powInteger(const double *value, unsigned power, const Scratch *scratch, size_t order);
+static void powConst  (const double *value, double power, double *result, size_t order);
+
+static bool isConstSeries(const double *value, size_t order);
+
+static void calculateSeries(
+                            db::operator_t operat,
+                            const double *left,
+                            const double *right,
+                            const Scratch *scratch,
+                            size_t order
+                           );
+
+void db::executeTaylor(
+                       const db::Program *program,
+                       const double *slots,
+                       size_t slot,
+                       size_t order,
+                       double *coefficients,
+                       int *error
+                      )
+{
+  if (!program || !program->code)
+    ERROR();
+
+  if (!slots && program->slots)
+    ERROR();
+
+  if (!coefficients)
+    ERROR();
+
+  size_t length = order + 1;
+
+  /// Stack and registers of series and three scratch series
+  double *memory = (double *)calloc((program->depth + program->registers + 3) * length, sizeof(double));
+
+  if (!memory)
+    ERROR();
+
+  double *stack     = memory;
+  double *registers = memory + program->depth * length;
+
+  Scratch scratch = {
+    registers + program->registers * length,
+    registers + (program->registers + 1) * length,
+    registers + (program->registers + 2) * length,
+  };
+
+  size_t top = 0;
+
+  const db::Instruction *end = program->code + program->size;
+
+  for (const db::Instruction *ip = program->code; ip < end; ++ip)
+    {
+      double *current = stack + top * length;
+
+      switch (ip->opcode)
+        {
+        case db::OPCODE_NUMBER:
+          memset(current, 0, length * sizeof(double));
+          current[0] = ip->argument.number;
+          ++top;
+          break;
+        case db::OPCODE_SLOT:
+          memset(current, 0, length * sizeof(double));
+          current[0] = slots[ip->argument.slot];
+          if (ip->argument.slot == slot && order)
+            current[1] = 1;
+          ++top;
+          break;
+        case db::OPCODE_ADD:
+        case db::OPCODE_SUB:
+        case db::OPCODE_MUL:
+        case db::OPCODE_DIV:
+        case db::OPCODE_POW:
+        case db::OPCODE_LOG:
+          --top;
+          calculateSeries(
+                          (db::operator_t)(ip->opcode - db::OPCODE_ADD),
+                          current - 2 * length,
+                          current - length,
+                          &scratch,
+                          order
+                         );
+          memcpy(current - 2 * length, scratch.result, length * sizeof(double));
+          break;
+        case db::OPCODE_SQRT:
+        case db::OPCODE_SIN:
+        case db::OPCODE_COS:
+        case db::OPCODE_LN:
+          calculateSeries(
+                          (db::operator_t)(ip->opcode - db::OPCODE_ADD),
+                          current - length,
+                          current - length,
+                          &scratch,
+                          order
+                         );
+          memcpy(current - length, scratch.result, length * sizeof(double));
+          break;
+        case db::OPCODE_STORE:
+          memcpy(registers + ip->argument.index * length, current - length, length * sizeof(double));
+          break;
+        case db::OPCODE_LOAD:
+          memcpy(current, registers + ip->argument.index * length, length * sizeof(double));
+          ++top;
+          break;
+        case db::OPCODES_COUNT:
+        default: assert(0 && "Invalid opcode");
+        }
+    }
+
+  memcpy(coefficients, stack, length * sizeof(double));
+
+  free(memory);
+}
+
+void db::calculateTaylor(
+                         const db::VarTable *table,
+                         const db::Tree *tree,
+                         const char *variable,
+                         size_t order,
+                         double *coefficients,
+                         int *error
+                        )
+{
+  if (!isVarTableValid(table))
+    ERROR();
+
+  if (!tree || !tree->root || !variable || !coefficients)
+    ERROR();
+
+  db::Program program{};
+
+  int errorCode = 0;
+
+  db::compileTree(&program, tree, table, &errorCode);
+
+  if (errorCode)
+    ERROR();
+
+  double *slots = (double *)calloc(table->size + 1, sizeof(double));
+
+  if (!slots)
+    {
+      db::destroyProgram(&program);
+
+      ERROR();
+    }
+
+  db::loadSlots(table, slots);
+
+  db::executeTaylor(&program, slots, db::searchVariableSlot(table, variable), order, coefficients, &errorCode);
+
+  free(slots);
+
+  db::destroyProgram(&program);
+
+  if (errorCode)
+    ERROR();
+}
+
+/// Series of operator is written to scratch->result
+static void calculateSeries(
+                            db::operator_t operat,
+                            const double *left,
+                            const double *right,
+                            const Scratch *scratch,
+                            size_t order
+                           )
+{
+  assert(left);
+  assert(right);
+  assert(scratch);
+
+  double *result = scratch->result;
+
+  switch (operat)
+    {
+    case db::OPERATOR_ADD:
+      for (size_t k = 0; k <= order; ++k)
+        result[k] = left[k] + right[k];
+      break;
+    case db::OPERATOR_SUB:
+      for (size_t k = 0; k <= order; ++k)
+        result[k] = left[k] - right[k];
+      break;
+    case db::OPERATOR_MUL : mul(left, right, result, order); break;
+    case db::OPERATOR_DIV : div(left, right, result, order); break;
+    case db::OPERATOR_POW : pow(left, right, scratch, order); break;
+    case db::OPERATOR_LOG :
+      ln(left,  scratch->first,  order);
+      ln(right, scratch->second, order);
+      div(scratch->second, scratch->first, result, order);
+      break;
+    case db::OPERATOR_SQRT: sqrt(right, result, order); break;
+    case db::OPERATOR_SIN : sinCos(right, result, scratch->first, order); break;
+    case db::OPERATOR_COS : sinCos(right, scratch->first, result, order); break;
+    case db::OPERATOR_LN  : ln(right, result, order); break;
+    case db::OPERATORS_COUNT:
+    default:
+      for (size_t k = 0; k <= order; ++k)
+        result[k] = NAN;
+      break;
+    }
+}
+
+static void mul(const double *left, const double *right, double *result, size_t order)
+{
+  for (size_t k = 0; k <= order; ++k)
+    {
+      double sum = left[0] * right[k];
+
+      for (size_t j = 1; j <= k; ++j)
+        sum += left[j] * right[k - j];
+
+      result[k] = sum;
+    }
+}
+
+static void div(const double *left, const double *right, double *result, size_t order)
+{
+  for (size_t k = 0; k <= order; ++k)
+    {
+      double sum = left[k];
+
+      for (size_t j = 1; j <= k; ++j)
+        sum -= right[j] * result[k - j];
+
+      result[k] = sum / right[0];
+    }
+}
+
+static void sqrt(const double *value, double *result, size_t order)
+{
+  result[0] = ::sqrt(value[0]);
+
+  for (size_t k = 1; k <= order; ++k)
+    {
+      double sum = value[k];
+
+      for (size_t j = 1; j < k; ++j)
+        sum -= result[j] * result[k - j];
+
+      result[k] = sum / (2 * result[0]);
+    }
+}
+
+static void ln(const double *value, double *result, size_t order)
+{
+  result[0] = ::log(value[0]);
+
+  for (size_t k = 1; k <= order; ++k)
+    {
+      double sum = 0;
+
+      for (size_t j = 1; j < k; ++j)
+        sum += (double)j * result[j] * value[k - j];
+
+      result[k] = (value[k] - sum / (double)k) / value[0];
+    }
+}
+
+static void exp(const double *value, double *result, size_t order)
+{
+  result[0] = ::exp(value[0]);
+
+  for (size_t k = 1; k <= order; ++k)
+    {
+      double sum = 0;
+
+      for (size_t j = 1; j <= k; ++j)
+        sum += (double)j * value[j] * result[k - j];
+
+      result[k] = sum / (double)k;
+    }
+}
+
+static void sinCos(const double *value, double *sin, double *cos, size_t order)
+{
+  sin[0] = ::sin(value[0]);
+  cos[0] = ::cos(value[0]);
+
+  for (size_t k = 1; k <= order; ++k)
+    {
+      double sinSum = 0;
+      double cosSum = 0;
+
+      for (size_t j = 1; j <= k; ++j)
+        {
+          sinSum += (double)j * value[j] * cos[k - j];
+          cosSum += (double)j * value[j] * sin[k - j];
+        }
+
+      sin[k] =  sinSum / (double)k;
+      cos[k] = -cosSum / (double)k;
+    }
+}
+
+/// Constant power has own recurrence, other powers are exp(right * ln(left))
+static void pow(const double *left, const double *right, const Scratch *scratch, size_t order)
+{
+  assert(scratch);
+
+  if (!isConstSeries(right, order))
+    {
+      ln(left, scratch->first, order);
+      mul(right, scratch->first, scratch->second, order);
+      exp(scratch->second, scratch->result, order);
+
+      scratch->result[0] = ::pow(left[0], right[0]);
+
+      return;
+    }
+
+  double power = right[0];
+
+  if (power >= 0 && power <= MAX_INTEGER_POWER && power == nearbyint(power))
+    powInteger(left, (unsigned)power, scratch, order);
+  else
+    powConst(left, power, scratch->result, order);
+}
+
+/// Binary exponentiation of series
+static void powInteger(const double *value, unsigned power, const Scratch *scratch, size_t order)
+{
+  assert(scratch);
+
+  size_t length = order + 1;
+
+  double *result = scratch->result;
+  double *base   = scratch->first;
+  double *temp   = scratch->second;
+
+  memset(result, 0, length * sizeof(double));
+  result[0] = 1;
+
+  memcpy(base, value, length * sizeof(double));
+
+  double exponent = power;
+
+  while (power)
+    {
+      if (power & 1)
+        {
+          mul(result, base, temp, order);
+          memcpy(result, temp, length * sizeof(double));
+        }
+
+      power >>= 1;
+
+      if (power)
+        {
+          mul(base, base, temp, order);
+          memcpy(base, temp, length * sizeof(double));
+        }
+    }
+
+  result[0] = ::pow(value[0], exponent);
+}
+
+/// From value * result' = power * value' * result
+static void powConst(const double *value, double power, double *result, size_t order)
+{
+  result[0] = ::pow(value[0], power);
+
+  for (size_t k = 1; k <= order; ++k)
+    {
+      double sum = 0;
+
+      for (size_t j = 1; j <= k; ++j)
+        sum += (power * (double)j - (double)(k - j)) * value[j] * result[k - j];
+
+      result[k] = sum / ((double)k * value[0]);
+    }
+}
+
+static bool isConstSeries(const double *value, size_t order)
+{
+  for (size_t k = 1; k <= order; ++k)
+    if (value[k] != 0)
+      return false;
+
+  return true;
+}
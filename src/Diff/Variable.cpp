@@ -13,12 +13,13 @@
 #include "Diff.h"
 #include "SystemLike.h"
 #include "GarbageCollector.h"
+#include "Stack.h"
 
 const int DEFAULT_GROWTH_FACTOR = 2;
 
-static void searchAndUpdateVariable(db::VarTable *table, db::TreeNode *expression);
+static bool searchAndUpdateVariable(db::VarTable *table, db::TreeNode *expression);
 
-static bool searchVariable(const db::VarTable *table, db::variable_t value);
+static void readVariable(db::VarTable *table, const char *variable);
 
 void db::updateVarTable(db::VarTable *table, db::TreeNode *expression, int *error)
 {
@@ -31,76 +32,98 @@ void db::updateVarTable(db::VarTable *table, db::TreeNode *expression, int *erro
   if (!expression)
     ERROR();
 
-  searchAndUpdateVariable(table, expression);
+  if (!searchAndUpdateVariable(table, expression))
+    ERROR();
 }
 
-static void searchAndUpdateVariable(db::VarTable *table, db::TreeNode *expression)
+/// Read values of variables which aren`t in table, variables are
+/// asked from left to right
+/// @return Was stack allocated
+static bool searchAndUpdateVariable(db::VarTable *table, db::TreeNode *expression)
 {
   assert(table);
   assert(isVarTableValid(table));
   assert(expression);
 
-  if (expression->type == db::type_t::NUMBER) return;
+  db::Stack nodes{};
 
-  if (expression->left )
-    searchAndUpdateVariable(table, expression->left );
-  if (expression->right)
-    searchAndUpdateVariable(table, expression->right);
+  int errorCode = 0;
 
-  if (expression->type == db::type_t::VARIABLE)
-    {
-      if (searchVariable(table, expression->value.variable)) return;
+  db::createStack(&nodes, sizeof(db::TreeNode *), &errorCode);
+
+  if (errorCode)
+    return false;
 
-      printf("%s" ITALIC "%s" RESET ": ",
-             db::getString(getBundle(), "variable.read"),
-             expression->value.variable);
+  db::TreeNode *node = expression;
 
-      double value = NAN;
+  bool isPushed = db::push(&nodes, &node);
 
-      while (scanf(" %lg", &value) != 1 && !isfinite(value))
+  while (isPushed && db::pop(&nodes, &node))
+    {
+      if (node->type == db::type_t::VARIABLE)
         {
-          while (getchar() != '\n') continue;
+          readVariable(table, node->value.variable);
 
-          printf("%s", db::getString(getBundle(), "input.incorrect"));
+          continue;
         }
 
+      isPushed =
+        (!node->right || db::push(&nodes, &node->right)) &&
+        (!node->left  || db::push(&nodes, &node->left ));
+    }
+
+  db::destroyStack(&nodes);
+
+  return isPushed;
+}
+
+/// Ask value of variable if it isn`t in table and add it
+static void readVariable(db::VarTable *table, const char *variable)
+{
+  assert(table);
+  assert(variable);
+
+  if (db::searchVariableSlot(table, variable) != db::NO_SLOT) return;
+
+  printf("%s" ITALIC "%s" RESET ": ",
+         db::getString(getBundle(), "variable.read"),
+         variable);
+
+  double value = NAN;
+
+  while (scanf(" %lg", &value) != 1 && !isfinite(value))
+    {
       while (getchar() != '\n') continue;
 
-      if (table->size == table->capacity)
-        {
-          db::Variable *temp = (db::Variable *)recalloc(table->table, (table->capacity+1)*DEFAULT_GROWTH_FACTOR, sizeof(db::Variable));
+      printf("%s", db::getString(getBundle(), "input.incorrect"));
+    }
 
-          if (!temp)
-            {
-              free(table->table);
+  while (getchar() != '\n') continue;
 
-              handleError("Out of memory!!");
+  if (table->size == table->capacity)
+    {
+      db::Variable *temp = (db::Variable *)recalloc(table->table, (table->capacity+1)*DEFAULT_GROWTH_FACTOR, sizeof(db::Variable));
 
-              assert(0);///////
-            }
+      if (!temp)
+        {
+          free(table->table);
 
-          table->table = temp;
+          handleError("Out of memory!!");
 
-          ++table->capacity;
-          table->capacity *= DEFAULT_GROWTH_FACTOR;
+          assert(0);///////
         }
 
-      table->table[table->size++] = {strdup(expression->value.variable), 0, value};
+      table->table = temp;
 
-      addElementForFree(table->table[table->size - 1].name);
+      ++table->capacity;
+      table->capacity *= DEFAULT_GROWTH_FACTOR;
     }
-}
 
-static bool searchVariable(const db::VarTable *table, db::variable_t value)
-{
-  assert(table);
-  assert(isVarTableValid(table));
+  table->table[table->size] = {strdup(variable), (int)table->size, value};
 
-  for (size_t i = 0; i < table->size; ++i)
-    if (!strcmp(table->table[i].name, value))
-      return true;
+  ++table->size;
 
-  return false;
+  addElementForFree(table->table[table->size - 1].name);
 }
 
 double *db::searchMainVariable(const db::VarTable *table, int *error)
@@ -108,9 +131,47 @@ double *db::searchMainVariable(const db::VarTable *table, int *error)
   if (!table)
     ERROR(nullptr);
 
+  size_t slot = db::searchVariableSlot(table, db::DEFAULT_MAIN_NAME);
+
+  return slot != db::NO_SLOT ? &table->table[slot].value : nullptr;
+}
+
+double db::getVariableValue(const db::VarTable *table, db::variable_t variable, int *error)
+{
+  if (!table)
+    ERROR(NAN);
+
+  if (!variable)
+    ERROR(NAN);
+
+  size_t slot = db::searchVariableSlot(table, variable);
+
+  return slot != db::NO_SLOT ? table->table[slot].value : NAN;
+}
+
+size_t db::searchVariableSlot(const db::VarTable *table, const char *variable, int *error)
+{
+  if (!isVarTableValid(table))
+    ERROR(db::NO_SLOT);
+
+  if (!variable)
+    ERROR(db::NO_SLOT);
+
   for (size_t i = 0; i < table->size; ++i)
-    if (!strcmp(table->table[i].name, db::DEFAULT_MAIN_NAME))
-      return &table->table[i].value;
+    if (!strcmp(table->table[i].name, variable))
+      return i;
+
+  return db::NO_SLOT;
+}
+
+void db::loadSlots(const db::VarTable *table, double *slots, int *error)
+{
+  if (!isVarTableValid(table))
+    ERROR();
 
-  return nullptr;
+  if (!slots && table->size)
+    ERROR();
+
+  for (size_t i = 0; i < table->size; ++i)
+    slots[i] = table->table[i].value;
 }
@@ -69,6 +69,12 @@ enum Flags {
   VAR,
   HELP,
   LANG,
+  CACHE,
+  THREADS,
+  OPTIMIZE,
+  OPTIMIZE_TIME,
+  BACKEND,
+  BATCH,
 };
 
 /// Type of indefity console flags
@@ -78,6 +84,12 @@ const char *FLAGS[] = {
   "-var",
   "-help",
   "-lang",
+  "-cache",
+  "-threads",
+  "-optimize",
+  "-optimize-time",
+  "-backend",
+  "-batch",
 };
 
 const int DEFAULT_GROWTH_FACTOR = 2;
@@ -100,6 +112,31 @@ static int handleLang(const char *argument, Settings *settings);
 
 static int handleVar(const char *argument, Settings *settings);
 
+/// Handle flag -cache
+/// @param [in] argument Max memory of cached derivatives in bytes
+/// @return Error`s code
+static int handleCache(const char *argument, Settings *settings);
+
+/// Handle flag -threads
+/// @param [in] argument Count of threads of differentiation, zero means count of processors
+/// @return Error`s code
+static int handleThreads(const char *argument, Settings *settings);
+
+/// Handle flag -optimize
+/// @param [in] argument Cost model: nodes, cycles or none
+/// @return Error`s code
+static int handleOptimize(const char *argument, Settings *settings);
+
+/// Handle flag -optimize-time
+/// @param [in] argument Max seconds of optimization of one derivative
+/// @return Error`s code
+static int handleOptimizeTime(const char *argument, Settings *settings);
+
+/// Handle flag -backend
+/// @param [in] argument Backend of plots: interpreter, jit or native
+/// @return Error`s code
+static int handleBackend(const char *argument, Settings *settings);
+
 /// Handle incorrect arguments for flags
 /// @param [in] flag Name of flag wicth geted incorrect argument
 /// @param [in] argument Geted argument
@@ -130,10 +167,17 @@ int parseConsoleArgs(const int argc, const char * const argv[], Settings *settin
 
           return CONSOLE_HELP;
         }
+      else if (!strcmp(argv[i], FLAGS[BATCH]))
+        settings->isBatch = true;
       ELSE_HANDLE_IF(LOAD, handleLoad);
       ELSE_HANDLE_IF(SAVE, handleSave);
       ELSE_HANDLE_IF(LANG, handleLang);
       ELSE_HANDLE_IF(VAR , handleVar );
+      ELSE_HANDLE_IF(CACHE, handleCache);
+      ELSE_HANDLE_IF(THREADS, handleThreads);
+      ELSE_HANDLE_IF(OPTIMIZE, handleOptimize);
+      ELSE_HANDLE_IF(OPTIMIZE_TIME, handleOptimizeTime);
+      ELSE_HANDLE_IF(BACKEND, handleBackend);
       else if (argv[i][0] == '-')
           handleUnknownFlag(argv[i]);
       else
@@ -161,6 +205,12 @@ static bool setDefaultSettings(Settings *settings)
   settings->target       = nullptr;
   settings->saveType     = Save::TEXT;
   settings->locale       = db::Locale::EN;
+  settings->cacheMemory  = DEFAULT_CACHE_MEMORY;
+  settings->diffThreads  = DEFAULT_DIFF_THREADS;
+  settings->optimize     = Optimize::NONE;
+  settings->optimizeTime = 0;
+  settings->backend      = db::Backend::INTERPRETER;
+  settings->isBatch      = false;
   settings->table        = (db::VarTable *)calloc(1, sizeof(db::VarTable));
 
   if (!settings->table)
@@ -267,7 +317,8 @@ static int handleVar(const char *argument, Settings *settings)
 
   size_t index = settings->table->size++;
 
-  settings->table->table[index].name = strndup(argument, size);
+  settings->table->table[index].name   = strndup(argument, size);
+  settings->table->table[index].number = (int)index;
 
   addElementForFree(settings->table->table[index].name);
 
@@ -305,6 +356,97 @@ static int handleLang(const char *argument, Settings *settings)
   return 0;
 }
 
+static int handleCache(const char *argument, Settings *settings)
+{
+  size_t memory = 0;
+  int    offset = 0;
+
+  if (sscanf(argument, "%zu%n", &memory, &offset) != 1 || (size_t)offset != strlen(argument))
+    {
+      handleError("Argument isn`t a size[%s]!!", argument);
+
+      return CONSOLE_INCORRECT_ARGUMENTS;
+    }
+
+  settings->cacheMemory = memory;
+
+  return 0;
+}
+
+static int handleThreads(const char *argument, Settings *settings)
+{
+  unsigned threads = 0;
+  int      offset  = 0;
+
+  // %u takes sign and wraps negative counts, so count starts with digit
+  if (
+      !isdigit(argument[0]) ||
+      sscanf(argument, "%u%n", &threads, &offset) != 1 || (size_t)offset != strlen(argument)
+     )
+    {
+      handleError("Argument isn`t a count[%s]!!", argument);
+
+      return CONSOLE_INCORRECT_ARGUMENTS;
+    }
+
+  settings->diffThreads = threads;
+
+  return 0;
+}
+
+static int handleOptimize(const char *argument, Settings *settings)
+{
+  if (!strcmp(argument, "nodes"))
+    settings->optimize = Optimize::NODES;
+  else if (!strcmp(argument, "cycles"))
+    settings->optimize = Optimize::CYCLES;
+  else if (!strcmp(argument, "none"))
+    settings->optimize = Optimize::NONE;
+  else
+    {
+      handleError("Unknown cost model[%s]!!", argument);
+
+      return CONSOLE_INCORRECT_ARGUMENTS;
+    }
+
+  return 0;
+}
+
+static int handleOptimizeTime(const char *argument, Settings *settings)
+{
+  double time   = 0;
+  int    offset = 0;
+
+  if (sscanf(argument, "%lg%n", &time, &offset) != 1 || (size_t)offset != strlen(argument) || !(time >= 0))
+    {
+      handleError("Argument isn`t a time[%s]!!", argument);
+
+      return CONSOLE_INCORRECT_ARGUMENTS;
+    }
+
+  settings->optimizeTime = time;
+
+  return 0;
+}
+
+static int handleBackend(const char *argument, Settings *settings)
+{
+  if (!strcmp(argument, "interpreter"))
+    settings->backend = db::Backend::INTERPRETER;
+  else if (!strcmp(argument, "jit"))
+    settings->backend = db::Backend::JIT;
+  else if (!strcmp(argument, "native"))
+    settings->backend = db::Backend::NATIVE;
+  else
+    {
+      handleError("Unknown backend[%s]!!", argument);
+
+      return CONSOLE_INCORRECT_ARGUMENTS;
+    }
+
+  return 0;
+}
+
 static void handleIncorrectArgument(const char *flag, const char *argument)
 {
   handleError("%s expeced argument, but geted %s", flag, argument);
@@ -15,6 +15,9 @@ int main(const int argc, const char * const argv[])
   if (!init())
     return 0;
 
+  if (settings.isBatch)
+    return diffBatch() ? 0 : 1;
+
   start();
 
   return 0;
@@ -0,0 +1,798 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Tree.h"
+#include "Variable.h"
+#include "DiffUtils.h"
+#include "Program.h"
+#include "Jit.h"
+#include "Sampler.h"
+#include "Native.h"
+#include "Dual.h"
+#include "Gradient.h"
+
+const int RANDOM_SEED = 42;
+
+const size_t RANDOM_TREES_COUNT = 2000;
+
+const int MAX_RANDOM_DEPTH = 8;
+
+/// Names aren`t constant, because nodes take mutable names to copy
+char VARIABLE_NAMES[][db::MAX_VARIABLE_SIZE] = {"x", "k"};
+
+const size_t VARIABLES_COUNT = sizeof(VARIABLE_NAMES) / sizeof(VARIABLE_NAMES[0]);
+
+/// Numbers of trees, zero and negative numbers take operators out of their domains
+const double NUMBERS[] = {0, 1, 2, -1, 0.5, 3};
+
+/// Values of main variable, they include poles and undefined values
+const double VALUES[] = {-2.5, -1, 0, 0.5, 1, 3, INFINITY, -INFINITY, NAN};
+
+const unsigned SAMPLE_DENSITY = 500;
+
+/// Native code is compiled with contraction to FMA, so it differs in last bits
+const double NATIVE_TOLERANCE = 1e-12;
+
+const char *const NATIVE_EXPRESSIONS[] =
+  {
+    "sin(x) * x ^ 2 / (x - 1) + ln(x)",
+    "sqrt(x * k - 1) - cos(k / x)",
+    "(x + 1) ^ 3 / ln(k + 2) - 2 ^ x",
+  };
+
+const size_t NATIVE_EXPRESSIONS_COUNT = sizeof(NATIVE_EXPRESSIONS) / sizeof(NATIVE_EXPRESSIONS[0]);
+
+/// Simplification and collection of terms keep values where operands
+/// are undefined and keep small coefficients
+const char *const DOMAIN_EXPRESSIONS[] =
+  {
+    "x / x",
+    "(x - 1) / (x - 1) + k",
+    "ln(x) ^ 2 * ln(x) ^ 3",
+    "sqrt(x) ^ k / sqrt(x)",
+    "2 ^ x * 2 ^ (x + k)",
+    "3 ^ x / 3",
+    "x * x / x",
+    "ln(x) * x / x + x / (x * x)",
+    "(x + 1 / x) ^ 2",
+    "x * x / 1000000000000 + x",
+  };
+
+const size_t DOMAIN_EXPRESSIONS_COUNT = sizeof(DOMAIN_EXPRESSIONS) / sizeof(DOMAIN_EXPRESSIONS[0]);
+
+const double DOMAIN_TOLERANCE = 1e-12;
+
+/// Taylor series of sin at zero, its coefficients are small after order 14
+const char *const SERIES_EXPRESSION = "sin(x)";
+
+const int SERIES_POWER = 40;
+
+const double SERIES_POINT = 3;
+
+const double SERIES_TOLERANCE = 1e-12;
+
+/// Expressions of both variables, derivatives by k aren`t shortened
+/// to derivatives by main variable
+const char *const GRADIENT_EXPRESSIONS[] =
+  {
+    "x ^ 2 * k + sin(x * k)",
+    "ln(x * k) * cos(x) - k ^ 3 / x",
+    "sqrt(x + k) * 2 ^ (x * k)",
+  };
+
+const size_t GRADIENT_EXPRESSIONS_COUNT = sizeof(GRADIENT_EXPRESSIONS) / sizeof(GRADIENT_EXPRESSIONS[0]);
+
+/// Values of x and k
+const double GRADIENT_POINTS[][VARIABLES_COUNT] = {{1.5, 0.7}, {0.3, 2}, {2.5, 1.25}};
+
+const size_t GRADIENT_POINTS_COUNT = sizeof(GRADIENT_POINTS) / sizeof(GRADIENT_POINTS[0]);
+
+/// Symbolic derivatives are simplified, so operations are in other order
+const double GRADIENT_TOLERANCE = 1e-10;
+
+/// Direction of Hessian-vector product by x and k
+const double HESSIAN_DIRECTION[VARIABLES_COUNT] = {0.3, -1.2};
+
+/// Terms of 1 + x + ... + x, its depth overflows native stack of recursive traversals
+const size_t DEEP_TERMS_COUNT = 1000000;
+
+const double DEEP_VALUE = 0.5;
+
+struct Test {
+  const char *name;
+  bool (*run)(db::VarTable *table);
+};
+
+static bool testJit       (db::VarTable *table);
+static bool testJitFused  (db::VarTable *table);
+static bool testJitPlot   (db::VarTable *table);
+static bool testNative    (db::VarTable *table);
+static bool testNativeDiff(db::VarTable *table);
+static bool testDomain    (db::VarTable *table);
+static bool testSeries    (db::VarTable *table);
+static bool testGradient  (db::VarTable *table);
+static bool testHessian   (db::VarTable *table);
+static bool testDeep      (db::VarTable *table);
+
+static db::TreeNode *createRandomNode(int depth);
+
+static bool isBinary(db::operator_t operat);
+
+static bool isSame(double first, double second);
+
+static bool isClose(double first, double second, double tolerance);
+
+static db::VarTable *createTable();
+
+static void destroyTable(db::VarTable *table);
+
+const Test TESTS[] =
+  {
+    {"jit",         testJit       },
+    {"jit-fused",   testJitFused  },
+    {"jit-plot",    testJitPlot   },
+    {"native",      testNative    },
+    {"native-diff", testNativeDiff},
+    {"domain",      testDomain    },
+    {"series",      testSeries    },
+    {"gradient",    testGradient  },
+    {"hessian",     testHessian   },
+    {"deep",        testDeep      },
+  };
+
+const size_t TESTS_COUNT = sizeof(TESTS) / sizeof(TESTS[0]);
+
+int main()
+{
+  srand(RANDOM_SEED);
+
+  db::VarTable *table = createTable();
+
+  if (!table)
+    return 1;
+
+  size_t failed = 0;
+
+  for (size_t i = 0; i < TESTS_COUNT; ++i)
+    {
+      bool isPassed = TESTS[i].run(table);
+
+      printf("%-12s %s\n", TESTS[i].name, isPassed ? "ok" : "FAILED");
+
+      failed += !isPassed;
+    }
+
+  destroyTable(table);
+
+  printf("%zu of %zu tests failed\n", failed, TESTS_COUNT);
+
+  return failed ? 1 : 0;
+}
+
+/// Machine code and calculateNode() give the same values on random trees.
+/// Both of them call the same functions of libm, so values are equal exactly
+static bool testJit(db::VarTable *table)
+{
+  db::Context context{};
+
+  int errorCode = 0;
+
+  db::createContext(&context, table, &errorCode);
+
+  if (errorCode)
+    return false;
+
+  const size_t valuesCount = sizeof(VALUES) / sizeof(VALUES[0]);
+
+  double results[valuesCount] = {};
+
+  bool isPassed = true;
+
+  for (size_t i = 0; i < RANDOM_TREES_COUNT && isPassed; ++i)
+    {
+      db::Tree tree{};
+      db::createTree(&tree);
+
+      tree.root = createRandomNode(1 + (int)(i % MAX_RANDOM_DEPTH));
+
+      db::Program program{};
+      db::JitProgram jit{};
+
+      db::compileTree(&program, &tree, table, &errorCode);
+      db::compileJit (&jit, &program, &errorCode);
+
+      if (errorCode || (db::isJitAvailable() && !jit.function))
+        isPassed = false;
+      else
+        db::executeJit(&jit, &context, 0, VALUES, results, valuesCount, &errorCode);
+
+      for (size_t j = 0; j < valuesCount && isPassed && !errorCode; ++j)
+        {
+          table->table[0].value = VALUES[j];
+          context.slots[0]      = VALUES[j];
+
+          double expected = calculateNode(table, tree.root);
+
+          isPassed =
+            isSame(expected, db::executeJit(&jit, &context, &errorCode)) &&
+            isSame(expected, results[j]);
+        }
+
+      if (!isPassed || errorCode)
+        {
+          fprintf(stderr, "Values differ for tree:\n");
+          db::saveTree(&tree, stderr);
+
+          isPassed = false;
+        }
+
+      db::destroyJit(&jit);
+      db::destroyProgram(&program);
+      db::destroyTree(&tree);
+    }
+
+  db::destroyContext(&context);
+
+  return isPassed;
+}
+
+/// Outputs of fused program are left by machine code in the same order
+static bool testJitFused(db::VarTable *table)
+{
+  db::Context context{};
+
+  int errorCode = 0;
+
+  db::createContext(&context, table, &errorCode);
+
+  if (errorCode)
+    return false;
+
+  const size_t valuesCount = sizeof(VALUES) / sizeof(VALUES[0]);
+  const size_t treesCount  = 3;
+
+  double  values[treesCount * valuesCount] = {};
+  double *results[treesCount] = {};
+
+  for (size_t i = 0; i < treesCount; ++i)
+    results[i] = values + i * valuesCount;
+
+  bool isPassed = true;
+
+  for (size_t i = 0; i < RANDOM_TREES_COUNT / treesCount && isPassed; ++i)
+    {
+      db::Tree        trees[treesCount] = {};
+      const db::Tree *roots[treesCount] = {};
+
+      for (size_t j = 0; j < treesCount; ++j)
+        {
+          db::createTree(&trees[j]);
+
+          trees[j].root = createRandomNode(1 + (int)((i + j) % MAX_RANDOM_DEPTH));
+          roots[j]      = &trees[j];
+        }
+
+      db::Program program{};
+      db::JitProgram jit{};
+
+      db::compileFused(&program, roots, treesCount, table, &errorCode);
+      db::compileJit  (&jit, &program, &errorCode);
+      db::executeJitOutputs(&jit, &context, 0, VALUES, results, valuesCount, &errorCode);
+
+      isPassed = !errorCode;
+
+      for (size_t j = 0; j < treesCount && isPassed; ++j)
+        for (size_t k = 0; k < valuesCount && isPassed; ++k)
+          {
+            table->table[0].value = VALUES[k];
+
+            isPassed = isSame(calculateNode(table, trees[j].root), results[j][k]);
+          }
+
+      db::destroyJit(&jit);
+      db::destroyProgram(&program);
+
+      for (size_t j = 0; j < treesCount; ++j)
+        db::destroyTree(&trees[j]);
+    }
+
+  db::destroyContext(&context);
+
+  return isPassed;
+}
+
+/// Curves of plot are the same for both backends of sampler
+static bool testJitPlot(db::VarTable *table)
+{
+  bool isPassed = true;
+
+  for (size_t i = 0; i < RANDOM_TREES_COUNT / 20 && isPassed; ++i)
+    {
+      db::Tree tree{};
+      db::createTree(&tree);
+
+      tree.root = createRandomNode(1 + (int)(i % MAX_RANDOM_DEPTH));
+
+      db::Expression expression = {&tree, "f"};
+      db::Plot plot = {&expression, 1, {-5, 5}, {-5, 5}, SAMPLE_DENSITY};
+
+      db::Curve interpreted{};
+      db::Curve jitted{};
+
+      int errorCode = 0;
+
+      db::sampleCurves(&plot, table, &interpreted, 1, db::Backend::INTERPRETER, &errorCode);
+      db::sampleCurves(&plot, table, &jitted     , 1, db::Backend::JIT        , &errorCode);
+
+      isPassed = !errorCode && interpreted.size == jitted.size;
+
+      for (size_t j = 0; j < interpreted.size && isPassed; ++j)
+        isPassed =
+          isSame(interpreted.x[j], jitted.x[j]) &&
+          isSame(interpreted.y[j], jitted.y[j]);
+
+      db::destroyCurve(&interpreted);
+      db::destroyCurve(&jitted);
+      db::destroyTree(&tree);
+    }
+
+  return isPassed;
+}
+
+/// Functions of compiled module give values of calculateNode() up to rounding
+static bool testNative(db::VarTable *table)
+{
+  db::Tree        trees[NATIVE_EXPRESSIONS_COUNT] = {};
+  const db::Tree *roots[NATIVE_EXPRESSIONS_COUNT] = {};
+
+  int errorCode = 0;
+
+  for (size_t i = 0; i < NATIVE_EXPRESSIONS_COUNT; ++i)
+    {
+      db::createTree(&trees[i]);
+      db::parseTree (&trees[i], NATIVE_EXPRESSIONS[i], &errorCode);
+
+      roots[i] = &trees[i];
+    }
+
+  db::Context      context{};
+  db::NativeModule module{};
+
+  db::createContext(&context, table, &errorCode);
+  db::loadNativeModule(&module, roots, NATIVE_EXPRESSIONS_COUNT, table, &errorCode);
+
+  const size_t valuesCount = sizeof(VALUES) / sizeof(VALUES[0]);
+
+  double  values[NATIVE_EXPRESSIONS_COUNT * valuesCount] = {};
+  double *results[NATIVE_EXPRESSIONS_COUNT] = {};
+
+  for (size_t i = 0; i < NATIVE_EXPRESSIONS_COUNT; ++i)
+    results[i] = values + i * valuesCount;
+
+  if (!errorCode)
+    db::executeNative(&module, &context, 0, VALUES, results, valuesCount, &errorCode);
+
+  bool isPassed = !errorCode;
+
+  for (size_t i = 0; i < NATIVE_EXPRESSIONS_COUNT && isPassed; ++i)
+    for (size_t j = 0; j < valuesCount && isPassed; ++j)
+      {
+        table->table[0].value = VALUES[j];
+
+        isPassed = isClose(calculateNode(table, trees[i].root), results[i][j], NATIVE_TOLERANCE);
+      }
+
+  if (module.handle)
+    db::destroyNativeModule(&module);
+
+  db::destroyContext(&context);
+
+  for (size_t i = 0; i < NATIVE_EXPRESSIONS_COUNT; ++i)
+    db::destroyTree(&trees[i]);
+
+  return isPassed;
+}
+
+/// Module of expression and its derivative gives values of both trees
+static bool testNativeDiff(db::VarTable *table)
+{
+  const size_t valuesCount = sizeof(VALUES) / sizeof(VALUES[0]);
+
+  db::Context context{};
+
+  int errorCode = 0;
+
+  db::createContext(&context, table, &errorCode);
+
+  bool isPassed = !errorCode;
+
+  for (size_t i = 0; i < NATIVE_EXPRESSIONS_COUNT && isPassed; ++i)
+    {
+      db::Tree tree{};
+      db::createTree(&tree);
+      db::parseTree (&tree, NATIVE_EXPRESSIONS[i], &errorCode);
+
+      db::Tree diffTree = diffExpresion(&tree, nullptr, &errorCode);
+
+      db::NativeModule module{};
+
+      if (!errorCode)
+        db::loadNativeDiff(&module, &tree, table, &errorCode);
+
+      double  values[2 * valuesCount] = {};
+      double *results[2] = {values, values + valuesCount};
+
+      if (!errorCode)
+        db::executeNative(&module, &context, 0, VALUES, results, valuesCount, &errorCode);
+
+      isPassed = !errorCode && module.functionsCount == 2;
+
+      for (size_t j = 0; j < valuesCount && isPassed; ++j)
+        {
+          table->table[0].value = VALUES[j];
+
+          isPassed =
+            isClose(calculateNode(table, tree    .root), results[0][j], NATIVE_TOLERANCE) &&
+            isClose(calculateNode(table, diffTree.root), results[1][j], NATIVE_TOLERANCE);
+        }
+
+      if (module.handle)
+        db::destroyNativeModule(&module);
+
+      if (diffTree.root)
+        db::destroyTree(&diffTree);
+
+      db::destroyTree(&tree);
+    }
+
+  db::destroyContext(&context);
+
+  return isPassed;
+}
+
+static bool testDomain(db::VarTable *table)
+{
+  const size_t valuesCount = sizeof(VALUES) / sizeof(VALUES[0]);
+
+  bool isPassed = true;
+
+  for (size_t i = 0; i < DOMAIN_EXPRESSIONS_COUNT && isPassed; ++i)
+    {
+      int errorCode = 0;
+
+      db::Tree tree{};
+      db::createTree(&tree);
+      db::parseTree (&tree, DOMAIN_EXPRESSIONS[i], &errorCode);
+
+      db::Tree simple{};
+      db::createTree(&simple);
+
+      if (!errorCode)
+        {
+          simple.root = db::createNode(tree.root);
+
+          simpliteTree    (&simple, nullptr, nullptr, &errorCode);
+          collectTermsTree(&simple, nullptr, &errorCode);
+        }
+
+      isPassed = !errorCode;
+
+      for (size_t j = 0; j < valuesCount && isPassed; ++j)
+        {
+          table->table[0].value = VALUES[j];
+
+          isPassed = isClose(calculateNode(table, tree.root), calculateNode(table, simple.root), DOMAIN_TOLERANCE);
+        }
+
+      db::destroyTree(&simple);
+      db::destroyTree(&tree);
+    }
+
+  return isPassed;
+}
+
+static bool testSeries(db::VarTable *table)
+{
+  int errorCode = 0;
+
+  db::Tree tree{};
+  db::createTree(&tree);
+  db::parseTree (&tree, SERIES_EXPRESSION, &errorCode);
+
+  table->table[0].value = 0;
+
+  db::Tree series = calculateSeries(table, &tree, SERIES_POWER, &errorCode);
+
+  table->table[0].value = SERIES_POINT;
+
+  bool isPassed =
+    !errorCode && series.root &&
+    isClose(calculateNode(table, series.root), calculateNode(table, tree.root), SERIES_TOLERANCE);
+
+  if (series.root)
+    db::destroyTree(&series);
+
+  db::destroyTree(&tree);
+
+  return isPassed;
+}
+
+/// Gradient of tape gives values of symbolic partial derivatives
+static bool testGradient(db::VarTable *table)
+{
+  const char *const variables[VARIABLES_COUNT] = {VARIABLE_NAMES[0], VARIABLE_NAMES[1]};
+
+  bool isPassed = true;
+
+  for (size_t i = 0; i < GRADIENT_EXPRESSIONS_COUNT && isPassed; ++i)
+    {
+      int errorCode = 0;
+
+      db::Tree tree{};
+      db::createTree(&tree);
+      db::parseTree (&tree, GRADIENT_EXPRESSIONS[i], &errorCode);
+
+      db::Tree derivatives[VARIABLES_COUNT] = {};
+
+      if (!errorCode)
+        diffGradient(&tree, variables, VARIABLES_COUNT, derivatives, &errorCode);
+
+      isPassed = !errorCode;
+
+      for (size_t j = 0; j < GRADIENT_POINTS_COUNT && isPassed; ++j)
+        {
+          for (size_t k = 0; k < VARIABLES_COUNT; ++k)
+            table->table[k].value = GRADIENT_POINTS[j][k];
+
+          double gradient[VARIABLES_COUNT] = {};
+
+          double value = db::calculateGradient(table, &tree, gradient, &errorCode);
+
+          isPassed = !errorCode && isClose(calculateNode(table, tree.root), value, GRADIENT_TOLERANCE);
+
+          for (size_t k = 0; k < VARIABLES_COUNT && isPassed; ++k)
+            {
+              size_t slot = db::searchVariableSlot(table, variables[k]);
+
+              isPassed = isClose(calculateNode(table, derivatives[k].root), gradient[slot], GRADIENT_TOLERANCE);
+            }
+        }
+
+      for (size_t j = 0; j < VARIABLES_COUNT; ++j)
+        if (derivatives[j].root)
+          db::destroyTree(&derivatives[j]);
+
+      db::destroyTree(&tree);
+    }
+
+  return isPassed;
+}
+
+/// Hessian and its product with direction give values of symbolic second derivatives
+static bool testHessian(db::VarTable *table)
+{
+  const char *const variables[VARIABLES_COUNT] = {VARIABLE_NAMES[0], VARIABLE_NAMES[1]};
+
+  bool isPassed = true;
+
+  for (size_t i = 0; i < GRADIENT_EXPRESSIONS_COUNT && isPassed; ++i)
+    {
+      int errorCode = 0;
+
+      db::Tree tree{};
+      db::createTree(&tree);
+      db::parseTree (&tree, GRADIENT_EXPRESSIONS[i], &errorCode);
+
+      db::Tree derivatives[VARIABLES_COUNT] = {};
+      db::Tree     seconds[VARIABLES_COUNT][VARIABLES_COUNT] = {};
+
+      if (!errorCode)
+        diffGradient(&tree, variables, VARIABLES_COUNT, derivatives, &errorCode);
+
+      for (size_t j = 0; j < VARIABLES_COUNT && !errorCode; ++j)
+        diffGradient(&derivatives[j], variables, VARIABLES_COUNT, seconds[j], &errorCode);
+
+      isPassed = !errorCode;
+
+      for (size_t j = 0; j < GRADIENT_POINTS_COUNT && isPassed; ++j)
+        {
+          for (size_t k = 0; k < VARIABLES_COUNT; ++k)
+            table->table[k].value = GRADIENT_POINTS[j][k];
+
+          double hessian[VARIABLES_COUNT * VARIABLES_COUNT] = {};
+
+          double direction[VARIABLES_COUNT] = {};
+          double   product[VARIABLES_COUNT] = {};
+
+          for (size_t k = 0; k < VARIABLES_COUNT; ++k)
+            direction[db::searchVariableSlot(table, variables[k])] = HESSIAN_DIRECTION[k];
+
+          db::calculateHessian      (table, &tree, variables, VARIABLES_COUNT, hessian, &errorCode);
+          db::calculateHessianVector(table, &tree, direction, product, &errorCode);
+
+          isPassed = !errorCode;
+
+          for (size_t k = 0; k < VARIABLES_COUNT && isPassed; ++k)
+            {
+              double expected = 0;
+
+              for (size_t l = 0; l < VARIABLES_COUNT && isPassed; ++l)
+                {
+                  double second = calculateNode(table, seconds[k][l].root);
+
+                  isPassed = isClose(second, hessian[k * VARIABLES_COUNT + l], GRADIENT_TOLERANCE);
+
+                  expected += second * HESSIAN_DIRECTION[l];
+                }
+
+              size_t slot = db::searchVariableSlot(table, variables[k]);
+
+              isPassed = isPassed && isClose(expected, product[slot], GRADIENT_TOLERANCE);
+            }
+        }
+
+      for (size_t j = 0; j < VARIABLES_COUNT; ++j)
+        {
+          for (size_t k = 0; k < VARIABLES_COUNT; ++k)
+            if (seconds[j][k].root)
+              db::destroyTree(&seconds[j][k]);
+
+          if (derivatives[j].root)
+            db::destroyTree(&derivatives[j]);
+        }
+
+      db::destroyTree(&tree);
+    }
+
+  return isPassed;
+}
+
+/// Traversals of menu and plots finish on deep chain
+static bool testDeep(db::VarTable *table)
+{
+  char *source = (char *)calloc(2 * DEEP_TERMS_COUNT + 2, sizeof(char));
+
+  if (!source)
+    return false;
+
+  source[0] = '1';
+
+  for (size_t i = 0; i < DEEP_TERMS_COUNT; ++i)
+    {
+      source[2 * i + 1] = '+';
+      source[2 * i + 2] = 'x';
+    }
+
+  int errorCode = 0;
+
+  db::Tree tree{};
+  db::createTree(&tree);
+  db::parseTree (&tree, source, &errorCode);
+
+  free(source);
+
+  if (errorCode)
+    return false;
+
+  table->table[0].value = DEEP_VALUE;
+
+  double expected = 1 + DEEP_VALUE * (double)DEEP_TERMS_COUNT;
+
+  db::updateVarTable(table, tree.root, &errorCode);
+
+  db::Program program{};
+  db::compileTree(&program, &tree, table, &errorCode);
+
+  bool isPassed =
+    !errorCode &&
+    isSame(db::executeProgram(&program, table), expected) &&
+    isSame(calculateNode(table, tree.root), expected);
+
+  db::destroyProgram(&program);
+
+  db::Dual dual = db::calculateDual(table, tree.root, db::DEFAULT_MAIN_NAME);
+
+  isPassed = isPassed && isSame(dual.value, expected) && isSame(dual.derivative, (double)DEEP_TERMS_COUNT);
+
+  db::Tree tangent = calculateTanget(table, &tree, &errorCode);
+  db::Tree series  = calculateSeries(table, &tree, 3, &errorCode);
+
+  isPassed = isPassed && !errorCode && tangent.root && series.root;
+
+  if (tangent.root) db::destroyTree(&tangent);
+  if (series .root) db::destroyTree(&series );
+
+  db::Expression expression = {&tree, "f"};
+  db::Plot plot = {&expression, 1, {-5, 5}, {-5, 5}, SAMPLE_DENSITY / 10};
+
+  db::Curve curve{};
+
+  db::sampleCurves(&plot, table, &curve, 1, db::Backend::INTERPRETER, &errorCode);
+
+  isPassed = isPassed && !errorCode && curve.size;
+
+  db::destroyCurve(&curve);
+  db::destroyTree(&tree);
+
+  return isPassed;
+}
+
+static db::TreeNode *createRandomNode(int depth)
+{
+  if (depth <= 1 || rand() % 4 == 0)
+    {
+      if (rand() % 2)
+        return db::createNode({.variable = VARIABLE_NAMES[(size_t)rand() % VARIABLES_COUNT]}, db::type_t::VARIABLE);
+
+      return db::createNode({.number = NUMBERS[(size_t)rand() % (sizeof(NUMBERS) / sizeof(NUMBERS[0]))]}, db::type_t::NUMBER);
+    }
+
+  db::operator_t operat = (db::operator_t)(rand() % db::OPERATORS_COUNT);
+
+  db::TreeNode *left  = isBinary(operat) ? createRandomNode(depth - 1) : nullptr;
+  db::TreeNode *right = createRandomNode(depth - 1);
+
+  return db::createNode({.operat = operat}, db::type_t::OPERATOR, left, right);
+}
+
+static bool isBinary(db::operator_t operat)
+{
+  for (int i = 0; i < db::BINARY_OPERATORS_COUNT; ++i)
+    if (db::BINARY_OPERATORS[i] == operat)
+      return true;
+
+  return false;
+}
+
+/// Values are the same if they are equal or both of them are undefined
+static bool isSame(double first, double second)
+{
+  if (isnan(first) || isnan(second))
+    return isnan(first) && isnan(second);
+
+  return !(first < second) && !(first > second);
+}
+
+/// Values are close if their difference is small relative to them
+static bool isClose(double first, double second, double tolerance)
+{
+  if (isnan(first) || isnan(second) || isinf(first) || isinf(second))
+    return isSame(first, second);
+
+  return fabs(first - second) <= tolerance * fmax(1, fmax(fabs(first), fabs(second)));
+}
+
+static db::VarTable *createTable()
+{
+  db::VarTable *table = (db::VarTable *)calloc(1, sizeof(db::VarTable));
+
+  if (!table)
+    return nullptr;
+
+  table->table = (db::Variable *)calloc(VARIABLES_COUNT, sizeof(db::Variable));
+
+  if (!table->table)
+    {
+      free(table);
+
+      return nullptr;
+    }
+
+  for (size_t i = 0; i < VARIABLES_COUNT; ++i)
+    table->table[i] = {strdup(VARIABLE_NAMES[i]), (int)i, 1.5};
+
+  table->capacity = table->size = VARIABLES_COUNT;
+
+  return table;
+}
+
+static void destroyTable(db::VarTable *table)
+{
+  for (size_t i = 0; i < table->size; ++i)
+    free(table->table[i].name);
+
+  free(table->table);
+  free(table);
+}